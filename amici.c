@@ -8,65 +8,163 @@
 
 #define _POSIX_C_SOURCE 200809L //Allows strdup to work
 
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <unistd.h>
 
-#include "hash.h"
+#include "arena.h"
+#include "batch.h"
+#include "components.h"
+#include "csr.h"
+#include "friends.h"
+#include "import.h"
+#include "influence.h"
+#include "jobs.h"
+#include "journal.h"
+#include "locks.h"
+#include "names.h"
+#include "person.h"
+#include "profile.h"
+#include "ranks.h"
+#include "search.h"
+#include "server.h"
+#include "snapshot.h"
+#include "social.h"
 #include "table.h"
+#include "tiers.h"
+#include "triangles.h"
 
 #define BUF_SIZE 1024
-#define MAX_COMMANDS 4
-#define FRIEND_BLOCK 10
-
-typedef struct person_s{
-	char *first_name;		// First name
-	char *last_name;		// Last name
-	char *handle;			// Username
-	struct person_s **friends;	// Dynamic collection of friends
-	size_t friend_count;		// Current number of friends
-	size_t max_friends;		// Maximum number of friends
-} person_t;
+#define MAX_COMMANDS 5
+#define FIND_LIMIT 10		// Default number of users find-prefix lists
+#define DEGREE_BUCKETS 33	// 0 friends, then one bucket per power of two
+#define COMMAND_SLOTS 128	// Dispatch table size, a power of two over twice the number of commands
+#define PRINT_BUFFER (64 * 1024)	// Bytes of friend lines print formats before writing them at once
+#define MAX_LOAD_DEPTH 16	// Most command files load may have open at once, so a file that loads itself stops
+
+//How a command holds the structure lock
+typedef enum lock_mode_e{
+	LOCK_NONE,		//Each command it runs locks for itself
+	LOCK_SHARED,
+	LOCK_EXCLUSIVE,
+	LOCK_FRIENDSHIP,	//Shared, unless the graph is frozen
+	LOCK_COMPONENTS		//Shared with components held still, unless splits are pending
+} lock_mode_t;
+
+//A command, its arguments and how it runs
+typedef struct command_s{
+	const char *name;
+	size_t min_args;	//Tokens needed after the name
+	size_t max_args;	//Tokens read after the name; later ones are ignored
+	lock_mode_t lock;
+	bool background;	//Only reads the network, so bg may run it in a forked copy
+	void (*run)(char ** data);
+	const char *usage;	//Printed when the number of arguments is wrong
+} command_t;
+
+extern const command_t commands[]; //Every command, ended by one with a NULL name
 
 //Global Variables
 Table t;
+Arena arena;
+person_t **users;	//Every user, indexed by id
+size_t max_users;
+person_t *spare_people;	//Records of removed users, chained through their friends fields
+Journal journal;	//NULL unless running with -j
+char *journal_snapshot;	//Snapshot the journal is compacted into
+Csr frozen;		//Read-only copy of the graph, NULL once anything changes
+Components components;	//Connected components of the graph
+pthread_mutex_t components_lock = PTHREAD_MUTEX_INITIALIZER; //Guards components under a shared lock
+Locks locks;		//Lets commands run on several threads at once
+Names names;		//Finds users by name
+Profile profile;	//Latency of each command
+Ranks ranks;		//Users ordered by number of friends
+pthread_mutex_t ranks_lock = PTHREAD_MUTEX_INITIALIZER; //Guards ranks under a shared lock
+Triangles triangles;	//Triangles each user is part of, changed atomically under a shared lock
+Influence influence;	//Influence scores of the last influence command
+Jobs jobs;		//Commands running in the background, each in a forked copy of the process
+Tiers tiers;		//Moves friend lists nobody uses out of memory, NULL unless running with -m
+unsigned threads = 1;	//Most threads a single query may use
+_Thread_local char print_buffer[PRINT_BUFFER];	//Reused by every print on a thread
+_Thread_local size_t print_length;
+_Thread_local FILE *client;	//Stream of the client whose commands run on this thread, NULL for stdout and stderr
+_Thread_local unsigned load_depth;	//Command files being loaded on this thread
 int friendships;
 int people;
 bool is_active;
 
 
+/*
+ * Gets the stream commands on this thread print their results to
+ *
+ * @return The client's stream when serving clients, stdout otherwise
+ */
+FILE* output(){
+	return client != NULL ? client : stdout;
+}
+
+/*
+ * Gets the stream commands on this thread print their errors to
+ *
+ * @return The client's stream when serving clients, so errors stay in
+ *         order with results, stderr otherwise
+ */
+FILE* errors(){
+	return client != NULL ? client : stderr;
+}
+
 /*
  * Print function to initialize table
  *
  * @param key The key of the table entry
- * @param value The value of the table entry
- * @pre value is of type person_t
+ * @param p1 The person stored under key
  *
  */
-void tablePrint(const void* key, const void* value){
+void tablePrint(const char* key, const person_t* p1){
 	(void)key;
-	person_t* p1 = (person_t*)value;
-	printf("%s, %s (%s)\n", p1->first_name, p1->last_name, p1->handle);
+	fprintf(output(), "%s, %s (%s)\n", p1->first_name, p1->last_name, p1->handle);
 }
 
 /*
- * Delete table entry
+ * Drops the frozen copy of the graph, if any, before the network changes
  *
- * @param key The key of the table entry
- * @param value The value of the table entry
- * @pre value is of type person_t
  */
-void tableDel(void* key, void* value){
-	(void)key;
-	person_t* p1 = (person_t*)value;
+void thaw(){
+	if(frozen != NULL){
+		csr_destroy(frozen);
+		frozen = NULL;
+	}
+}
+
+/*
+ * Brings a user's friend list into memory if it was moved out, and notes
+ * the use and the list's size; call before and after changing the list
+ *
+ * @param p1 The user
+ * @pre no other thread reads p1's friend list
+ */
+void touchUser(person_t * p1){
+	if(tiers != NULL){
+		tiers_touch(tiers, arena, p1);
+	}
+}
 
-	//Free allocated memory
-	free(p1->first_name);
-	free(p1->last_name);
-	free(p1->handle);
-	free(p1->friends);
-	free(p1);
+/*
+ * Touches a user whose user lock this thread does not hold yet
+ *
+ * @param p1 The user
+ */
+void warmUser(person_t * p1){
+	if(tiers != NULL){
+		locks_user(locks, p1->id, true);
+		tiers_touch(tiers, arena, p1);
+		locks_release_user(locks, p1->id);
+	}
 }
 
 /*
@@ -81,337 +179,1831 @@ void reformat(bool is_quit){
 		return; //Let main clean the table
 	}
 	else{ 
+		//Everything the table points to lives in the arena
+		thaw();
 		ht_destroy(t);
-		t = ht_create(str_hash, str_equals, tablePrint, tableDel);
+		arena_reset(arena);
+		t = ht_create(tablePrint, NULL);
+		users = NULL;
+		max_users = 0;
+		spare_people = NULL;
+		friendships = 0;
+		people = 0;
+		components_clear(components);
+		names_clear(names);
+		ranks_clear(ranks);
+		triangles_clear(triangles);
+		influence_clear(influence);
+		if(tiers != NULL){
+			tiers_clear(tiers);
+		}
 		return; //reinitializes t to be empty
 	}
 }
 
+/*
+ * Gives a new user the next id and records them in the user directory
+ *
+ * @param p1 The new user
+ */
+void registerUser(person_t * p1){
+	if((size_t)people == max_users){ //Grow the directory geometrically
+		size_t capacity = max_users == 0 ? 16 : max_users * 2;
+		person_t **grown = arena_alloc(arena, capacity * sizeof(person_t *));
+		if(people > 0){
+			memcpy(grown, users, people * sizeof(person_t *));
+		}
+		arena_free(arena, users, max_users * sizeof(person_t *));
+		users = grown;
+		max_users = capacity;
+	}
+	p1->id = (uint32_t)people;
+	users[people] = p1;
+	components_add(components, p1->id);
+	names_add(names, p1);
+	ranks_add(ranks, p1->id);
+	triangles_add(triangles, p1->id);
+	influence_add(influence, p1->id);
+	if(tiers != NULL){
+		tiers_add(tiers, p1);
+	}
+}
+
+/*
+ * Creates a user and adds them to the network, unless the handle is taken
+ *
+ * @param first The user's first name
+ * @param last The user's last name
+ * @param handle The user's handle
+ * @return The new user, or NULL if the handle belongs to someone else
+ */
+person_t* createUser(const char * first, const char * last, const char * handle){
+	person_t* new_person = spare_people;
+	if(new_person != NULL){ //Reuse a removed user's record
+		spare_people = (person_t *)(void *)new_person->friends;
+	}
+	else{
+		new_person = arena_alloc(arena, sizeof(person_t));
+	}
+	new_person->handle = arena_strdup(arena, handle);
+
+	//Put new person in the table, looking the handle up only once
+	if(ht_try_insert(t, new_person->handle, new_person) != NULL){ //The copied handle stays until the arena resets
+		new_person->friends = (uint32_t *)(void *)spare_people;
+		spare_people = new_person;
+		return NULL;
+	}
+	thaw();
+	new_person->first_name = arena_intern(arena, first);
+	new_person->last_name = arena_intern(arena, last);
+	new_person->friends = NULL;
+	new_person->friend_count = 0;
+	new_person->max_friends = 0;
+	new_person->friend_index = NULL;
+	new_person->index_mask = 0;
+
+	//Add to the directory and people count
+	registerUser(new_person);
+	people++;
+	return new_person;
+}
+
+/*
+ * Records a successful change in the journal, if there is one
+ *
+ * @param op The kind of change
+ * @param args The handles and names the change was made with
+ */
+void journalChange(journal_op_t op, char ** args){
+	if(journal != NULL && !journal_append(journal, op, args)){
+		fprintf(errors(), "error: could not write to the journal\n");
+	}
+}
+
 /*
  * Prints overall stats of the site
  *
  */
 void printStats(){
+	int links = __atomic_load_n(&friendships, __ATOMIC_RELAXED); //friend may run on other threads
+	flockfile(output());
 	if(people == 1){ //If there's only 1 person, its impossible to have any friends
-		printf("Statistics: 1 person, 0 friendships\n");
+		fprintf(output(), "Statistics: 1 person, 0 friendships\n");
 	}
-	else if(friendships == 1){ //If there's 1 friendship, its impossible to have only 1 person
-		printf("Statistics: %i people, 1 friendship\n", people);
+	else if(links == 1){ //If there's 1 friendship, its impossible to have only 1 person
+		fprintf(output(), "Statistics: %i people, 1 friendship\n", people);
 	}
 	else{
-		printf("Statistics: %i people, %i friendships\n", people, friendships);
+		fprintf(output(), "Statistics: %i people, %i friendships\n", people, links);
+	}
+
+	size_t count = components_count(components, users, threads);
+	size_t largest = components_largest(components, users, threads);
+	fprintf(output(), "Components: %zu, largest has %zu %s\n", count, largest, largest == 1 ? "person" : "people");
+
+	//Pointers would double the lists, and the indexes would need 32-bit positions
+	size_t lists = 0;
+	size_t indexes = 0;
+	size_t narrow = 0;
+	for(int i = 0; i < people; i++){
+		lists += users[i]->max_friends * sizeof(uint32_t);
+		indexes += friends_index_bytes(users[i]);
+		if(users[i]->index_mask < FRIEND_NARROW_SLOTS){
+			narrow += friends_index_bytes(users[i]);
+		}
+	}
+	fprintf(output(), "Friend lists: %zu bytes of 32-bit ids and %zu bytes of indexes, %zu bytes less than as pointers\n",
+		lists, indexes, lists * (sizeof(person_t *) - sizeof(uint32_t)) / sizeof(uint32_t) + narrow);
+
+	uint64_t closed = triangles_total(triangles);
+	fprintf(output(), "Triangles: %llu, average clustering coefficient %.4f\n", (unsigned long long)closed, triangles_average(triangles));
+	if(tiers != NULL){
+		tiers_stats_t tier;
+		tiers_stats(tiers, &tier);
+		fprintf(output(), "Cold storage: %zu of %zu friend lists on disk in a %zu byte file, %zu bytes in memory of a %zu byte budget\n",
+			tier.cold, tier.users, tier.file_bytes, tier.hot_bytes, tier.budget);
 	}
+	funlockfile(output());
 }
 
 /*
- * Prints info about a user
- *
- * @param handle The handle of a user
- * @pre handle is a valid user
+ * Prints where the network's time and memory go: the handle table's shape,
+ * the bytes behind each kind of record, how friendships are spread across
+ * users, and how long each command has taken
  *
  */
-void printInfo(char * handle){
-	person_t* p1 = (person_t*)ht_get(t, (void*)handle);
+void printProfile(){
+	ht_stats_t table;
+	ht_stats(t, &table);
+	fprintf(output(), "Table: %zu handles in %zu slots (load %.2f), %zu tombstones, %zu rehashes, %zu collisions\n",
+		table.size, table.capacity, (double)table.size / (double)table.capacity, table.deleted,
+		table.rehashes, table.collisions);
+	fprintf(output(), "Probe lengths:");
+	for(size_t k = 0; k < HT_PROBE_BUCKETS; k++){
+		fprintf(output(), "%s %zu%s %s %zu", k == 0 ? "" : ",", k + 1, k + 1 == HT_PROBE_BUCKETS ? "+" : "",
+			k == 0 ? "group" : "groups", table.probes[k]);
+	}
+	fprintf(output(), "\n");
 
-	if(p1->friend_count == 0){	//User has no friends
-		printf("User %s %s(%s) has no friends\n",p1->first_name, p1->last_name, p1->handle);
+	//Walk every user once for both memory and degrees
+	size_t handles = 0;
+	size_t used = 0;
+	size_t reserved = 0;
+	size_t indexes = 0;
+	size_t degrees[DEGREE_BUCKETS] = {0};
+	for(int i = 0; i < people; i++){
+		const person_t *p1 = users[i];
+		handles += (strlen(p1->handle) + ARENA_ALIGN) & ~(size_t)(ARENA_ALIGN - 1);
+		used += p1->friend_count * sizeof(uint32_t);
+		reserved += p1->max_friends * sizeof(uint32_t);
+		indexes += friends_index_bytes(p1);
+		size_t k = p1->friend_count == 0 ? 0 : 64 - (size_t)__builtin_clzll((unsigned long long)p1->friend_count);
+		degrees[k < DEGREE_BUCKETS ? k : DEGREE_BUCKETS - 1]++;
 	}
-	else if(p1->friend_count == 1){	//User has 1 friend
-		printf("User %s %s(%s) has 1 friend\n", p1->first_name, p1->last_name, p1->handle);
-		printf("\t%s %s(%s)\n", p1->friends[0]->first_name, p1->friends[0]->last_name, p1->friends[0]->handle); //List friend
+	size_t names;
+	size_t name_bytes = arena_interned(arena, &names);
+	fprintf(output(), "Memory: %zu bytes from the system\n", arena_footprint(arena));
+	fprintf(output(), "\tNames: %zu bytes for %zu distinct names\n", name_bytes, names);
+	fprintf(output(), "\tHandles: %zu bytes\n", handles);
+	fprintf(output(), "\tRecords: %zu bytes for %i people\n", (size_t)people * sizeof(person_t), people);
+	fprintf(output(), "\tFriend lists: %zu bytes, %zu of them unused\n", reserved, reserved - used);
+	fprintf(output(), "\tFriend indexes: %zu bytes\n", indexes);
+	fprintf(output(), "\tUser directory: %zu bytes\n", max_users * sizeof(person_t *));
+	fprintf(output(), "\tFreed for reuse: %zu bytes\n", arena_idle(arena));
+
+	fprintf(output(), "Friends per user:");
+	bool first = true;
+	for(size_t k = 0; k < DEGREE_BUCKETS; k++){
+		if(degrees[k] == 0){
+			continue;
+		}
+		if(k <= 1){ //0 and 1 friends are their own buckets
+			fprintf(output(), "%s %zu: %zu", first ? "" : ",", k, degrees[k]);
+		}
+		else{
+			fprintf(output(), "%s %zu-%zu: %zu", first ? "" : ",", (size_t)1 << (k - 1), ((size_t)1 << k) - 1, degrees[k]);
+		}
+		first = false;
 	}
-	else{				//User has 2+ friends
-		printf("User %s %s (%s) has %i friends\n", p1->first_name, p1->last_name, p1->handle,(int)p1->friend_count);
-		for(size_t i = 0; i < p1->friend_count; i++){ //List all friends
-			printf("\t%s %s(%s)\n", p1->friends[i]->first_name, p1->friends[i]->last_name, p1->friends[i]->handle);
+	fprintf(output(), "%s\n", first ? " no users" : "");
+
+	for(size_t c = 0; commands[c].name != NULL; c++){
+		uint64_t count = profile_count(profile, c);
+		if(count == 0){
+			continue;
 		}
+		fprintf(output(), "Command %s: %llu runs, mean %llu ns, p50 <= %llu ns, p99 <= %llu ns, p999 <= %llu ns\n",
+			commands[c].name, (unsigned long long)count,
+			(unsigned long long)(profile_total(profile, c) / count),
+			(unsigned long long)profile_quantile(profile, c, 0.5),
+			(unsigned long long)profile_quantile(profile, c, 0.99),
+			(unsigned long long)profile_quantile(profile, c, 0.999));
 	}
+	fprintf(output(), "Command timing is %s\n", profile_enabled(profile) ? "on" : "off");
 }
 
 /*
- * Adds or removes two users to/from each others' friend networks
+ * Copies text into this thread's print buffer, writing the buffer out
+ * first if the text does not fit
  *
- * @param handles[] The handles of the two users
- * @pre handles[] has two entries
+ * @param text The text
+ * @param length The length of text
+ * @pre output() is locked by this thread
  *
  */
-void friend(char * handles[], bool is_friendly){
-	person_t* f1 = (person_t*)ht_get(t, (void*)handles[0]);
-	person_t* f2 = (person_t*)ht_get(t, (void*)handles[1]);
-	
-	if(f1->friend_count == 0 || f2->friend_count == 0){ //If either person has no friends, there's no way they can be friends already
-		if(!is_friendly){ 			//Remove friend
-			fprintf(stderr, "error: %s is not friends with %s\n", f1->handle, f2->handle);
+void bufferText(const char * text, size_t length){
+	if(print_length + length > PRINT_BUFFER){
+		fwrite(print_buffer, 1, print_length, output());
+		print_length = 0;
+		if(length > PRINT_BUFFER){ //Too long to buffer at all
+			fwrite(text, 1, length, output());
 			return;
 		}
-		//else skip to the end
-	}
-	else{ //If both people have at least 1 friend
-		for(size_t i = 0; i < f1->friend_count; i++){ //If f1 is friends with f2
-			if(f1->friends[i] == f2){
-				if(is_friendly){	//Add friend
-					fprintf(stderr, "error: %s is already friends with %s\n", f1->handle, f2->handle);
-					return;
-				}
-				else{			//Remove friend
-					for(size_t j = i; j < f1->friend_count + 1; j++){
-						f1->friends[j] = f1->friends[j+1]; 
-					}
-
-					//Tallying friend removal
-					f1->friend_count--;
-					if((f1->friend_count + FRIEND_BLOCK) < f1->max_friends){ //Check for an unused block of friend slots
-						f1->max_friends -= FRIEND_BLOCK;
-						f1->friends = (person_t**)realloc(f1->friends, f1->max_friends*sizeof(person_t*));
-					}
-					break;
-				}
-			}
-		}
-		for(size_t i = 0; i < f2->friend_count; i++){ //If f2 is friends with f1
-			if(f2->friends[i] == f1){
-				if(is_friendly){	//Add friend
-					f1->friends[f1->friend_count] = f2; //This will only trigger if there is an assymetrical friendship
-					fprintf(stderr, "error: %s is already friends with %s\n", f2->handle, f1->handle);
-					return;
-				}
-				else{			//Remove friend
-					for(size_t j = i; j < f2->friend_count + 1; j++){
-						f2->friends[j] = f2->friends[j+1];
-					}
-
-					//Tallying friend removal
-					f2->friend_count--;
-					friendships--;
-					if((f2->friend_count + FRIEND_BLOCK) < f2->max_friends){ //Check for an unused block of friend slots
-						f2->max_friends -= FRIEND_BLOCK;
-						f2->friends = (person_t**)realloc(f2->friends, f2->max_friends*sizeof(person_t*));
-					}
-					return;
-				}
+	}
+	memcpy(print_buffer + print_length, text, length);
+	print_length += length;
+}
+
+/*
+ * Buffers one line of a friend list
+ *
+ * @param first The friend's first name
+ * @param last The friend's last name
+ * @param handle The friend's handle
+ * @param compact Whether to list the handle alone
+ * @pre output() is locked by this thread
+ *
+ */
+void bufferFriend(const char * first, const char * last, const char * handle, bool compact){
+	bufferText("\t", 1);
+	if(!compact){
+		bufferText(first, strlen(first));
+		bufferText(" ", 1);
+		bufferText(last, strlen(last));
+		bufferText("(", 1);
+	}
+	bufferText(handle, strlen(handle));
+	bufferText(compact ? "\n" : ")\n", compact ? 1 : 2);
+}
+
+/*
+ * Prints info about a user, followed by one page of their friend list
+ *
+ * @param p1 The user
+ * @param after The friend to start after, or NULL to start at offset; a cursor
+ *              taken before p1 lost a friend may skip or repeat one, since
+ *              removal moves p1's last friend into the gap
+ * @param offset The number of friends to skip
+ * @param limit The most friends to list
+ * @param compact Whether to list friends' handles alone
+ *
+ */
+void printInfo(person_t * p1, const person_t * after, size_t offset, size_t limit, bool compact){
+	//The frozen graph keeps friends in the same order, and nothing changes while it exists
+	const uint32_t* ids = NULL;
+	size_t count;
+	if(frozen != NULL){
+		ids = csr_neighbors(frozen, p1->id);
+		count = csr_degree(frozen, p1->id);
+	}
+	else{ //Keep the friend list still while printing
+		locks_user(locks, p1->id, false);
+		count = p1->friend_count;
+	}
+	if(after != NULL){ //Resume from the cursor, found through the friend index
+		offset = friends_position(p1, after);
+		if(offset == p1->friend_count){
+			fprintf(errors(), "error: %s is not friends with %s\n", p1->handle, after->handle);
+			if(frozen == NULL){
+				locks_release_user(locks, p1->id);
 			}
+			return;
 		}
+		offset++;
 	}
-	if(is_friendly){			//Add friend
-		//Check if either user is at their maximum friends
-		if(f1->friend_count >= f1->max_friends-1){
-			f1->max_friends += FRIEND_BLOCK;
-			f1->friends = (person_t**)realloc(f1->friends, f1->max_friends*sizeof(person_t*));
+	size_t end = offset < count ? offset + (limit < count - offset ? limit : count - offset) : offset;
+
+	//Keep the lines together
+	flockfile(output());
+	if(count == 0){			//User has no friends
+		fprintf(output(), "User %s %s(%s) has no friends\n",p1->first_name, p1->last_name, p1->handle);
+	}
+	else if(count == 1){		//User has 1 friend
+		fprintf(output(), "User %s %s(%s) has 1 friend\n", p1->first_name, p1->last_name, p1->handle);
+	}
+	else{				//User has 2+ friends
+		fprintf(output(), "User %s %s (%s) has %i friends\n", p1->first_name, p1->last_name, p1->handle,(int)count);
+	}
+	const char *last = NULL;
+	for(size_t i = offset; i < end; i++){ //List this page of friends
+		if(ids != NULL){
+			const csr_user_t* f = csr_user(frozen, ids[i]);
+			bufferFriend(f->first_name, f->last_name, f->handle, compact);
+			last = f->handle;
 		}
-		if(f2->friend_count >= f2->max_friends-1){
-			f2->max_friends += FRIEND_BLOCK;
-			f2->friends = (person_t**)realloc(f2->friends, f2->max_friends*sizeof(person_t*));
+		else{
+			const person_t* f = users[p1->friends[i]];
+			bufferFriend(f->first_name, f->last_name, f->handle, compact);
+			last = f->handle;
 		}
+	}
+	fwrite(print_buffer, 1, print_length, output());
+	print_length = 0;
+	if(end < count){ //Tell the reader where the next page starts
+		fprintf(output(), "%zu more after %s\n", count - end, last);
+	}
+	funlockfile(output());
+	if(frozen == NULL){
+		locks_release_user(locks, p1->id);
+	}
+}
 
-		//Adding new friend
-		f1->friends[f1->friend_count] = f2;
-		f2->friends[f2->friend_count] = f1;
-		
-		//Tallying friendships
-		f1->friend_count++;
-		f2->friend_count++;
-		friendships++;
+/*
+ * Prints the friends two users have in common
+ *
+ * @param p1 One user
+ * @param p2 The other user
+ *
+ */
+void printMutual(person_t * p1, person_t * p2){
+	uint32_t* ids;
+	size_t count = social_mutual(p1, p2, frozen, &ids);
+
+	if(count == 0){
+		fprintf(output(), "Users %s %s(%s) and %s %s(%s) have no mutual friends\n", p1->first_name, p1->last_name, p1->handle, p2->first_name, p2->last_name, p2->handle);
 	}
-	else{					//Remove friend
-		fprintf(stderr, "error: %s is not friends with %s\n", f1->handle, f2->handle);
-		return;
-	}	
+	else if(count == 1){
+		fprintf(output(), "Users %s %s(%s) and %s %s(%s) have 1 mutual friend\n", p1->first_name, p1->last_name, p1->handle, p2->first_name, p2->last_name, p2->handle);
+	}
+	else{
+		fprintf(output(), "Users %s %s(%s) and %s %s(%s) have %i mutual friends\n", p1->first_name, p1->last_name, p1->handle, p2->first_name, p2->last_name, p2->handle, (int)count);
+	}
+	for(size_t i = 0; i < count; i++){ //List mutual friends
+		person_t* f = users[ids[i]];
+		fprintf(output(), "\t%s %s(%s)\n", f->first_name, f->last_name, f->handle);
+	}
+	free(ids);
 }
 
 /*
- * Determines what command the user is attempting to perform, and run the function prescribed to it
+ * Prints the best friend suggestions for a user
  *
- * @param data An array of string commands
- * @pre Commands are separated into tokens
+ * @param p1 The user
+ * @param k The most suggestions to print
  *
  */
-void parseCommands(char ** data){
-	if(strcmp(data[0], "add") == 0){								//Add new user
-		if((data[1] != NULL && data[2] != NULL && data[3] != NULL)){ //Validate command length
-			//Copy data values
-			char *f_name = strdup(data[1]);
-			char *l_name = strdup(data[2]);
-			char *handle = strdup(data[3]);
-		
-			//Validate command syntax
-			if(handle[strlen(handle)-1] == '\n'){ //Remove newline character
-				handle[strlen(handle)-1] = '\0';
-			}
-			if(strlen(handle) < 1){ //Check for empty handles
-				fprintf(stderr, "error: add command usage: first-name last-name handle\n");
-			}
-			else if(!ht_has(t, (void*)handle)){ //Make sure handle is available
-		
-				//Person is initialized
-				person_t* new_person = calloc(1, sizeof(person_t));
-				new_person->first_name = strdup(f_name);
-				new_person->last_name = strdup(l_name);
-				new_person->handle = strdup(handle);
-				new_person->friends = (person_t**)calloc(FRIEND_BLOCK, sizeof(person_t*));
-				new_person->friend_count = 0;
-				new_person->max_friends = FRIEND_BLOCK;
-				
-				//Put new person in table and add to people count
-				ht_put(t, (void*)new_person->handle, (void*)new_person);
-				people++;
-			}
-			else{ //Handle is taken
-				fprintf(stderr, "error: The handle '%s' is taken by another user\n", data[3]);
-			}
-		
-			//Free allocated memory
-			free(f_name);
-			free(l_name);
-			free(handle);
-		}
-		else{ //Invalid command structure
-			fprintf(stderr, "error: add command usage: first-name last-name handle\n");
-		}
-	}
-	else if(strcmp(data[0], "friend") == 0){							//Make two users friends
-		if(data[1] != NULL && data[2] != NULL){ //Validate command length
-		
-			//Validate command syntax
-			if(data[2][strlen(data[2])-1] == '\n'){ //Remove newline character
-				data[2][strlen(data[2])-1] = '\0';
-			}
-			if(strlen(data[1]) < 1 || strlen(data[2]) < 1){ //Check for empty handles
-				fprintf(stderr, "error: friend command usage: friend handle1 handle2\n");
-			}
-			else if(ht_has(t, (void*)data[1]) && ht_has(t, (void*)data[2])){ //Check whether both users exist
-				char * handles[] = {data[1], data[2]};
-				//Add friendship
-				friend(handles, true);
-			}
-			else{ //At least one handle could not be found
-				fprintf(stderr, "error: one or more users not found\n");
-			}
-		}
-		else{ //Invalid command structure
-			fprintf(stderr, "error: friend command usage: friend handle1 handle2\n");
-		}
+void printSuggestions(person_t * p1, size_t k){
+	suggestion_t* best;
+	size_t count = social_suggest(p1, users, (size_t)people, frozen, k, &best);
+
+	if(count == 0){
+		fprintf(output(), "User %s %s(%s) has no friend suggestions\n", p1->first_name, p1->last_name, p1->handle);
 	}
-	else if(strcmp(data[0], "init") == 0 || strcmp(data[0], "init\n") == 0){			//Clear table and reset it
-		reformat(false);
+	else{
+		fprintf(output(), "Friend suggestions for %s %s(%s):\n", p1->first_name, p1->last_name, p1->handle);
 	}
-	else if(strcmp(data[0], "print") == 0){								//Print data on a specific user
-		if(data[1] != NULL){ //Validate command length
-		
-			//Validate command syntax
-			if(data[1][strlen(data[1])-1] == '\n'){ //Remove newline character
-				data[1][strlen(data[1])-1] = '\0';
-			}
-			if(ht_has(t, (void*)data[1])){ //Does user exist
-				printInfo(data[1]);
-			}
-			else{ //Handle could not be found
-				fprintf(stderr, "error: '%s' is not a valid user\n", data[1]);
-			}
+	for(size_t i = 0; i < count; i++){ //List suggestions, best first
+		person_t* f = users[best[i].id];
+		if(best[i].mutual == 1){
+			fprintf(output(), "\t%s %s(%s), 1 mutual friend\n", f->first_name, f->last_name, f->handle);
 		}
-		else{ //Invalid command structure
-			fprintf(stderr, "error: print command usage: print handle\n");
+		else{
+			fprintf(output(), "\t%s %s(%s), %u mutual friends\n", f->first_name, f->last_name, f->handle, best[i].mutual);
 		}
 	}
-	else if(strcmp(data[0], "quit") == 0 || strcmp(data[0], "quit\n") == 0){			//Clear table and exit program
-		reformat(true);
+	free(best);
+}
+
+/*
+ * Prints every user with a last name, and optionally a first name
+ *
+ * @param last The last name
+ * @param first The first name, or NULL for any
+ *
+ */
+void printFind(const char * last, const char * first){
+	size_t count;
+	const uint32_t* ids = names_find(names, last, first, &count);
+	const char* space = first != NULL ? " " : "";
+	first = first != NULL ? first : "";
+
+	if(count == 0){
+		fprintf(output(), "No users named %s%s%s\n", first, space, last);
+	}
+	else if(count == 1){
+		fprintf(output(), "1 user named %s%s%s:\n", first, space, last);
 	}
-	else if(strcmp(data[0], "size") == 0){								//Print number of friends a user has
-		if(data[1] != NULL){ //Validate command length
-		
-			//Validate command syntax
-			if(data[1][strlen(data[1])-1] == '\n'){ //Remove newline character
-				data[1][strlen(data[1])-1] = '\0';
-			}
-			if(ht_has(t, (void*)data[1])){ //Does user exist
-				person_t* temp = (person_t*)ht_get(t, (void*)data[1]);
-				if(temp->friend_count == 0){
-					printf("User %s %s('%s') has no friends\n", temp->first_name, temp->last_name, temp->handle);
-				}
-				else if(temp->friend_count == 1){
-					printf("User %s %s('%s') has 1 friend\n", temp->first_name, temp->last_name, temp->handle);
-				}
-				else{
-					printf("User %s %s('%s') has %i friends\n", temp->first_name, temp->last_name, temp->handle, (int)temp->friend_count);
-				}
- 			}
-			else{ //Handle could not be found
-				fprintf(stderr, "error: '%s' is not a valid user\n", data[1]);
-			}
+	else{
+		fprintf(output(), "%zu users named %s%s%s:\n", count, first, space, last);
+	}
+	for(size_t i = 0; i < count; i++){ //List users, oldest first
+		person_t* f = users[ids[i]];
+		fprintf(output(), "\t%s %s(%s)\n", f->first_name, f->last_name, f->handle);
+	}
+}
+
+/*
+ * Prints users whose first or last name starts with some text
+ *
+ * @param prefix The start of the name
+ * @param limit The most users to print
+ *
+ */
+void printPrefix(const char * prefix, size_t limit){
+	if(limit > (size_t)people){ //Never more matches than users
+		limit = people > 0 ? (size_t)people : 1;
+	}
+	uint32_t* ids = (uint32_t *)malloc(limit * sizeof(uint32_t));
+	size_t count = names_prefix(names, prefix, users, limit, ids);
+
+	if(count == 0){
+		fprintf(output(), "No users have a name starting with '%s'\n", prefix);
+	}
+	else{
+		fprintf(output(), "Users with a name starting with '%s':\n", prefix);
+	}
+	for(size_t i = 0; i < count; i++){ //List users by name
+		person_t* f = users[ids[i]];
+		fprintf(output(), "\t%s %s(%s)\n", f->first_name, f->last_name, f->handle);
+	}
+	free(ids);
+}
+
+/*
+ * Prints the users with the most friends
+ *
+ * @param k The most users to print
+ * @pre ranks_lock is held
+ *
+ */
+void printTop(size_t k){
+	if(k > (size_t)people){
+		k = (size_t)people;
+	}
+	const uint32_t* order = ranks_order(ranks);
+	fprintf(output(), "Top %zu %s by friends:\n", k, k == 1 ? "user" : "users");
+	for(size_t i = 0; i < k; i++){ //The first k users have the most friends
+		person_t* p1 = users[order[i]];
+		size_t count = ranks_degree(ranks, p1->id);
+		fprintf(output(), "\t%zu. %s %s(%s) has %zu %s\n", ranks_rank(ranks, p1->id), p1->first_name, p1->last_name, p1->handle,
+			count, count == 1 ? "friend" : "friends");
+	}
+}
+
+/*
+ * Prints where a user's number of friends ranks among all users
+ *
+ * @param p1 The user
+ * @pre ranks_lock is held
+ *
+ */
+void printRank(person_t * p1){
+	size_t count = ranks_degree(ranks, p1->id);
+	fprintf(output(), "User %s %s(%s) has %zu %s, rank %zu of %i\n", p1->first_name, p1->last_name, p1->handle,
+		count, count == 1 ? "friend" : "friends", ranks_rank(ranks, p1->id), people);
+}
+
+/*
+ * Prints how many triangles of friends a user is part of
+ *
+ * @param p1 The user
+ * @pre p1's user lock is held
+ *
+ */
+void printTriangles(person_t * p1){
+	unsigned long long count = (unsigned long long)triangles_count(triangles, p1->id);
+	fprintf(output(), "User %s %s(%s) is in %llu %s\n", p1->first_name, p1->last_name, p1->handle,
+		count, count == 1 ? "triangle" : "triangles");
+}
+
+/*
+ * Prints the fraction of pairs of a user's friends who are friends
+ *
+ * @param p1 The user
+ * @pre p1's user lock is held
+ *
+ */
+void printClustering(person_t * p1){
+	fprintf(output(), "User %s %s(%s) has clustering coefficient %.4f\n", p1->first_name, p1->last_name, p1->handle,
+		triangles_clustering(triangles, p1->id));
+}
+
+/*
+ * Scores every user's influence and prints the highest scores, scaled so
+ * the average user scores 1
+ *
+ * @param iterations The most iterations to run
+ * @param k The most users to list
+ * @pre the structure lock is held exclusively
+ *
+ */
+void printInfluence(size_t iterations, size_t k){
+	if(frozen == NULL){ //Score from the compact copy, which later reads reuse until the next change
+		frozen = csr_build(users, people);
+	}
+	double change;
+	size_t done = influence_run(influence, frozen, iterations, threads, &change);
+
+	if(k > (size_t)people){ //Never more than every user
+		k = people > 0 ? (size_t)people : 1;
+	}
+	uint32_t *top = (uint32_t *)malloc(k * sizeof(uint32_t));
+	k = influence_top(influence, k, top);
+	fprintf(output(), "Top %zu %s by influence after %zu %s (change %.2g):\n", k, k == 1 ? "user" : "users",
+		done, done == 1 ? "iteration" : "iterations", change);
+	for(size_t i = 0; i < k; i++){
+		person_t* p1 = users[top[i]];
+		fprintf(output(), "\t%zu. %s %s(%s) has influence %.4f\n", i + 1, p1->first_name, p1->last_name, p1->handle,
+			influence_score(influence, p1->id) * (double)people);
+	}
+	free(top);
+}
+
+/*
+ * Prints whether any chain of friendships links two users
+ *
+ * @param p1 One user
+ * @param p2 The other user
+ *
+ */
+void printConnected(person_t * p1, person_t * p2){
+	bool linked = components_connected(components, users, threads, p1->id, p2->id);
+	fprintf(output(), "Users %s %s(%s) and %s %s(%s) are %s\n", p1->first_name, p1->last_name, p1->handle, p2->first_name, p2->last_name, p2->handle, linked ? "connected" : "not connected");
+}
+
+/*
+ * Prints the shortest chain of friendships between two users, or its length
+ *
+ * @param p1 One user
+ * @param p2 The other user
+ * @param max The most hops to search
+ * @param full Whether to list every user on the chain
+ *
+ */
+void printPath(person_t * p1, person_t * p2, size_t max, bool full){
+	uint32_t* ids = NULL;
+	size_t hops = search_path(users, people, frozen, p1->id, p2->id, max, threads, full ? &ids : NULL);
+
+	if(hops == SEARCH_UNREACHABLE){
+		fprintf(output(), "Users %s %s(%s) and %s %s(%s) are not connected\n", p1->first_name, p1->last_name, p1->handle, p2->first_name, p2->last_name, p2->handle);
+	}
+	else if(hops == 1){
+		fprintf(output(), "Users %s %s(%s) and %s %s(%s) are 1 hop apart\n", p1->first_name, p1->last_name, p1->handle, p2->first_name, p2->last_name, p2->handle);
+	}
+	else{
+		fprintf(output(), "Users %s %s(%s) and %s %s(%s) are %i hops apart\n", p1->first_name, p1->last_name, p1->handle, p2->first_name, p2->last_name, p2->handle, (int)hops);
+	}
+	for(size_t i = 0; ids != NULL && i <= hops; i++){ //List the chain
+		person_t* f = users[ids[i]];
+		fprintf(output(), "\t%s %s(%s)\n", f->first_name, f->last_name, f->handle);
+	}
+	free(ids);
+}
+
+/*
+ * Adds or removes two users to/from each others' friend networks, and
+ * records the change in the journal
+ *
+ * @param f1 One user
+ * @param f2 The other user
+ * @param is_friendly Whether to add the friendship rather than remove it
+ * @pre the structure lock is held
+ * @pre if the graph is frozen, the structure lock is held exclusively
+ * @return Whether the friendship was changed
+ *
+ */
+bool friend(person_t * f1, person_t * f2, bool is_friendly){
+	bool changed = true;
+	if(is_friendly && f1 == f2){ //Friend lists hold each id once
+		fprintf(errors(), "error: %s cannot be friends with themselves\n", f1->handle);
+		return false;
+	}
+
+	//Friendships between other users may change at the same time
+	locks_pair(locks, f1->id, f2->id);
+	touchUser(f1);
+	touchUser(f2);
+	if(is_friendly){			//Add friend
+		if(friends_has(f1, f2)){
+			fprintf(errors(), "error: %s is already friends with %s\n", f1->handle, f2->handle);
+			changed = false;
 		}
-		else{ //Invalid command structure
-			fprintf(stderr, "error: print command usage: print handle\n");
+		else{
+			thaw();
+			friends_add(arena, f1, f2);
+			friends_add(arena, f2, f1);
+			triangles_link(triangles, f1, f2);
+			pthread_mutex_lock(&components_lock);
+			components_union(components, f1->id, f2->id);
+			pthread_mutex_unlock(&components_lock);
+			pthread_mutex_lock(&ranks_lock);
+			ranks_raise(ranks, f1->id);
+			ranks_raise(ranks, f2->id);
+			pthread_mutex_unlock(&ranks_lock);
+			__atomic_fetch_add(&friendships, 1, __ATOMIC_RELAXED);
 		}
 	}
-	else if(strcmp(data[0], "stats") == 0 || strcmp(data[0], "stats\n") == 0){			//Print cumulative user data
-		printStats();
-	}
-	else if(strcmp(data[0], "unfriend") == 0){							//Make two users not friends
-		if(data[1] != NULL && data[2] != NULL){ //Validate command length
-		
-			//Validate command syntax
-			if(data[2][strlen(data[2])-1] == '\n'){ //Remove newline character
-				data[2][strlen(data[2])-1] = '\0';
-			}
-			if(strlen(data[1]) < 1 || strlen(data[2]) < 1){ //Check for empty handles
-				fprintf(stderr, "error: unfriend command usage: unfriend handle1 handle2\n");
-			}
-			else if(ht_has(t, (void*)data[1]) && ht_has(t, (void*)data[2])){ //Check whether both users exist
-				char * handles[] = {data[1], data[2]};
-				//Remove friendship
-				friend(handles, false);
-			}
-			else{ //At least one handle could not be found
- 				fprintf(stderr, "error: users not found\n");
- 			}
+	else{					//Remove friend
+		if(!friends_remove(arena, f1, f2)){
+			fprintf(errors(), "error: %s is not friends with %s\n", f1->handle, f2->handle);
+			changed = false;
 		}
-		else{ //Invalid command structure
-			fprintf(stderr, "error: unfriend command usage: unfriend handle1 handle2\n");
+		else{
+			thaw();
+			friends_remove(arena, f2, f1);
+			triangles_unlink(triangles, f1, f2);
+			pthread_mutex_lock(&components_lock);
+			components_split(components, f1->id, f2->id);
+			pthread_mutex_unlock(&components_lock);
+			pthread_mutex_lock(&ranks_lock);
+			ranks_lower(ranks, f1->id);
+			ranks_lower(ranks, f2->id);
+			pthread_mutex_unlock(&ranks_lock);
+			__atomic_fetch_sub(&friendships, 1, __ATOMIC_RELAXED);
 		}
 	}
-	//Ignore any unrecognizable commands
+	if(changed){ //Journal while still locked, so changes to one pair stay in order
+		char * handles[] = {f1->handle, f2->handle};
+		journalChange(is_friendly ? JOURNAL_FRIEND : JOURNAL_UNFRIEND, handles);
+		touchUser(f1);
+		touchUser(f2);
+	}
+	locks_release_pair(locks, f1->id, f2->id);
+	return changed;
 }
 
 /*
- * The main method
+ * Deletes a user and their friendships, giving the last user their id
+ * Takes time proportional to the friends of both the removed and the last user
+ *
+ * @param p1 The user
+ * @pre the structure lock is held exclusively
  *
- * @return Whether the code ran successfully or not
  */
-int main(void){
+void removeUser(person_t * p1){
+	thaw();
+	uint32_t id = p1->id;
+	touchUser(p1);
 
-	//Initialize varaibles
-	char buffer[BUF_SIZE];
-	char *test;
-	char **input = (char **)calloc(MAX_COMMANDS, sizeof(char *));
-	const char *delim = " ";
-	is_active = true;
-	
-	//Create table
-	t = ht_create(str_hash, str_equals, tablePrint, tableDel);
+	//End the newest friendship first, so both sides drop it in constant time
+	while(p1->friend_count > 0){
+		person_t *f = users[p1->friends[p1->friend_count - 1]];
+		touchUser(f);
+		triangles_unlink(triangles, p1, f);
+		friends_remove(arena, f, p1);
+		friends_remove(arena, p1, f);
+		touchUser(f);
+		components_split(components, id, f->id);
+		ranks_lower(ranks, id);
+		ranks_lower(ranks, f->id);
+		friendships--;
+	}
+	components_remove(components, id);
+	names_remove(names, id);
+	ranks_remove(ranks, id);
+	triangles_remove(triangles, id);
+	influence_remove(influence, id);
+	if(tiers != NULL){
+		tiers_remove(tiers, id);
+	}
+	ht_remove(t, p1->handle);
 
-	while(is_active){ //Main loop
-		printf("amici> ");
-		fgets(buffer, BUF_SIZE, stdin);
-
-		//Isolate tokens from command line
-		test = strtok(buffer, delim);
-		for(int i = 0; i < MAX_COMMANDS; i++){
-			if(test != NULL){
-				input[i] = (char *)realloc(input[i], strlen(test)+1);
-				strcpy(input[i], test);
-				test = strtok(NULL, delim);
+	//Keep ids dense by moving the last user into the gap, under their new id in their friends' lists too
+	people--;
+	if(id != (uint32_t)people){
+		person_t *moved = users[people];
+		for(size_t i = 0; i < moved->friend_count; i++){ //Renaming in place must not write through to the file
+			touchUser(users[moved->friends[i]]);
+			friends_rename(users[moved->friends[i]], moved->id, id);
+		}
+		users[id] = moved;
+		moved->id = id;
+	}
+	users[people] = NULL;
+
+	//The record may sit in a snapshot's block, so keep it for the next add
+	p1->friends = (uint32_t *)(void *)spare_people;
+	spare_people = p1;
+}
+
+/*
+ * Applies a change read back from the journal
+ *
+ * @param op The kind of change
+ * @param args The handles and names the change was made with
+ */
+void replayChange(journal_op_t op, char ** args){
+	//A change that is already in effect came from a snapshot; skip it quietly
+	switch(op){
+		case JOURNAL_ADD:
+			createUser(args[0], args[1], args[2]);
+			break;
+		case JOURNAL_FRIEND:
+		case JOURNAL_UNFRIEND:{
+			person_t* f1 = ht_find(t, args[0]);
+			person_t* f2 = ht_find(t, args[1]);
+			if(f1 != NULL && f2 != NULL && friends_has(f1, f2) == (op == JOURNAL_UNFRIEND)){
+				friend(f1, f2, op == JOURNAL_FRIEND);
+			}
+			break;
+		}
+		case JOURNAL_INIT:
+			reformat(false);
+			break;
+		case JOURNAL_REMOVE:{
+			person_t* p1 = ht_find(t, args[0]);
+			if(p1 != NULL){
+				removeUser(p1);
 			}
-			else break;
+			break;
 		}
+	}
+}
+
+/*
+ * Replaces the (empty) network with the contents of a snapshot
+ *
+ * @param snap The snapshot
+ * @pre the network is empty
+ */
+void restoreSnapshot(Snapshot snap){
+	snapshot_restore(snap, arena, t, &users, &max_users);
+	people = (int)snapshot_users(snap);
+	friendships = (int)snapshot_friendships(snap);
 
-		//Parse commands
-		parseCommands(input);
+	//The snapshot bypasses createUser and friend, so rebuild the components, name index, ranks, triangles and scores
+	for(int i = 0; i < people; i++){
+		components_add(components, (uint32_t)i);
+		names_add(names, users[i]);
+		ranks_add(ranks, (uint32_t)i);
+		triangles_add(triangles, (uint32_t)i);
+		influence_add(influence, (uint32_t)i);
+		if(tiers != NULL){
+			tiers_add(tiers, users[i]);
+		}
+	}
+	for(int i = 0; i < people; i++){
+		for(size_t j = 0; j < users[i]->friend_count; j++){
+			components_union(components, (uint32_t)i, users[i]->friends[j]);
+			ranks_raise(ranks, (uint32_t)i);
+		}
 	}
+	triangles_recount(triangles, users, threads);
+}
 
-	//Free allocated memory and quit
-	for(int i = 0; i < MAX_COMMANDS; i++){
-		free(input[i]);
+/*
+ * Saves the network to the journal's snapshot and empties the journal,
+ * only once the snapshot is safely on disk
+ *
+ * @return Whether the network was saved and the journal emptied
+ */
+bool compactJournal(){
+	journal_sync(journal);
+	if(!snapshot_save(journal_snapshot, users, people, friendships)){
+		return false;
 	}
-	free(input);
-	ht_destroy(t);
-	return 0;
+	return journal_truncate(journal);
+}
+
+/*
+ * Adds every user and friendship in a pair of export files, with the same
+ * result as running the matching add and friend commands in file order
+ *
+ * @param users_path File of "first-name last-name handle" lines
+ * @param edges_path File of "handle1 handle2" lines
+ */
+void importFiles(const char * users_path, const char * edges_path){
+	Import people_file = import_read(users_path, 3, threads);
+	Import edges_file = import_read(edges_path, 2, threads);
+	if(people_file == NULL || edges_file == NULL){
+		fprintf(errors(), "error: could not read '%s'\n", people_file == NULL ? users_path : edges_path);
+		if(people_file != NULL){
+			import_close(people_file);
+		}
+		if(edges_file != NULL){
+			import_close(edges_file);
+		}
+		return;
+	}
+
+	//Users must exist before their handles can be resolved
+	thaw();
+	size_t taken = 0;
+	ht_reserve(t, (size_t)people + import_rows(people_file));
+	for(size_t i = 0; i < import_rows(people_file); i++){
+		char **row = import_row(people_file, i);
+		if(createUser(row[0], row[1], row[2]) == NULL){
+			taken++;
+		}
+	}
+
+	import_edges_t edges;
+	import_edges(edges_file, t, users, people, threads, &edges);
+	for(size_t i = 0; i < 2 * edges.count && tiers != NULL; i++){ //Only lists in memory can grow
+		touchUser(users[edges.pairs[i]]);
+	}
+	import_link(arena, users, people, &edges, threads);
+	for(size_t i = 0; i < 2 * edges.count && tiers != NULL; i++){
+		touchUser(users[edges.pairs[i]]);
+	}
+	for(size_t i = 0; i < edges.count; i++){
+		components_union(components, edges.pairs[2 * i], edges.pairs[2 * i + 1]);
+		ranks_raise(ranks, edges.pairs[2 * i]);
+		ranks_raise(ranks, edges.pairs[2 * i + 1]);
+	}
+	friendships += (int)edges.count;
+	triangles_link_all(triangles, users, edges.pairs, edges.count, threads);
+
+	//Report what replaying the lines one at a time would have rejected
+	if(import_malformed(people_file) > 0){
+		fprintf(errors(), "error: %zu lines of '%s' are not first-name last-name handle\n", import_malformed(people_file), users_path);
+	}
+	if(taken > 0){
+		fprintf(errors(), "error: %zu handles in '%s' were already taken\n", taken, users_path);
+	}
+	if(import_malformed(edges_file) > 0){
+		fprintf(errors(), "error: %zu lines of '%s' are not handle1 handle2\n", import_malformed(edges_file), edges_path);
+	}
+	if(edges.invalid > 0){
+		fprintf(errors(), "error: %zu friendships in '%s' name a missing user or the same user twice\n", edges.invalid, edges_path);
+	}
+	if(edges.repeated > 0){
+		fprintf(errors(), "error: %zu friendships in '%s' already existed\n", edges.repeated, edges_path);
+	}
+	free(edges.pairs);
+	import_close(people_file);
+	import_close(edges_file);
+
+	if(journal != NULL && !compactJournal()){ //The journal cannot describe an import
+		fprintf(errors(), "error: could not compact the journal\n");
+	}
+}
+
+bool runCommand(char ** data); //Used by load, defined after the command table
+const command_t* findCommand(const char * token); //Used by bg, defined after the command table
+
+//A command for a forked copy of the process to run
+typedef struct background_s{
+	const command_t *cmd;
+	char *data[MAX_COMMANDS];	//Its tokens, NULL after the last one
+} background_t;
+
+/*
+ * Looks up the users a command names, hashing each handle once
+ *
+ * @param handles The handles
+ * @param count The number of handles
+ * @param found Receives each user, or NULL where a handle is missing
+ * @return Whether every handle names a user
+ */
+bool findUsers(char ** handles, size_t count, person_t ** found){
+	bool all = true;
+	for(size_t i = 0; i < count; i++){
+		found[i] = ht_find(t, handles[i]);
+		all = all && found[i] != NULL;
+	}
+	return all;
+}
+
+/*
+ * Adds a new user
+ *
+ * @param data The command: add first-name last-name handle
+ */
+void commandAdd(char ** data){
+	if(createUser(data[1], data[2], data[3]) != NULL){ //Make sure handle is available
+		journalChange(JOURNAL_ADD, data + 1);
+	}
+	else{ //Handle is taken
+		fprintf(errors(), "error: The handle '%s' is taken by another user\n", data[3]);
+	}
+}
+
+/*
+ * Runs a command in a forked copy of the process, where no other thread
+ * runs, so it needs no locks
+ *
+ * @param out Where the command's results and errors go
+ * @param arg The command, a background_t
+ */
+void runBackground(FILE * out, void * arg){
+	background_t *job = (background_t *)arg;
+	client = out;
+	tiers = NULL; //Read cold lists where they are; the file is shared with the parent
+	job->cmd->run(job->data);
+}
+
+/*
+ * Starts a read-only command on a copy of the network as it is now
+ *
+ * @param data The command: bg command [arguments]
+ */
+void commandBackground(char ** data){
+	background_t job = {findCommand(data[1]), {NULL}};
+	if(job.cmd == NULL || !job.cmd->background){ //Changes would be lost with the copy
+		fprintf(errors(), "error: '%s' cannot run in the background\n", data[1]);
+		return;
+	}
+
+	char label[BUF_SIZE];
+	size_t length = 0;
+	size_t args = 0;
+	label[0] = '\0';
+	for(size_t i = 1; i < MAX_COMMANDS && data[i] != NULL; i++){ //Shift the command to the front and name the job after it
+		job.data[i - 1] = data[i];
+		args = i - 1;
+		if(length + strlen(data[i]) + 2 < sizeof(label)){ //Leave out what does not fit
+			length += (size_t)sprintf(label + length, i == 1 ? "%s" : " %s", data[i]);
+		}
+	}
+	if(args < job.cmd->min_args || args > job.cmd->max_args){ //Invalid command structure
+		fprintf(errors(), "error: %s command usage: %s\n", job.cmd->name, job.cmd->usage);
+		return;
+	}
+
+	if(tiers != NULL){ //The child reads cold lists from blocks the parent must not reuse
+		tiers_retain(tiers, true);
+	}
+	unsigned id = jobs_start(jobs, label, runBackground, &job);
+	if(id == 0){
+		fprintf(errors(), "error: could not start a background job\n");
+	}
+	else{
+		fprintf(output(), "Job %u started: %s\n", id, label);
+	}
+}
+
+/*
+ * Folds the journal into a snapshot
+ *
+ * @param data The command: compact
+ */
+void commandCompact(char ** data){
+	(void)data;
+	if(journal == NULL){
+		fprintf(errors(), "error: compact needs a journal (run with -j)\n");
+	}
+	else if(!compactJournal()){
+		fprintf(errors(), "error: could not compact the journal\n");
+	}
+}
+
+/*
+ * Checks whether two users are linked at all
+ *
+ * @param data The command: connected handle1 handle2
+ */
+void commandConnected(char ** data){
+	person_t* found[2];
+	if(findUsers(data + 1, 2, found)){ //Check whether both users exist
+		printConnected(found[0], found[1]);
+	}
+	else{ //At least one handle could not be found
+		fprintf(errors(), "error: one or more users not found\n");
+	}
+}
+
+/*
+ * Finds how two users are connected, as a hop count or a full chain
+ *
+ * @param data The command: distance handle1 handle2 [max-hops], or path handle1 handle2
+ */
+void commandPath(char ** data){
+	bool full = strcmp(data[0], "path") == 0;
+	size_t max = SEARCH_UNREACHABLE;
+	person_t* found[2];
+
+	if(data[3] != NULL){ //Validate the hop limit
+		char *end;
+		max = strtoul(data[3], &end, 10);
+		if(*end != '\0'){
+			fprintf(errors(), "error: distance command usage: distance handle1 handle2 [max-hops]\n");
+			return;
+		}
+	}
+	if(findUsers(data + 1, 2, found)){ //Check whether both users exist
+		printPath(found[0], found[1], max, full);
+	}
+	else{ //At least one handle could not be found
+		fprintf(errors(), "error: one or more users not found\n");
+	}
+}
+
+/*
+ * Finds users by name
+ *
+ * @param data The command: find last-name [first-name]
+ */
+void commandFind(char ** data){
+	printFind(data[1], data[2]);
+}
+
+/*
+ * Finds users by the start of a name
+ *
+ * @param data The command: find-prefix text [limit]
+ */
+void commandFindPrefix(char ** data){
+	size_t limit = FIND_LIMIT;
+	if(data[2] != NULL){ //Validate the limit
+		char *end;
+		limit = strtoul(data[2], &end, 10);
+		if(limit == 0 || *end != '\0'){
+			fprintf(errors(), "error: find-prefix command usage: find-prefix text [limit]\n");
+			return;
+		}
+	}
+	printPrefix(data[1], limit);
+}
+
+/*
+ * Compacts the graph for fast reads
+ *
+ * @param data The command: freeze
+ */
+void commandFreeze(char ** data){
+	(void)data;
+	thaw();
+	frozen = csr_build(users, people);
+}
+
+/*
+ * Makes two users friends, or stops them being friends
+ *
+ * @param data The command: friend handle1 handle2, or unfriend handle1 handle2
+ */
+void commandFriend(char ** data){
+	bool is_friendly = strcmp(data[0], "friend") == 0;
+	person_t* found[2];
+	if(findUsers(data + 1, 2, found)){ //Check whether both users exist
+		friend(found[0], found[1], is_friendly);
+	}
+	else if(is_friendly){ //At least one handle could not be found
+		fprintf(errors(), "error: one or more users not found\n");
+	}
+	else{
+		fprintf(errors(), "error: users not found\n");
+	}
+}
+
+/*
+ * Bulk loads users and friendships
+ *
+ * @param data The command: import users-file edges-file
+ */
+void commandImport(char ** data){
+	importFiles(data[1], data[2]);
+}
+
+/*
+ * Clears the network
+ *
+ * @param data The command: init
+ */
+void commandInit(char ** data){
+	(void)data;
+	reformat(false);
+	journalChange(JOURNAL_INIT, NULL);
+}
+
+/*
+ * Ranks users by influence
+ *
+ * @param data The command: influence [iterations] [count]
+ */
+void commandInfluence(char ** data){
+	size_t limits[2] = {INFLUENCE_ITERATIONS, INFLUENCE_TOP};
+	for(size_t i = 0; i < 2 && data[i + 1] != NULL; i++){ //Validate the iterations and count
+		char *end;
+		limits[i] = strtoul(data[i + 1], &end, 10);
+		if(limits[i] == 0 || *end != '\0'){
+			fprintf(errors(), "error: influence command usage: influence [iterations] [count]\n");
+			return;
+		}
+	}
+	printInfluence(limits[0], limits[1]);
+}
+
+/*
+ * Lists the background jobs
+ *
+ * @param data The command: jobs
+ */
+void commandJobs(char ** data){
+	(void)data;
+	jobs_list(jobs, output());
+}
+
+/*
+ * Runs commands from a file
+ *
+ * @param data The command: load file
+ */
+void commandLoad(char ** data){
+	if(load_depth == MAX_LOAD_DEPTH){
+		fprintf(errors(), "error: load files are nested more than %d deep\n", MAX_LOAD_DEPTH);
+		return;
+	}
+	char *path = strdup(data[1]); //data points into the line being replaced
+	load_depth++;
+	if(!batch_run_file(path, MAX_COMMANDS, runCommand)){
+		fprintf(errors(), "error: could not read '%s'\n", path);
+	}
+	load_depth--;
+	free(path);
+}
+
+/*
+ * Replaces the network with a snapshot
+ *
+ * @param data The command: load-snapshot file
+ */
+void commandLoadSnapshot(char ** data){
+	Snapshot snap = snapshot_open(data[1]);
+	if(snap != NULL){
+		reformat(false);
+		restoreSnapshot(snap);
+		snapshot_close(snap);
+		if(journal != NULL && !compactJournal()){ //The journal cannot describe a load
+			fprintf(errors(), "error: could not compact the journal\n");
+		}
+	}
+	else{ //File is missing or not a valid snapshot
+		fprintf(errors(), "error: '%s' is not a valid snapshot\n", data[1]);
+	}
+}
+
+/*
+ * Lists the friends two users share
+ *
+ * @param data The command: mutual handle1 handle2
+ */
+void commandMutual(char ** data){
+	person_t* found[2];
+	if(findUsers(data + 1, 2, found)){ //Check whether both users exist
+		printMutual(found[0], found[1]);
+	}
+	else{ //At least one handle could not be found
+		fprintf(errors(), "error: one or more users not found\n");
+	}
+}
+
+/*
+ * Prints data on a specific user
+ *
+ * @param data The command: print handle
+ */
+void commandPrint(char ** data){
+	bool compact = strcmp(data[0], "print-handles") == 0;
+	char *cursor = NULL;
+	char *numbers[2] = {NULL, NULL}; //Offset and limit
+	bool valid = true;
+	if(data[2] != NULL && strcmp(data[2], "after") == 0){
+		cursor = data[3];
+		numbers[1] = data[4];
+		valid = cursor != NULL;
+	}
+	else{
+		numbers[0] = data[2];
+		numbers[1] = data[3];
+		valid = data[4] == NULL;
+	}
+	size_t page[2] = {0, SIZE_MAX};
+	for(size_t i = 0; i < 2 && valid; i++){ //Validate the offset and limit
+		if(numbers[i] != NULL){
+			char *end;
+			page[i] = strtoul(numbers[i], &end, 10);
+			valid = *end == '\0' && (i == 0 || page[i] != 0); //A page holds at least one friend
+		}
+	}
+	if(!valid){
+		fprintf(errors(), "error: %s command usage: %s handle [offset [limit] | after friend-handle [limit]]\n", data[0], data[0]);
+		return;
+	}
+
+	person_t* p1 = ht_find(t, data[1]);
+	person_t* after = cursor != NULL ? ht_find(t, cursor) : NULL;
+	if(p1 == NULL || (cursor != NULL && after == NULL)){ //Handle could not be found
+		fprintf(errors(), "error: '%s' is not a valid user\n", p1 == NULL ? data[1] : cursor);
+	}
+	else{
+		warmUser(p1);
+		printInfo(p1, after, page[0], page[1], compact);
+	}
+}
+
+/*
+ * Reports where time and memory go, or controls command timing
+ *
+ * @param data The command: profile [on|off|reset]
+ */
+void commandProfile(char ** data){
+	if(data[1] == NULL){
+		printProfile();
+	}
+	else if(strcmp(data[1], "on") == 0 || strcmp(data[1], "off") == 0){
+		profile_enable(profile, strcmp(data[1], "on") == 0);
+	}
+	else if(strcmp(data[1], "reset") == 0){
+		profile_reset(profile);
+	}
+	else{ //Unknown option
+		fprintf(errors(), "error: profile command usage: profile [on|off|reset]\n");
+	}
+}
+
+/*
+ * Reports where a user ranks by number of friends
+ *
+ * @param data The command: rank handle
+ */
+void commandRank(char ** data){
+	person_t* p1 = ht_find(t, data[1]);
+	if(p1 != NULL){ //Does user exist
+		pthread_mutex_lock(&ranks_lock);
+		printRank(p1);
+		pthread_mutex_unlock(&ranks_lock);
+	}
+	else{ //Handle could not be found
+		fprintf(errors(), "error: '%s' is not a valid user\n", data[1]);
+	}
+}
+
+/*
+ * Counts every triangle again to check the counts kept as friendships change
+ *
+ * @param data The command: recount
+ */
+void commandRecount(char ** data){
+	(void)data;
+	size_t wrong = triangles_recount(triangles, users, threads);
+	fprintf(output(), "Triangles: %llu after recounting, %zu %s corrected\n", (unsigned long long)triangles_total(triangles),
+		wrong, wrong == 1 ? "user" : "users");
+}
+
+/*
+ * Deletes a user
+ *
+ * @param data The command: remove handle
+ */
+void commandRemove(char ** data){
+	person_t* p1 = ht_find(t, data[1]);
+	if(p1 != NULL){ //Does user exist
+		removeUser(p1);
+		journalChange(JOURNAL_REMOVE, data + 1);
+	}
+	else{ //Handle could not be found
+		fprintf(errors(), "error: '%s' is not a valid user\n", data[1]);
+	}
+}
+
+/*
+ * Prints a user's triangle count or clustering coefficient, read under
+ * their user lock so their friends are not counted halfway through a change
+ *
+ * @param data The command: triangles handle, or clustering handle
+ */
+void commandTriangles(char ** data){
+	person_t* p1 = ht_find(t, data[1]);
+	if(p1 == NULL){ //Handle could not be found
+		fprintf(errors(), "error: '%s' is not a valid user\n", data[1]);
+		return;
+	}
+	locks_user(locks, p1->id, false);
+	if(strcmp(data[0], "clustering") == 0){
+		printClustering(p1);
+	}
+	else{
+		printTriangles(p1);
+	}
+	locks_release_user(locks, p1->id);
+}
+
+/*
+ * Clears the network and exits
+ *
+ * @param data The command: quit
+ */
+void commandQuit(char ** data){
+	(void)data;
+	reformat(true);
+}
+
+/*
+ * Writes the network to a snapshot
+ *
+ * @param data The command: save file
+ */
+void commandSave(char ** data){
+	if(!snapshot_save(data[1], users, people, friendships)){
+		fprintf(errors(), "error: could not write '%s'\n", data[1]);
+	}
+}
+
+/*
+ * Prints the results of finished background jobs
+ *
+ * @param data The command: poll [job]
+ */
+void commandPoll(char ** data){
+	if(data[1] == NULL){ //Every finished job
+		if(jobs_collect_all(jobs, output()) == 0){
+			fprintf(output(), "No finished jobs\n");
+		}
+		return;
+	}
+
+	char *end;
+	unsigned long id = strtoul(data[1], &end, 10);
+	if(id == 0 || id > UINT_MAX || *end != '\0'){ //Validate the job number
+		fprintf(errors(), "error: poll command usage: poll [job]\n");
+		return;
+	}
+	switch(jobs_collect(jobs, (unsigned)id, output())){
+		case JOB_UNKNOWN:
+			fprintf(errors(), "error: there is no job %lu\n", id);
+			break;
+		case JOB_RUNNING:
+			fprintf(output(), "Job %lu is still running\n", id);
+			break;
+		case JOB_DONE:
+			break;
+	}
+}
+
+/*
+ * Prints the number of friends a user has
+ *
+ * @param data The command: size handle
+ */
+void commandSize(char ** data){
+	person_t* temp = ht_find(t, data[1]);
+	if(temp == NULL){ //Handle could not be found
+		fprintf(errors(), "error: '%s' is not a valid user\n", data[1]);
+		return;
+	}
+	warmUser(temp);
+	locks_user(locks, temp->id, false);
+	size_t count = temp->friend_count;
+	locks_release_user(locks, temp->id);
+	if(count == 0){
+		fprintf(output(), "User %s %s('%s') has no friends\n", temp->first_name, temp->last_name, temp->handle);
+	}
+	else if(count == 1){
+		fprintf(output(), "User %s %s('%s') has 1 friend\n", temp->first_name, temp->last_name, temp->handle);
+	}
+	else{
+		fprintf(output(), "User %s %s('%s') has %i friends\n", temp->first_name, temp->last_name, temp->handle, (int)count);
+	}
+}
+
+/*
+ * Prints cumulative user data
+ *
+ * @param data The command: stats
+ */
+void commandStats(char ** data){
+	(void)data;
+	printStats();
+}
+
+/*
+ * Suggests friends of friends
+ *
+ * @param data The command: suggest handle [count]
+ */
+void commandSuggest(char ** data){
+	size_t k = SOCIAL_SUGGESTIONS;
+	if(data[2] != NULL){ //Validate the count
+		char *end;
+		k = strtoul(data[2], &end, 10);
+		if(k == 0 || *end != '\0'){
+			fprintf(errors(), "error: suggest command usage: suggest handle [count]\n");
+			return;
+		}
+	}
+	person_t* p1 = ht_find(t, data[1]);
+	if(p1 != NULL){ //Does user exist
+		printSuggestions(p1, k);
+	}
+	else{ //Handle could not be found
+		fprintf(errors(), "error: '%s' is not a valid user\n", data[1]);
+	}
+}
+
+/*
+ * Lists the users with the most friends
+ *
+ * @param data The command: top count
+ */
+void commandTop(char ** data){
+	char *end;
+	size_t k = strtoul(data[1], &end, 10);
+	if(k == 0 || *end != '\0'){ //Validate the count
+		fprintf(errors(), "error: top command usage: top count\n");
+		return;
+	}
+	pthread_mutex_lock(&ranks_lock);
+	flockfile(output());
+	printTop(k);
+	funlockfile(output());
+	pthread_mutex_unlock(&ranks_lock);
+}
+
+/*
+ * Every command, in alphabetical order. Lookups of single users and changes
+ * to friendships share the structure lock; anything that adds users,
+ * replaces the network, or reads many users' friend lists at once takes it
+ * alone. load takes no lock because each command it runs locks for itself,
+ * and neither do jobs and poll, which never touch the network. bg takes it
+ * alone only while it forks, so the copy holds no change halfway done.
+ */
+const command_t commands[] = {
+	{"add",			3, 4, LOCK_EXCLUSIVE,	false,	commandAdd,		"first-name last-name handle"},
+	{"bg",			1, 4, LOCK_EXCLUSIVE,	false,	commandBackground,	"bg command [arguments]"},
+	{"clustering",		1, 4, LOCK_SHARED,	true,	commandTriangles,	"clustering handle"},
+	{"compact",		0, 4, LOCK_EXCLUSIVE,	false,	commandCompact,		"compact"},
+	{"connected",		2, 4, LOCK_COMPONENTS,	true,	commandConnected,	"connected handle1 handle2"},
+	{"distance",		2, 4, LOCK_EXCLUSIVE,	true,	commandPath,		"distance handle1 handle2 [max-hops]"},
+	{"find",		1, 2, LOCK_SHARED,	true,	commandFind,		"find last-name [first-name]"},
+	{"find-prefix",		1, 2, LOCK_SHARED,	true,	commandFindPrefix,	"find-prefix text [limit]"},
+	{"freeze",		0, 4, LOCK_EXCLUSIVE,	false,	commandFreeze,		"freeze"},
+	{"friend",		2, 4, LOCK_FRIENDSHIP,	false,	commandFriend,		"friend handle1 handle2"},
+	{"import",		2, 2, LOCK_EXCLUSIVE,	false,	commandImport,		"import users-file edges-file"},
+	{"influence",		0, 2, LOCK_EXCLUSIVE,	true,	commandInfluence,	"influence [iterations] [count]"},
+	{"init",		0, 4, LOCK_EXCLUSIVE,	false,	commandInit,		"init"},
+	{"jobs",		0, 4, LOCK_NONE,	false,	commandJobs,		"jobs"},
+	{"load",		1, 4, LOCK_NONE,	false,	commandLoad,		"load file"},
+	{"load-snapshot",	1, 4, LOCK_EXCLUSIVE,	false,	commandLoadSnapshot,	"load-snapshot file"},
+	{"mutual",		2, 4, LOCK_EXCLUSIVE,	true,	commandMutual,		"mutual handle1 handle2"},
+	{"path",		2, 2, LOCK_EXCLUSIVE,	true,	commandPath,		"path handle1 handle2"},
+	{"poll",		0, 1, LOCK_NONE,	false,	commandPoll,		"poll [job]"},
+	{"print",		1, 4, LOCK_SHARED,	true,	commandPrint,		"print handle [offset [limit] | after friend-handle [limit]]"},
+	{"print-handles",	1, 4, LOCK_SHARED,	true,	commandPrint,		"print-handles handle [offset [limit] | after friend-handle [limit]]"},
+	{"profile",		0, 1, LOCK_EXCLUSIVE,	false,	commandProfile,		"profile [on|off|reset]"},
+	{"quit",		0, 4, LOCK_SHARED,	false,	commandQuit,		"quit"},
+	{"rank",		1, 4, LOCK_SHARED,	true,	commandRank,		"rank handle"},
+	{"recount",		0, 4, LOCK_EXCLUSIVE,	false,	commandRecount,		"recount"},
+	{"remove",		1, 4, LOCK_EXCLUSIVE,	false,	commandRemove,		"remove handle"},
+	{"save",		1, 4, LOCK_EXCLUSIVE,	true,	commandSave,		"save file"},
+	{"size",		1, 4, LOCK_SHARED,	true,	commandSize,		"size handle"},
+	{"stats",		0, 4, LOCK_COMPONENTS,	true,	commandStats,		"stats"},
+	{"suggest",		1, 4, LOCK_EXCLUSIVE,	true,	commandSuggest,		"suggest handle [count]"},
+	{"top",			1, 4, LOCK_SHARED,	true,	commandTop,		"top count"},
+	{"triangles",		1, 4, LOCK_SHARED,	true,	commandTriangles,	"triangles handle"},
+	{"unfriend",		2, 4, LOCK_FRIENDSHIP,	false,	commandFriend,		"unfriend handle1 handle2"},
+	{NULL,			0, 0, LOCK_NONE,	false,	NULL,			NULL}
+};
+
+uint8_t command_slots[COMMAND_SLOTS];	//Command number + 1 by hash of its name, 0 if empty
+pthread_once_t command_slots_once = PTHREAD_ONCE_INIT;
+
+/*
+ * Hashes a command name
+ *
+ * @param name The name
+ * @return The name's slot before probing
+ */
+size_t commandHash(const char * name){
+	uint32_t h = 2166136261u;
+	for(const unsigned char *c = (const unsigned char *)name; *c != '\0'; c++){
+		h = (h ^ *c) * 16777619u;
+	}
+	return (h ^ h >> 15) & (COMMAND_SLOTS - 1);
+}
+
+/*
+ * Fills the dispatch table with every command
+ *
+ */
+void buildDispatch(){
+	for(size_t c = 0; commands[c].name != NULL; c++){
+		size_t i = commandHash(commands[c].name);
+		while(command_slots[i] != 0){
+			i = (i + 1) & (COMMAND_SLOTS - 1);
+		}
+		command_slots[i] = (uint8_t)(c + 1);
+	}
+}
+
+/*
+ * Finds the command a token names
+ *
+ * @param token The first token of a command
+ * @return The command, or NULL if there is no such command
+ */
+const command_t* findCommand(const char * token){
+	pthread_once(&command_slots_once, buildDispatch);
+	for(size_t i = commandHash(token); command_slots[i] != 0; i = (i + 1) & (COMMAND_SLOTS - 1)){
+		const command_t* cmd = &commands[command_slots[i] - 1];
+		if(strcmp(cmd->name, token) == 0){
+			return cmd;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Counts the commands
+ *
+ * @return The number of entries in commands before the NULL one
+ */
+size_t commandCount(){
+	size_t c = 0;
+	while(commands[c].name != NULL){
+		c++;
+	}
+	return c;
+}
+
+/*
+ * Runs one tokenized command, holding the locks it needs. Several threads
+ * may run commands at once; lookups and friendship changes on unrelated
+ * users proceed side by side.
+ *
+ * @param data An array of MAX_COMMANDS tokens, NULL after the last one
+ * @return Whether the program should keep reading commands
+ */
+bool runCommand(char ** data){
+	uint64_t start = profile_start(profile);
+	const command_t* cmd = findCommand(data[0]);
+	if(cmd == NULL){ //Ignore any unrecognizable commands
+		return is_active;
+	}
+	size_t args = 0;
+	while(args + 1 < MAX_COMMANDS && data[args + 1] != NULL){
+		args++;
+	}
+	if(args < cmd->min_args || args > cmd->max_args){ //Invalid command structure
+		fprintf(errors(), "error: %s command usage: %s\n", cmd->name, cmd->usage);
+		return is_active;
+	}
+
+	lock_mode_t mode = cmd->lock;
+	bool guard = false;
+	if(mode == LOCK_FRIENDSHIP || mode == LOCK_COMPONENTS){
+		locks_structure(locks, false);
+		if(mode == LOCK_FRIENDSHIP){ //Thawing frees the graph print may be reading
+			mode = frozen != NULL ? LOCK_EXCLUSIVE : LOCK_SHARED;
+		}
+		else{ //Hold friendship changes back while counting; splits need the whole graph
+			pthread_mutex_lock(&components_lock);
+			guard = !components_pending(components);
+			if(!guard){
+				pthread_mutex_unlock(&components_lock);
+			}
+			mode = guard ? LOCK_SHARED : LOCK_EXCLUSIVE;
+		}
+		if(mode == LOCK_EXCLUSIVE){
+			locks_release_structure(locks);
+		}
+	}
+	else if(mode == LOCK_SHARED){
+		locks_structure(locks, false);
+	}
+	if(mode == LOCK_EXCLUSIVE){
+		locks_structure(locks, true);
+	}
+	if(tiers != NULL && mode != LOCK_NONE){ //No job can start while the lock is held
+		tiers_retain(tiers, jobs_running(jobs) > 0);
+	}
+
+	cmd->run(data);
+
+	if(guard){
+		pthread_mutex_unlock(&components_lock);
+	}
+	if(mode != LOCK_NONE){
+		locks_release_structure(locks);
+	}
+	if(tiers != NULL && tiers_over(tiers)){ //Move lists nobody used lately out of memory
+		locks_structure(locks, true);
+		tiers_balance(tiers, arena, users);
+		locks_release_structure(locks);
+	}
+	profile_record(profile, (size_t)(cmd - commands), start);
+	return is_active;
+}
+
+/*
+ * Runs one command for a client, replying to the client instead of on
+ * stdout and stderr
+ *
+ * @param data An array of MAX_COMMANDS tokens, NULL after the last one
+ * @param out The stream the client's reply is gathered in
+ * @return Whether the server should keep running
+ */
+bool serveCommand(char ** data, FILE * out){
+	client = out;
+	bool active = runCommand(data);
+	client = NULL;
+	return active;
+}
+
+/*
+ * Syncs the journal while the server waits for clients, as the prompt does
+ * while it waits for input
+ *
+ */
+void serverIdle(){
+	if(journal != NULL){
+		journal_sync(journal);
+	}
+}
+
+/*
+ * Restores the network from the journal's snapshot and journal, and
+ * reports why if it cannot. A missing snapshot means the journal holds
+ * everything, but a damaged one is never passed over, since the next
+ * compact would overwrite the only copy of the network.
+ *
+ * @param path The journal file
+ * @param group The number of records per group commit
+ * @param interval The longest time in milliseconds a record may wait
+ * @return Whether the snapshot, if any, was valid and the journal could be
+ *         opened
+ */
+bool recover(const char * path, size_t group, unsigned interval){
+	journal_snapshot = (char *)malloc(strlen(path) + sizeof(".snap"));
+	strcpy(journal_snapshot, path);
+	strcat(journal_snapshot, ".snap");
+
+	Snapshot snap = snapshot_open(journal_snapshot);
+	if(snap != NULL){
+		restoreSnapshot(snap);
+		snapshot_close(snap);
+	}
+	else if(access(journal_snapshot, F_OK) == 0 || errno != ENOENT){
+		fprintf(stderr, "error: '%s' is not a valid snapshot\n", journal_snapshot);
+		return false;
+	}
+
+	size_t replayed;
+	journal = journal_open(path, group, interval, replayChange, &replayed);
+	if(journal == NULL){
+		fprintf(stderr, "error: could not open journal '%s'\n", path);
+	}
+	return journal != NULL;
+}
+
+/*
+ * The main method
+ *
+ * Run with no arguments for the interactive prompt, or with -b [file] to
+ * run every command in file (or standard input) without prompting. With
+ * -j journal, the network is recovered from the journal on startup and
+ * every change is recorded in it; -g and -i set how many records, or how
+ * many milliseconds, may pass between syncs. -p sets how many threads a
+ * single query may use. With -l address, clients send commands over a
+ * socket instead, served by -p event loops. -m keeps friend lists within
+ * that many megabytes of memory, moving the rest to the -t file.
+ *
+ * @param argc The number of command line arguments
+ * @param argv The command line arguments
+ * @return Whether the code ran successfully or not
+ */
+int main(int argc, char **argv){
+
+	//Initialize varaibles
+	size_t capacity = BUF_SIZE;
+	char *buffer = (char *)malloc(capacity);
+	char *input[MAX_COMMANDS];
+	bool batch = false;
+	const char *journal_path = NULL;
+	const char *address = NULL;
+	const char *tier_path = NULL;
+	bool tiered = false;
+	size_t budget = 0;
+	size_t group = JOURNAL_GROUP;
+	unsigned interval = JOURNAL_INTERVAL;
+	int status = EXIT_SUCCESS;
+	int opt;
+	is_active = true;
+
+	while((opt = getopt(argc, argv, "bj:g:i:l:m:p:t:")) != -1){ //Read options
+		switch(opt){
+			case 'b':
+				batch = true;
+				break;
+			case 'j':
+				journal_path = optarg;
+				break;
+			case 'g':
+				group = strtoul(optarg, NULL, 10);
+				break;
+			case 'i':
+				interval = (unsigned)strtoul(optarg, NULL, 10);
+				break;
+			case 'l':
+				address = optarg;
+				break;
+			case 'm':
+				tiered = true;
+				budget = strtoul(optarg, NULL, 10) * 1024 * 1024;
+				break;
+			case 'p':
+				threads = (unsigned)strtoul(optarg, NULL, 10);
+				break;
+			case 't':
+				tier_path = optarg;
+				break;
+			default:
+				group = 0;
+				break;
+		}
+	}
+	if(group == 0 || threads == 0 || optind < argc - 1 || (optind < argc && !batch) || (batch && address != NULL)
+		|| (tier_path != NULL && !tiered)){
+		fprintf(stderr, "usage: amici [-p threads] [-j journal [-g records] [-i milliseconds]] [-m megabytes [-t file]] "
+			"[-b [command-file] | -l port-or-socket]\n");
+		free(buffer);
+		return EXIT_FAILURE;
+	}
+	const char *command_file = optind < argc ? argv[optind] : NULL;
+	if(batch){ //Buffer output before anything is printed
+		batch_buffer_output();
+	}
+
+	//Create table and the arena backing its contents
+	arena = arena_create();
+	t = ht_create(tablePrint, NULL);
+	components = components_create();
+	locks = locks_create();
+	names = names_create();
+	ranks = ranks_create();
+	triangles = triangles_create();
+	influence = influence_create();
+	jobs = jobs_create();
+	profile = profile_create(commandCount());
+
+	if(tiered && (tiers = tiers_create(tier_path, budget)) == NULL){
+		fprintf(stderr, "error: could not map '%s'\n", tier_path != NULL ? tier_path : "a temporary file");
+		status = EXIT_FAILURE;
+		is_active = false;
+	}
+
+	if(is_active && journal_path != NULL && !recover(journal_path, group, interval)){
+		status = EXIT_FAILURE;
+		is_active = false;
+	}
+	if(tiers != NULL){ //A large recovered network starts within its budget
+		tiers_balance(tiers, arena, users);
+	}
+
+	if(batch && is_active){ //Run commands without prompting
+		bool ok = command_file != NULL ? batch_run_file(command_file, MAX_COMMANDS, runCommand)
+			: batch_run_stream(stdin, MAX_COMMANDS, runCommand);
+		if(!ok){
+			fprintf(stderr, "error: could not read '%s'\n", command_file != NULL ? command_file : "stdin");
+			status = EXIT_FAILURE;
+		}
+		is_active = false;
+	}
+
+	if(address != NULL && is_active){ //Answer clients instead of prompting
+		if(!server_run(address, threads, MAX_COMMANDS, serveCommand, serverIdle)){
+			fprintf(stderr, "error: could not listen on '%s'\n", address);
+			status = EXIT_FAILURE;
+		}
+		is_active = false;
+	}
+
+	while(is_active){ //Main loop
+		if(journal != NULL){ //Nothing waits in the journal while the user types
+			journal_sync(journal);
+		}
+		jobs_announce(jobs, stdout);
+		printf("amici> ");
+		if(getline(&buffer, &capacity, stdin) < 0){ //End of input quits
+			break;
+		}
+
+		//Isolate tokens from command line and parse them
+		if(batch_tokenize(buffer, input, MAX_COMMANDS) > 0){
+			runCommand(input);
+		}
+	}
+
+	//Free allocated memory and quit
+	if(journal != NULL && !journal_close(journal)){
+		fprintf(stderr, "error: could not write to the journal\n");
+		status = EXIT_FAILURE;
+	}
+	thaw();
+	free(journal_snapshot);
+	free(buffer);
+	ht_destroy(t);
+	components_destroy(components);
+	locks_destroy(locks);
+	names_destroy(names);
+	ranks_destroy(ranks);
+	triangles_destroy(triangles);
+	influence_destroy(influence);
+	jobs_destroy(jobs);
+	if(tiers != NULL){
+		tiers_destroy(tiers);
+	}
+	profile_destroy(profile);
+	arena_destroy(arena);
+	return status;
 }
@@ -0,0 +1,319 @@
+/*
+ * file: arena.c
+ *
+ * Chunked region allocator with power-of-two free lists and a string
+ * intern set. Small blocks are bump-allocated from the newest chunk; the
+ * intern set is itself stored in the arena so a reset forgets it for free.
+ * A mutex makes every public function safe to call from several threads;
+ * the static helpers expect the caller to hold it.
+ *
+ * @author Bennett Moore bwm7637@rit.edu
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+#define MIN_CLASS 4		// log2(ARENA_ALIGN)
+#define NUM_CLASSES 64
+#define INTERN_CAPACITY 64	// Initial number of intern slots
+
+typedef struct chunk_s{
+	struct chunk_s *next;		// Previously filled chunk
+	size_t size;			// Bytes in this chunk, header included
+} chunk_t;
+
+typedef struct large_s{
+	struct large_s *prev;		// Neighbours in the list of large blocks
+	struct large_s *next;
+	size_t size;			// Bytes in this block, header included
+	size_t pad;			// Keeps the payload aligned
+} large_t;
+
+typedef struct free_s{
+	struct free_s *next;		// Next free block of the same class
+} free_t;
+
+typedef struct intern_s{
+	size_t hash;			// Hash of str
+	char *str;			// Interned string, NULL if the slot is empty
+} intern_t;
+
+struct Arena_t{
+	chunk_t *chunks;		// Newest chunk first
+	char *top;			// Next free byte of the newest chunk
+	char *end;			// One past the last byte of the newest chunk
+	size_t chunk_size;		// Size of the next chunk to request
+	large_t *large;			// Blocks too big for a chunk
+	free_t *free[NUM_CLASSES];	// Released blocks by size class
+	size_t footprint;		// Bytes obtained from the system
+	intern_t *interned;		// Intern set slots
+	size_t intern_capacity;		// Number of intern slots, a power of two
+	size_t intern_size;		// Number of interned strings
+	pthread_mutex_t lock;		// Held by every public function, kept last
+};
+
+/*
+ * Gets the size class of a block
+ *
+ * @param size The requested size
+ * @return The smallest k such that 2^k >= size and 2^k >= ARENA_ALIGN
+ */
+static inline unsigned sizeClass(size_t size){
+	if(size <= ((size_t)1 << MIN_CLASS)){
+		return MIN_CLASS;
+	}
+	return (unsigned)(64 - __builtin_clzll((unsigned long long)(size - 1)));
+}
+
+/*
+ * Hashes a string for the intern set
+ *
+ * @param str The string to hash
+ * @return A 64-bit FNV-1a hash of str
+ */
+static size_t hashString(const char *str){
+	uint64_t h = 0xcbf29ce484222325ULL;
+	for(const unsigned char *c = (const unsigned char *)str; *c != '\0'; c++){
+		h = (h ^ *c) * 0x100000001b3ULL;
+	}
+	return (size_t)(h ^ (h >> 32));
+}
+
+/*
+ * Carves bytes off the newest chunk, starting a new chunk if needed
+ *
+ * @param a The arena
+ * @param size The number of bytes, a multiple of ARENA_ALIGN
+ * @return The start of the carved bytes
+ */
+static void *bump(Arena a, size_t size){
+	if((size_t)(a->end - a->top) < size){
+		size_t chunk = a->chunk_size;
+		while(chunk - sizeof(chunk_t) < size){
+			chunk *= 2;
+		}
+		chunk_t *c = (chunk_t *)aligned_alloc(ARENA_ALIGN, chunk);
+		assert(c != NULL);
+		c->next = a->chunks;
+		c->size = chunk;
+		a->chunks = c;
+		a->top = (char *)c + sizeof(chunk_t);
+		a->end = (char *)c + chunk;
+		a->footprint += chunk;
+		if(a->chunk_size < ARENA_MAX_CHUNK){
+			a->chunk_size *= 2;
+		}
+	}
+	void *block = a->top;
+	a->top += size;
+	return block;
+}
+
+Arena arena_create( void ){
+	Arena a = (Arena)calloc(1, sizeof(struct Arena_t));
+	assert(a != NULL);
+	a->chunk_size = ARENA_MIN_CHUNK;
+	pthread_mutex_init(&a->lock, NULL);
+	return a;
+}
+
+void arena_destroy( Arena a ){
+	arena_reset(a);
+	pthread_mutex_destroy(&a->lock);
+	free(a);
+}
+
+void arena_reset( Arena a ){
+	pthread_mutex_lock(&a->lock);
+	while(a->chunks != NULL){
+		chunk_t *next = a->chunks->next;
+		free(a->chunks);
+		a->chunks = next;
+	}
+	while(a->large != NULL){
+		large_t *next = a->large->next;
+		free(a->large);
+		a->large = next;
+	}
+	memset(a, 0, offsetof(struct Arena_t, lock)); //Everything but the mutex
+	a->chunk_size = ARENA_MIN_CHUNK;
+	pthread_mutex_unlock(&a->lock);
+}
+
+/*
+ * Allocates a block, with the arena's mutex held
+ *
+ * @param a The arena
+ * @param size The number of bytes wanted
+ * @return The block
+ */
+static void *allocBlock(Arena a, size_t size){
+	assert(size != 0);
+	if(size > ARENA_LARGE_BLOCK){
+		size_t total = (sizeof(large_t) + size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+		large_t *l = (large_t *)aligned_alloc(ARENA_ALIGN, total);
+		assert(l != NULL);
+		l->prev = NULL;
+		l->next = a->large;
+		l->size = total;
+		if(a->large != NULL){
+			a->large->prev = l;
+		}
+		a->large = l;
+		a->footprint += total;
+		return l + 1;
+	}
+
+	unsigned k = sizeClass(size);
+	if(a->free[k] != NULL){ //Reuse a released block
+		free_t *block = a->free[k];
+		a->free[k] = block->next;
+		return block;
+	}
+	return bump(a, (size_t)1 << k);
+}
+
+/*
+ * Releases a block, with the arena's mutex held
+ *
+ * @param a The arena
+ * @param block The block, or NULL
+ * @param size The size the block was allocated with
+ */
+static void freeBlock(Arena a, void *block, size_t size){
+	if(block == NULL){
+		return;
+	}
+	if(size > ARENA_LARGE_BLOCK){
+		large_t *l = (large_t *)block - 1;
+		if(l->prev != NULL){
+			l->prev->next = l->next;
+		}
+		else{
+			a->large = l->next;
+		}
+		if(l->next != NULL){
+			l->next->prev = l->prev;
+		}
+		a->footprint -= l->size;
+		free(l);
+		return;
+	}
+
+	unsigned k = sizeClass(size);
+	free_t *f = (free_t *)block;
+	f->next = a->free[k];
+	a->free[k] = f;
+}
+
+/*
+ * Copies a string into the arena, with the arena's mutex held
+ *
+ * @param a The arena
+ * @param str The string
+ * @return The copy
+ */
+static char *copyString(Arena a, const char *str){
+	size_t len = strlen(str) + 1;
+	char *copy = (char *)bump(a, (len + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1));
+	memcpy(copy, str, len);
+	return copy;
+}
+
+void* arena_alloc( Arena a, size_t size ){
+	pthread_mutex_lock(&a->lock);
+	void *block = allocBlock(a, size);
+	pthread_mutex_unlock(&a->lock);
+	return block;
+}
+
+void arena_free( Arena a, void* block, size_t size ){
+	pthread_mutex_lock(&a->lock);
+	freeBlock(a, block, size);
+	pthread_mutex_unlock(&a->lock);
+}
+
+char* arena_strdup( Arena a, const char* str ){
+	assert(str != NULL);
+	pthread_mutex_lock(&a->lock);
+	char *copy = copyString(a, str);
+	pthread_mutex_unlock(&a->lock);
+	return copy;
+}
+
+char* arena_intern( Arena a, const char* str ){
+	assert(str != NULL);
+	pthread_mutex_lock(&a->lock);
+	if((a->intern_size + 1) * 2 > a->intern_capacity){ //Keep the set at most half full
+		size_t capacity = a->intern_capacity == 0 ? INTERN_CAPACITY : a->intern_capacity * 2;
+		intern_t *slots = (intern_t *)allocBlock(a, capacity * sizeof(intern_t));
+		memset(slots, 0, capacity * sizeof(intern_t));
+		for(size_t i = 0; i < a->intern_capacity; i++){
+			if(a->interned[i].str != NULL){
+				size_t j = a->interned[i].hash & (capacity - 1);
+				while(slots[j].str != NULL){
+					j = (j + 1) & (capacity - 1);
+				}
+				slots[j] = a->interned[i];
+			}
+		}
+		freeBlock(a, a->interned, a->intern_capacity * sizeof(intern_t));
+		a->interned = slots;
+		a->intern_capacity = capacity;
+	}
+
+	size_t hash = hashString(str);
+	size_t mask = a->intern_capacity - 1;
+	size_t i = hash & mask;
+	while(a->interned[i].str != NULL){
+		if(a->interned[i].hash == hash && strcmp(a->interned[i].str, str) == 0){
+			pthread_mutex_unlock(&a->lock);
+			return a->interned[i].str;
+		}
+		i = (i + 1) & mask;
+	}
+	a->interned[i].hash = hash;
+	a->interned[i].str = copyString(a, str);
+	a->intern_size++;
+	char *copy = a->interned[i].str;
+	pthread_mutex_unlock(&a->lock);
+	return copy;
+}
+
+size_t arena_footprint( const Arena a ){
+	pthread_mutex_lock(&a->lock);
+	size_t footprint = a->footprint;
+	pthread_mutex_unlock(&a->lock);
+	return footprint;
+}
+
+size_t arena_interned( const Arena a, size_t* count ){
+	pthread_mutex_lock(&a->lock);
+	size_t bytes = 0;
+	for(size_t i = 0; i < a->intern_capacity; i++){
+		if(a->interned[i].str != NULL){ //Padded exactly as copyString pads
+			bytes += (strlen(a->interned[i].str) + ARENA_ALIGN) & ~(size_t)(ARENA_ALIGN - 1);
+		}
+	}
+	*count = a->intern_size;
+	pthread_mutex_unlock(&a->lock);
+	return bytes;
+}
+
+size_t arena_idle( const Arena a ){
+	pthread_mutex_lock(&a->lock);
+	size_t bytes = 0;
+	for(unsigned k = 0; k < NUM_CLASSES; k++){
+		for(free_t *f = a->free[k]; f != NULL; f = f->next){
+			bytes += (size_t)1 << k;
+		}
+	}
+	pthread_mutex_unlock(&a->lock);
+	return bytes;
+}
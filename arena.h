@@ -0,0 +1,140 @@
+/// @file arena.h
+/// @brief A region allocator that owns every record in the network.
+///
+/// People, their handles, their interned names and their friend storage
+/// are all carved out of large chunks owned by an Arena, so clearing the
+/// network releases a handful of chunks instead of walking every user.
+///
+/// General Notes on arena Operation
+///
+/// - arena_alloc() rounds requests up to a power of two size class.  Blocks
+///   handed back with arena_free() are kept on a per-class free list and
+///   reused by later allocations of the same class, which suits friend
+///   lists that grow and shrink by doubling.
+///
+/// - Blocks larger than ARENA_LARGE_BLOCK bytes get a dedicated allocation
+///   so a huge friend list can be returned to the system as soon as it
+///   is freed.
+///
+/// - arena_strdup() and arena_intern() copy strings into the arena.  These
+///   copies are never freed individually.  Interned strings are shared
+///   between callers and must not be modified.
+///
+/// - Every function may be called from several threads at once, except
+///   that arena_reset() and arena_destroy() must not race with any other
+///   use of the arena.
+///
+/// - Wherever a function has a precondition, and the client violates the
+///   condition, and the code detects the violation, then the function will
+///   assert failure and abort.
+///
+/// @author Bennett Moore bwm7637@rit.edu
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>     // size_t
+
+/// Size of the first chunk; later chunks double up to ARENA_MAX_CHUNK
+#define ARENA_MIN_CHUNK (64 * 1024)
+#define ARENA_MAX_CHUNK (16 * 1024 * 1024)
+
+/// Blocks above this size are allocated on their own
+#define ARENA_LARGE_BLOCK (256 * 1024)
+
+/// Every block is aligned to, and at least, this many bytes
+#define ARENA_ALIGN 16
+
+/// The Arena data type is a pointer to an opaque structure.
+typedef struct Arena_t * Arena;
+
+/// Create a new, empty arena.
+///
+/// @exception Assert fails if it cannot allocate space
+/// @return A newly created arena
+///
+Arena arena_create( void );
+
+/// Release all memory owned by the arena, including the arena itself.
+///
+/// @param a The arena to destroy
+/// @pre a is a valid instance of arena.
+/// @post a is not a valid instance of arena.
+///
+void arena_destroy( Arena a );
+
+/// Release every block, string and interned name at once.  The cost is
+/// proportional to the number of chunks, not the number of allocations.
+///
+/// @param a The arena to reset
+/// @pre a is a valid instance of arena.
+/// @post every pointer previously returned by a is invalid.
+///
+void arena_reset( Arena a );
+
+/// Allocate a block of uninitialized memory.
+///
+/// @param a The arena
+/// @param size The number of bytes needed
+/// @exception Assert fails if it cannot allocate space
+/// @pre a is a valid instance of arena, and size is not 0.
+/// @return A block of at least size bytes, aligned to ARENA_ALIGN
+///
+void* arena_alloc( Arena a, size_t size );
+
+/// Return a block to the arena for reuse.
+///
+/// @param a The arena
+/// @param block The block, or NULL to do nothing
+/// @param size The size that was passed to arena_alloc() for block
+/// @pre block was returned by arena_alloc(a, size) and not yet freed.
+///
+void arena_free( Arena a, void* block, size_t size );
+
+/// Copy a string into the arena.
+///
+/// @param a The arena
+/// @param str The string to copy
+/// @exception Assert fails if it cannot allocate space
+/// @pre a is a valid instance of arena, and str is not NULL.
+/// @return A copy of str that lives until the arena is reset
+///
+char* arena_strdup( Arena a, const char* str );
+
+/// Get the arena's shared copy of a string, copying it in on first use.
+///
+/// @param a The arena
+/// @param str The string to intern
+/// @exception Assert fails if it cannot allocate space
+/// @pre a is a valid instance of arena, and str is not NULL.
+/// @return The same pointer for every call with an equal string until
+///         the arena is reset
+///
+char* arena_intern( Arena a, const char* str );
+
+/// Get the number of bytes the arena has obtained from the system.
+///
+/// @param a The arena
+/// @pre a is a valid instance of arena.
+/// @return The bytes held in chunks and large blocks
+///
+size_t arena_footprint( const Arena a );
+
+/// Get the space taken by interned strings.
+///
+/// @param a The arena
+/// @param count Receives the number of distinct interned strings
+/// @pre a is a valid instance of arena.
+/// @return The bytes holding interned strings, padding included
+///
+size_t arena_interned( const Arena a, size_t* count );
+
+/// Get the space held in released blocks waiting to be reused.
+///
+/// @param a The arena
+/// @pre a is a valid instance of arena.
+/// @return The bytes on the free lists
+///
+size_t arena_idle( const Arena a );
+
+#endif // ARENA_H
@@ -0,0 +1,171 @@
+/*
+ * file: batch.c
+ *
+ * Batch command input. Files are mapped copy-on-write so tokens can be
+ * terminated in place; streams are read in large blocks, and a block only
+ * grows when a single line does not fit in it.
+ *
+ * @author Bennett Moore bwm7637@rit.edu
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "batch.h"
+
+/*
+ * Tokenizes and runs one line
+ *
+ * @param line The line, NUL terminated
+ * @param data Token storage of max entries
+ * @param max The number of entries in data
+ * @param run The command callback
+ * @return Whether the batch should continue
+ */
+static bool runLine(char *line, char **data, size_t max, bool (*run)(char **data)){
+	if(batch_tokenize(line, data, max) == 0){ //Blank line
+		return true;
+	}
+	return run(data);
+}
+
+/*
+ * Runs every complete line in a buffer
+ *
+ * @param buf The buffer
+ * @param len The number of bytes in buf
+ * @param data Token storage of max entries
+ * @param max The number of entries in data
+ * @param run The command callback
+ * @param active Set to false if a command stopped the batch
+ * @return The number of bytes consumed, up to the end of the last full line
+ */
+static size_t runLines(char *buf, size_t len, char **data, size_t max,
+		bool (*run)(char **data), bool *active){
+	size_t start = 0;
+	char *nl;
+	while(*active && (nl = memchr(buf + start, '\n', len - start)) != NULL){
+		*nl = '\0';
+		*active = runLine(buf + start, data, max, run);
+		start = (size_t)(nl - buf) + 1;
+	}
+	return start;
+}
+
+size_t batch_tokenize( char* line, char** data, size_t max ){
+	size_t n = 0;
+	char *c = line;
+	while(n < max){
+		while(*c == ' '){
+			c++;
+		}
+		if(*c == '\0' || *c == '\n' || (*c == '\r' && (c[1] == '\n' || c[1] == '\0'))){
+			break;
+		}
+		data[n++] = c;
+		while(*c != ' ' && *c != '\0' && *c != '\n' && *c != '\r'){
+			c++;
+		}
+		if(*c == '\0'){
+			break;
+		}
+		bool end = *c != ' ';
+		*c++ = '\0';
+		if(end){
+			break;
+		}
+	}
+	for(size_t i = n; i < max; i++){
+		data[i] = NULL;
+	}
+	return n;
+}
+
+bool batch_run_file( const char* path, size_t max, bool (*run)(char** data) ){
+	int fd = open(path, O_RDONLY);
+	if(fd < 0){
+		return false;
+	}
+	struct stat st;
+	if(fstat(fd, &st) != 0){
+		close(fd);
+		return false;
+	}
+	if(st.st_size == 0){
+		close(fd);
+		return true;
+	}
+
+	//Private mapping: writing the NUL terminators never reaches the file
+	size_t len = (size_t)st.st_size;
+	char *buf = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(buf == MAP_FAILED){
+		return false;
+	}
+	posix_madvise(buf, len, POSIX_MADV_SEQUENTIAL);
+
+	char **data = (char **)calloc(max, sizeof(char *));
+	assert(data != NULL);
+	bool active = true;
+	size_t done = runLines(buf, len, data, max, run, &active);
+	if(active && done < len){ //Last line has no newline, and may end the mapping
+		char *last = strndup(buf + done, len - done);
+		assert(last != NULL);
+		runLine(last, data, max, run);
+		free(last);
+	}
+
+	free(data);
+	munmap(buf, len);
+	return true;
+}
+
+bool batch_run_stream( FILE* in, size_t max, bool (*run)(char** data) ){
+	size_t capacity = BATCH_CHUNK;
+	size_t len = 0;
+	char *buf = (char *)malloc(capacity + 1);
+	char **data = (char **)calloc(max, sizeof(char *));
+	assert(buf != NULL && data != NULL);
+	bool active = true;
+	int fd = fileno(in);
+	ssize_t got = 0;
+
+	while(active){
+		if(len == capacity){ //One line fills the whole buffer
+			capacity *= 2;
+			buf = (char *)realloc(buf, capacity + 1);
+			assert(buf != NULL);
+		}
+		got = read(fd, buf + len, capacity - len);
+		if(got <= 0){
+			break;
+		}
+		len += (size_t)got;
+
+		size_t done = runLines(buf, len, data, max, run, &active);
+		memmove(buf, buf + done, len - done);
+		len -= done;
+	}
+
+	if(active && len > 0){ //Last line has no newline
+		buf[len] = '\0';
+		runLine(buf, data, max, run);
+	}
+	bool ok = got >= 0;
+	free(data);
+	free(buf);
+	return ok;
+}
+
+void batch_buffer_output( void ){
+	setvbuf(stdout, NULL, _IOFBF, BATCH_OUTPUT_BUFFER);
+	setvbuf(stderr, NULL, _IOFBF, BATCH_OUTPUT_BUFFER);
+}
@@ -0,0 +1,62 @@
+/// @file batch.h
+/// @brief Non-interactive command input for replaying large command files.
+///
+/// Commands are split into tokens in place: each token points straight
+/// into the input buffer, and the separators after it are overwritten with
+/// NUL bytes. Files are memory-mapped privately so this never touches the
+/// file on disk; streams are read in BATCH_CHUNK sized blocks. Lines of any
+/// length are supported.
+///
+/// @author Bennett Moore bwm7637@rit.edu
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdbool.h>    // bool
+#include <stddef.h>     // size_t
+#include <stdio.h>      // FILE
+
+/// Number of bytes read from a stream at a time
+#define BATCH_CHUNK (1024 * 1024)
+
+/// Size of the stdout and stderr buffers used in batch mode
+#define BATCH_OUTPUT_BUFFER (1024 * 1024)
+
+/// Split a line into space separated tokens, in place.
+///
+/// @param line The line to split; a trailing newline is dropped
+/// @param data Receives the tokens
+/// @param max The number of entries in data
+/// @post every entry of data past the last token is NULL.
+/// @return The number of tokens stored in data
+///
+size_t batch_tokenize( char* line, char** data, size_t max );
+
+/// Run every command in a file.
+///
+/// @param path The file to read
+/// @param max The number of tokens passed to run for each command
+/// @param run Called with the tokens of each non-empty line; returning
+///        false stops the batch
+/// @return Whether the file could be read
+///
+bool batch_run_file( const char* path, size_t max, bool (*run)(char** data) );
+
+/// Run every command read from a stream until end of file.
+///
+/// @param in The stream to read
+/// @param max The number of tokens passed to run for each command
+/// @param run Called with the tokens of each non-empty line; returning
+///        false stops the batch
+/// @exception Assert fails if it cannot allocate space
+/// @return Whether the stream was read without error
+///
+bool batch_run_stream( FILE* in, size_t max, bool (*run)(char** data) );
+
+/// Switch stdout and stderr to large, fully buffered writes.
+///
+/// @pre Nothing has been written to either stream yet.
+///
+void batch_buffer_output( void );
+
+#endif // BATCH_H
@@ -0,0 +1,535 @@
+/*
+ * file: bench.c
+ *
+ * Benchmark driver. Generates a synthetic social network workload, runs it
+ * in-process and times every operation, then prints one JSON object per
+ * phase and operation type, followed by a summary object.
+ *
+ * Operations either call the engine's functions directly (the default) or
+ * go through the command parser as typed commands (-c). With -w the
+ * workload is written out as a command file instead, so the amici binary
+ * itself can be timed with amici -b.
+ *
+ * Build alongside every module except amici.c, which is compiled in:
+ *     gcc -std=c11 -O2 -pthread -o bench bench.c arena.c batch.c components.c csr.c
+ *         friends.c import.c influence.c intersect.c jobs.c journal.c locks.c
+ *         names.c profile.c ranks.c search.c server.c snapshot.c social.c
+ *         table.c tiers.c triangles.c -lm
+ *
+ * @author Bennett Moore bwm7637@rit.edu
+ */
+
+#define main amiciMain //The benchmark supplies its own main
+#include "amici.c"
+#undef main
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#define NUM_OPS 6
+#define NAME_POOL_FIRST 1000	// Distinct first names
+#define NAME_POOL_LAST 5000	// Distinct last names
+#define LINE_SIZE 96
+
+typedef enum op_e{
+	OP_ADD,
+	OP_FRIEND,
+	OP_UNFRIEND,
+	OP_PRINT,
+	OP_SIZE,
+	OP_STATS
+} op_kind_t;
+
+static const char *op_names[NUM_OPS] = {"add", "friend", "unfriend", "print", "size", "stats"};
+
+typedef struct op_s{
+	op_kind_t kind;
+	uint32_t a;			// User, or new user's id for add
+	uint32_t b;			// Second user of friend and unfriend
+} op_t;
+
+typedef struct workload_s{
+	op_t *ops;
+	size_t count;
+	size_t capacity;
+	size_t setup;			// Number of leading ops that build the network
+	uint32_t users;			// Users after every op has run
+} workload_t;
+
+typedef struct timings_s{
+	uint64_t *ns;			// Latency of each op, in nanoseconds
+	size_t count;
+	size_t capacity;
+	uint64_t total;			// Sum of ns
+} timings_t;
+
+/*
+ * Gets the next number from a xorshift64* generator
+ *
+ * @param state The generator state, never 0
+ * @return A pseudo-random 64-bit number
+ */
+static uint64_t nextRandom(uint64_t *state){
+	*state ^= *state >> 12;
+	*state ^= *state << 25;
+	*state ^= *state >> 27;
+	return *state * 0x2545f4914f6cdd1dULL;
+}
+
+/*
+ * Draws a number uniformly from [0, 1)
+ *
+ * @param state The generator state
+ * @return The number
+ */
+static double uniform(uint64_t *state){
+	return (double)(nextRandom(state) >> 11) / 9007199254740992.0;
+}
+
+/*
+ * Draws a rank from a bounded power law, so low ranks are drawn far more
+ * often than high ones; with alpha 1 this approximates Zipf's law
+ *
+ * @param state The generator state
+ * @param n The number of ranks
+ * @param alpha The exponent, 0 for a uniform draw
+ * @return A rank below n
+ */
+static uint32_t powerLaw(uint64_t *state, uint32_t n, double alpha){
+	double u = uniform(state);
+	double x;
+	if(fabs(alpha - 1.0) < 1e-9){
+		x = pow((double)n + 1.0, u);
+	}
+	else{
+		double e = 1.0 - alpha;
+		x = pow(1.0 + u * (pow((double)n + 1.0, e) - 1.0), 1.0 / e);
+	}
+	uint32_t r = (uint32_t)x - 1;
+	return r < n ? r : n - 1;
+}
+
+/*
+ * Appends an op to a workload
+ *
+ * @param w The workload
+ * @param kind The kind of op
+ * @param a The first user
+ * @param b The second user
+ */
+static void pushOp(workload_t *w, op_kind_t kind, uint32_t a, uint32_t b){
+	if(w->count == w->capacity){
+		w->capacity = w->capacity == 0 ? 1024 : w->capacity * 2;
+		w->ops = (op_t *)realloc(w->ops, w->capacity * sizeof(op_t));
+		assert(w->ops != NULL);
+	}
+	w->ops[w->count].kind = kind;
+	w->ops[w->count].a = a;
+	w->ops[w->count].b = b;
+	w->count++;
+}
+
+/*
+ * Generates a workload: users and power-law friendships to start from,
+ * then a mix of operations on users drawn from the same power law
+ *
+ * @param w Receives the workload
+ * @param users The number of users to start with
+ * @param degree The average number of friends to start with
+ * @param ops The number of mixed operations
+ * @param mix The relative weight of each kind of op
+ * @param alpha The power law exponent
+ * @param seed The random seed
+ */
+static void generate(workload_t *w, uint32_t users, double degree, size_t ops,
+		const unsigned *mix, double alpha, uint64_t seed){
+	uint64_t state = seed == 0 ? 0x9e3779b97f4a7c15ULL : seed;
+	uint32_t *made = NULL;		// Friendships made, two ids each
+	size_t made_count = 0;
+	size_t made_capacity = 0;
+	memset(w, 0, sizeof(workload_t));
+
+	for(uint32_t i = 0; i < users; i++){
+		pushOp(w, OP_ADD, i, 0);
+	}
+	size_t edges = users < 2 ? 0 : (size_t)(users * degree / 2);
+	size_t total = edges + ops;
+	for(size_t i = 0; i < total; i++){
+		op_kind_t kind = OP_FRIEND;
+		if(i >= edges){ //Mixed phase
+			unsigned sum = 0;
+			for(int k = 0; k < NUM_OPS; k++){
+				sum += mix[k];
+			}
+			unsigned pick = (unsigned)(nextRandom(&state) % sum);
+			for(kind = OP_ADD; pick >= mix[kind]; kind++){
+				pick -= mix[kind];
+			}
+		}
+		if(users < 2 && (kind == OP_FRIEND || kind == OP_UNFRIEND)){
+			kind = OP_ADD;
+		}
+		if(kind == OP_UNFRIEND && made_count == 0){
+			kind = OP_FRIEND;
+		}
+
+		uint32_t a = 0;
+		uint32_t b = 0;
+		switch(kind){
+			case OP_ADD:
+				a = users++;
+				break;
+			case OP_FRIEND:
+				a = powerLaw(&state, users, alpha);
+				do{
+					b = powerLaw(&state, users, alpha);
+				} while(b == a);
+				if(made_count == made_capacity){
+					made_capacity = made_capacity == 0 ? 1024 : made_capacity * 2;
+					made = (uint32_t *)realloc(made, made_capacity * 2 * sizeof(uint32_t));
+					assert(made != NULL);
+				}
+				made[2 * made_count] = a;
+				made[2 * made_count + 1] = b;
+				made_count++;
+				break;
+			case OP_UNFRIEND:{ //Undo a random earlier friendship
+				size_t k = (size_t)(nextRandom(&state) % made_count);
+				a = made[2 * k];
+				b = made[2 * k + 1];
+				made[2 * k] = made[2 * (made_count - 1)];
+				made[2 * k + 1] = made[2 * (made_count - 1) + 1];
+				made_count--;
+				break;
+			}
+			case OP_PRINT:
+			case OP_SIZE:
+				a = powerLaw(&state, users, alpha);
+				break;
+			case OP_STATS:
+				break;
+		}
+		pushOp(w, kind, a, b);
+		if(i + 1 == edges){
+			w->setup = w->count;
+		}
+	}
+	if(edges == 0){
+		w->setup = users;
+	}
+	w->users = users;
+	free(made);
+}
+
+/*
+ * Writes a user's name and handle; names repeat, handles do not
+ *
+ * @param id The user
+ * @param first Receives the first name
+ * @param last Receives the last name
+ * @param handle Receives the handle
+ */
+static void nameOf(uint32_t id, char *first, char *last, char *handle){
+	uint64_t state = ((uint64_t)id + 1) * 0x9e3779b97f4a7c15ULL;
+	sprintf(first, "First%u", powerLaw(&state, NAME_POOL_FIRST, 1.0));
+	sprintf(last, "Last%u", powerLaw(&state, NAME_POOL_LAST, 1.0));
+	sprintf(handle, "u%u", id);
+}
+
+/*
+ * Writes an op as a command line
+ *
+ * @param op The op
+ * @param line Receives the command, LINE_SIZE bytes at most
+ */
+static void formatOp(const op_t *op, char *line){
+	char first[24], last[24], handle[16];
+	switch(op->kind){
+		case OP_ADD:
+			nameOf(op->a, first, last, handle);
+			sprintf(line, "add %s %s %s", first, last, handle);
+			break;
+		case OP_FRIEND:
+		case OP_UNFRIEND:
+			sprintf(line, "%s u%u u%u", op_names[op->kind], op->a, op->b);
+			break;
+		case OP_PRINT:
+		case OP_SIZE:
+			sprintf(line, "%s u%u", op_names[op->kind], op->a);
+			break;
+		case OP_STATS:
+			strcpy(line, "stats");
+			break;
+	}
+}
+
+/*
+ * Runs one op through the engine's functions
+ *
+ * @param op The op
+ * @param h1 The first user's handle
+ * @param h2 The second user's handle
+ * @param first The new user's first name, for add
+ * @param last The new user's last name, for add
+ */
+static void runEngine(const op_t *op, char *h1, char *h2, const char *first, const char *last){
+	switch(op->kind){
+		case OP_ADD:
+			createUser(first, last, h1);
+			break;
+		case OP_FRIEND:
+			friend(ht_find(t, h1), ht_find(t, h2), true);
+			break;
+		case OP_UNFRIEND:
+			friend(ht_find(t, h1), ht_find(t, h2), false);
+			break;
+		case OP_PRINT:
+			printInfo(ht_find(t, h1), NULL, 0, SIZE_MAX, false);
+			break;
+		case OP_SIZE:{
+			volatile size_t count = ht_find(t, h1)->friend_count;
+			(void)count;
+			break;
+		}
+		case OP_STATS:
+			printStats();
+			break;
+	}
+}
+
+/*
+ * Records one latency
+ *
+ * @param tm The timings of one kind of op
+ * @param ns The latency in nanoseconds
+ */
+static void record(timings_t *tm, uint64_t ns){
+	if(tm->count == tm->capacity){
+		tm->capacity = tm->capacity == 0 ? 1024 : tm->capacity * 2;
+		tm->ns = (uint64_t *)realloc(tm->ns, tm->capacity * sizeof(uint64_t));
+		assert(tm->ns != NULL);
+	}
+	tm->ns[tm->count++] = ns;
+	tm->total += ns;
+}
+
+/*
+ * Compares latencies for qsort
+ *
+ * @param x The first latency
+ * @param y The second latency
+ * @return Negative, zero or positive as x is below, equal to or above y
+ */
+static int compareNs(const void *x, const void *y){
+	uint64_t a = *(const uint64_t *)x;
+	uint64_t b = *(const uint64_t *)y;
+	return (a > b) - (a < b);
+}
+
+/*
+ * Prints one JSON line per kind of op that ran in a phase
+ *
+ * @param out The report stream
+ * @param mode "engine" or "commands"
+ * @param phase "setup" or "mixed"
+ * @param tm The timings of each kind of op
+ */
+static void report(FILE *out, const char *mode, const char *phase, timings_t *tm){
+	for(int k = 0; k < NUM_OPS; k++){
+		if(tm[k].count == 0){
+			continue;
+		}
+		qsort(tm[k].ns, tm[k].count, sizeof(uint64_t), compareNs);
+		size_t n = tm[k].count;
+		double seconds = (double)tm[k].total / 1e9;
+		fprintf(out, "{\"mode\":\"%s\",\"phase\":\"%s\",\"op\":\"%s\",\"count\":%zu,\"seconds\":%.6f,"
+			"\"ops_per_sec\":%.1f,\"p50_ns\":%llu,\"p99_ns\":%llu,\"p999_ns\":%llu,\"max_ns\":%llu}\n",
+			mode, phase, op_names[k], n, seconds, seconds > 0 ? (double)n / seconds : 0.0,
+			(unsigned long long)tm[k].ns[n / 2], (unsigned long long)tm[k].ns[n * 99 / 100],
+			(unsigned long long)tm[k].ns[n * 999 / 1000], (unsigned long long)tm[k].ns[n - 1]);
+		free(tm[k].ns);
+		memset(&tm[k], 0, sizeof(timings_t));
+	}
+}
+
+/*
+ * Reads a comma separated list of op weights
+ *
+ * @param text The list, in add,friend,unfriend,print,size,stats order
+ * @param mix Receives the weights
+ * @return Whether the list is valid
+ */
+static bool parseMix(const char *text, unsigned *mix){
+	unsigned sum = 0;
+	for(int k = 0; k < NUM_OPS; k++){
+		char *end;
+		unsigned long w = strtoul(text, &end, 10);
+		if(end == text || (k + 1 < NUM_OPS ? *end != ',' : *end != '\0')){
+			return false;
+		}
+		mix[k] = (unsigned)w;
+		sum += mix[k];
+		text = end + 1;
+	}
+	return sum > 0;
+}
+
+/*
+ * The benchmark's main method
+ *
+ * @param argc The number of command line arguments
+ * @param argv The command line arguments
+ * @return Whether the benchmark ran successfully or not
+ */
+int main(int argc, char **argv){
+	uint32_t start_users = 100000;
+	double degree = 10.0;
+	size_t ops = 1000000;
+	unsigned mix[NUM_OPS] = {2, 45, 10, 25, 17, 1};
+	double alpha = 1.0;
+	uint64_t seed = 1;
+	bool commands = false;
+	const char *workload_path = NULL;
+	int opt;
+
+	while((opt = getopt(argc, argv, "u:d:n:m:a:s:p:cw:")) != -1){ //Read options
+		switch(opt){
+			case 'u':
+				start_users = (uint32_t)strtoul(optarg, NULL, 10);
+				break;
+			case 'd':
+				degree = strtod(optarg, NULL);
+				break;
+			case 'n':
+				ops = strtoul(optarg, NULL, 10);
+				break;
+			case 'm':
+				if(!parseMix(optarg, mix)){
+					threads = 0;
+				}
+				break;
+			case 'a':
+				alpha = strtod(optarg, NULL);
+				break;
+			case 's':
+				seed = strtoull(optarg, NULL, 10);
+				break;
+			case 'p':
+				threads = (unsigned)strtoul(optarg, NULL, 10);
+				break;
+			case 'c':
+				commands = true;
+				break;
+			case 'w':
+				workload_path = optarg;
+				break;
+			default:
+				threads = 0;
+				break;
+		}
+	}
+	if(threads == 0 || optind < argc || degree < 0 || alpha < 0){
+		fprintf(stderr, "usage: bench [-u users] [-d degree] [-n ops] [-m add,friend,unfriend,print,size,stats]"
+			" [-a alpha] [-s seed] [-p threads] [-c] [-w command-file]\n");
+		return EXIT_FAILURE;
+	}
+
+	workload_t w;
+	generate(&w, start_users, degree, ops, mix, alpha, seed);
+	char line[LINE_SIZE];
+
+	if(workload_path != NULL){ //Write the commands instead of running them
+		FILE *f = fopen(workload_path, "w");
+		if(f == NULL){
+			fprintf(stderr, "error: could not write '%s'\n", workload_path);
+			free(w.ops);
+			return EXIT_FAILURE;
+		}
+		for(size_t i = 0; i < w.count; i++){
+			formatOp(&w.ops[i], line);
+			fprintf(f, "%s\n", line);
+		}
+		fprintf(f, "stats\n");
+		bool ok = fclose(f) == 0;
+		free(w.ops);
+		return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	//Keep the report; silence what the operations print
+	FILE *out = fdopen(dup(STDOUT_FILENO), "w");
+	assert(out != NULL);
+	if(freopen("/dev/null", "w", stdout) == NULL || freopen("/dev/null", "w", stderr) == NULL){
+		fprintf(out, "{\"error\":\"could not open /dev/null\"}\n");
+		return EXIT_FAILURE;
+	}
+
+	arena = arena_create();
+	t = ht_create(tablePrint, NULL);
+	components = components_create();
+	locks = locks_create();
+	names = names_create();
+	ranks = ranks_create();
+	triangles = triangles_create();
+	influence = influence_create();
+	profile = profile_create(commandCount());
+	is_active = true;
+
+	const char *mode = commands ? "commands" : "engine";
+	timings_t tm[NUM_OPS];
+	memset(tm, 0, sizeof(tm));
+	char *data[MAX_COMMANDS];
+	char first[24], last[24], h1[16], h2[16];
+	struct timespec begin, end;
+	for(size_t i = 0; i < w.count; i++){
+		if(i == w.setup){
+			report(out, mode, "setup", tm);
+		}
+		const op_t *op = &w.ops[i];
+		if(commands){
+			formatOp(op, line);
+			clock_gettime(CLOCK_MONOTONIC, &begin);
+			batch_tokenize(line, data, MAX_COMMANDS);
+			runCommand(data);
+			clock_gettime(CLOCK_MONOTONIC, &end);
+		}
+		else{
+			if(op->kind == OP_ADD){
+				nameOf(op->a, first, last, h1);
+			}
+			else{
+				sprintf(h1, "u%u", op->a);
+				sprintf(h2, "u%u", op->b);
+			}
+			clock_gettime(CLOCK_MONOTONIC, &begin);
+			runEngine(op, h1, h2, first, last);
+			clock_gettime(CLOCK_MONOTONIC, &end);
+		}
+		record(&tm[op->kind], (uint64_t)(end.tv_sec - begin.tv_sec) * 1000000000ULL
+			+ (uint64_t)end.tv_nsec - (uint64_t)begin.tv_nsec);
+	}
+	report(out, mode, w.setup == w.count ? "setup" : "mixed", tm);
+
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	fprintf(out, "{\"mode\":\"%s\",\"summary\":true,\"users\":%d,\"friendships\":%d,\"ops\":%zu,"
+		"\"seed\":%llu,\"alpha\":%.3f,\"arena_bytes\":%zu,\"peak_rss_kb\":%ld}\n",
+		mode, people, friendships, w.count, (unsigned long long)seed, alpha,
+		arena_footprint(arena), usage.ru_maxrss);
+	fclose(out);
+
+	thaw();
+	ht_destroy(t);
+	components_destroy(components);
+	locks_destroy(locks);
+	names_destroy(names);
+	ranks_destroy(ranks);
+	triangles_destroy(triangles);
+	influence_destroy(influence);
+	profile_destroy(profile);
+	arena_destroy(arena);
+	free(w.ops);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,397 @@
+/*
+ * file: components.c
+ *
+ * Union-find with lazy splitting. Every piece a component can break into
+ * after losing friendships contains one of the lost friendships' ends, so
+ * searching from those ends relabels the whole component and nothing else.
+ *
+ * Union-find runs over nodes rather than user ids, so when a removed user's
+ * id is handed to another user only the two maps between ids and nodes
+ * change. A removed user's node may still sit on other users' paths to
+ * their root, so it is only reused once the next pass has relabeled its
+ * component.
+ *
+ * @author Bennett Moore bwm7637@rit.edu
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "components.h"
+
+#define NO_USER UINT32_MAX		// Owner of a removed user's node
+
+typedef struct job_s{
+	Components c;
+	person_t **users;
+	uint32_t *ends;			// Ends of lost friendships in one component
+	size_t length;			// Number of ends
+	uint32_t old_size;		// Size of the component before relabeling
+	uint32_t *pieces;		// Sizes of the pieces found
+	size_t piece_count;		// Number of pieces found
+} job_t;
+
+struct Components_t{
+	uint32_t *parent;		// Union-find parent by node, a root is its own parent
+	uint32_t *size;			// Size of the component, valid at roots
+	uint32_t *stamp;		// Relabel pass that last reached each node
+	uint32_t *owner;		// User id at each node, NO_USER once removed
+	uint32_t *node;			// Node of each user id
+	uint32_t *spare;		// Nodes ready for new users
+	uint32_t *retired;		// Nodes of removed users, spare after the next pass
+	uint32_t *histogram;		// Number of components of each size
+	size_t users;			// Number of users
+	size_t nodes;			// Number of nodes ever handed out
+	size_t spare_count;
+	size_t retired_count;
+	size_t capacity;		// Room for this many nodes
+	size_t count;			// Number of components
+	size_t largest;			// Size of the largest component
+	uint32_t pass;			// Number of relabel passes so far
+	uint32_t *ends;			// Nodes at the ends of friendships removed since the last pass
+	size_t ends_length;
+	size_t ends_capacity;
+};
+
+/*
+ * Finds the root of a node's component, halving the path on the way
+ *
+ * @param c The components
+ * @param x The node
+ * @return The root of x's component
+ */
+static uint32_t find(Components c, uint32_t x){
+	while(c->parent[x] != x){
+		c->parent[x] = c->parent[c->parent[x]];
+		x = c->parent[x];
+	}
+	return x;
+}
+
+/*
+ * Moves one component between histogram buckets
+ *
+ * @param c The components
+ * @param from The size the component had, or 0 if it is new
+ * @param to The size the component has, or 0 if it is gone
+ */
+static void resize(Components c, size_t from, size_t to){
+	if(from != 0){
+		c->histogram[from]--;
+	}
+	if(to != 0){
+		c->histogram[to]++;
+		if(to > c->largest){
+			c->largest = to;
+		}
+	}
+	while(c->largest > 0 && c->histogram[c->largest] == 0){
+		c->largest--;
+	}
+}
+
+/*
+ * Compares (root, end) keys for qsort
+ *
+ * @param x The first key
+ * @param y The second key
+ * @return Negative, zero or positive as x is below, equal to or above y
+ */
+static int compareKeys(const void *x, const void *y){
+	uint64_t a = *(const uint64_t *)x;
+	uint64_t b = *(const uint64_t *)y;
+	return (a > b) - (a < b);
+}
+
+/*
+ * Relabels one component by searching from the ends of its lost friendships
+ *
+ * @param arg The job describing the component
+ * @return NULL
+ */
+static void *relabel(void *arg){
+	job_t *job = (job_t *)arg;
+	Components c = job->c;
+	uint32_t *queue = (uint32_t *)malloc((job->old_size + 1) * sizeof(uint32_t));
+	job->pieces = (uint32_t *)malloc((job->length + 1) * sizeof(uint32_t));
+	assert(queue != NULL && job->pieces != NULL);
+	job->piece_count = 0;
+
+	for(size_t i = 0; i < job->length; i++){
+		uint32_t root = job->ends[i];
+		if(c->owner[root] == NO_USER || c->stamp[root] == c->pass){ //Removed, or already in an earlier piece
+			continue;
+		}
+
+		//Components are disjoint, so jobs never touch the same users
+		size_t head = 0;
+		size_t tail = 0;
+		c->stamp[root] = c->pass;
+		queue[tail++] = root;
+		while(head < tail){
+			person_t *p = job->users[c->owner[queue[head++]]];
+			for(size_t j = 0; j < p->friend_count; j++){
+				uint32_t v = c->node[p->friends[j]];
+				if(c->stamp[v] != c->pass){
+					c->stamp[v] = c->pass;
+					queue[tail++] = v;
+				}
+			}
+		}
+		for(size_t j = 0; j < tail; j++){
+			c->parent[queue[j]] = root;
+		}
+		c->size[root] = (uint32_t)tail;
+		job->pieces[job->piece_count++] = (uint32_t)tail;
+	}
+	free(queue);
+	return NULL;
+}
+
+typedef struct pool_s{
+	job_t *jobs;
+	size_t count;			// Number of jobs
+	size_t next;			// Next job to claim
+} pool_t;
+
+/*
+ * Runs jobs from a pool until none are left
+ *
+ * @param arg The pool
+ * @return NULL
+ */
+static void *drain(void *arg){
+	pool_t *pool = (pool_t *)arg;
+	size_t i;
+	while((i = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED)) < pool->count){
+		relabel(&pool->jobs[i]);
+	}
+	return NULL;
+}
+
+/*
+ * Relabels every component that has lost friendships since the last pass
+ *
+ * @param c The components
+ * @param users Every user, indexed by id
+ * @param threads The most threads to use
+ */
+static void refresh(Components c, person_t **users, unsigned threads){
+	if(c->ends_length == 0){
+		return;
+	}
+	if(++c->pass == 0){ //Stamps wrapped around, so none can be trusted
+		memset(c->stamp, 0, c->nodes * sizeof(uint32_t));
+		c->pass = 1;
+	}
+
+	//Group the ends by the component they are in now
+	size_t length = c->ends_length;
+	uint64_t *keys = (uint64_t *)malloc(length * sizeof(uint64_t));
+	uint32_t *ends = (uint32_t *)malloc(length * sizeof(uint32_t));
+	job_t *jobs = (job_t *)malloc(length * sizeof(job_t));
+	assert(keys != NULL && ends != NULL && jobs != NULL);
+	for(size_t i = 0; i < length; i++){
+		keys[i] = ((uint64_t)find(c, c->ends[i]) << 32) | c->ends[i];
+	}
+	qsort(keys, length, sizeof(uint64_t), compareKeys);
+
+	pool_t pool = {jobs, 0, 0};
+	for(size_t i = 0; i < length; i++){
+		uint32_t root = (uint32_t)(keys[i] >> 32);
+		ends[i] = (uint32_t)keys[i];
+		if(i == 0 || root != (uint32_t)(keys[i - 1] >> 32)){
+			job_t *job = &jobs[pool.count++];
+			job->c = c;
+			job->users = users;
+			job->ends = &ends[i];
+			job->length = 0;
+			job->old_size = c->size[root];
+		}
+		jobs[pool.count - 1].length++;
+	}
+
+	//Components are disjoint, so each can be relabeled on its own thread
+	size_t n = threads < pool.count ? threads : pool.count;
+	pthread_t *workers = (pthread_t *)malloc(n * sizeof(pthread_t));
+	assert(workers != NULL);
+	size_t started = 1;
+	for(size_t i = 1; i < n; i++){ //Fall back to this thread if one cannot start
+		if(pthread_create(&workers[i], NULL, drain, &pool) != 0){
+			break;
+		}
+		started++;
+	}
+	drain(&pool);
+	for(size_t i = 1; i < started; i++){
+		pthread_join(workers[i], NULL);
+	}
+
+	for(size_t i = 0; i < pool.count; i++){
+		for(size_t j = 0; j < jobs[i].piece_count; j++){
+			resize(c, 0, jobs[i].pieces[j]);
+		}
+		resize(c, jobs[i].old_size, 0);
+		c->count = c->count + jobs[i].piece_count - 1; //A component of removed users leaves no pieces
+		free(jobs[i].pieces);
+	}
+	c->ends_length = 0;
+
+	//Nobody reaches a removed user's node any more
+	memcpy(c->spare + c->spare_count, c->retired, c->retired_count * sizeof(uint32_t));
+	c->spare_count += c->retired_count;
+	c->retired_count = 0;
+	free(workers);
+	free(jobs);
+	free(ends);
+	free(keys);
+}
+
+Components components_create( void ){
+	Components c = (Components)calloc(1, sizeof(struct Components_t));
+	assert(c != NULL);
+	return c;
+}
+
+void components_destroy( Components c ){
+	free(c->parent);
+	free(c->size);
+	free(c->stamp);
+	free(c->owner);
+	free(c->node);
+	free(c->spare);
+	free(c->retired);
+	free(c->histogram);
+	free(c->ends);
+	free(c);
+}
+
+/*
+ * Records one end of a removed friendship
+ *
+ * @param c The components
+ * @param x The node at the end
+ */
+static void pushEnd(Components c, uint32_t x){
+	if(c->ends_length == c->ends_capacity){
+		c->ends_capacity = c->ends_capacity == 0 ? 64 : c->ends_capacity * 2;
+		c->ends = (uint32_t *)realloc(c->ends, c->ends_capacity * sizeof(uint32_t));
+		assert(c->ends != NULL);
+	}
+	c->ends[c->ends_length++] = x;
+}
+
+void components_clear( Components c ){
+	c->users = 0;
+	c->nodes = 0;
+	c->spare_count = 0;
+	c->retired_count = 0;
+	c->count = 0;
+	c->largest = 0;
+	c->ends_length = 0;
+	if(c->histogram != NULL){
+		memset(c->histogram, 0, (c->capacity + 1) * sizeof(uint32_t));
+	}
+}
+
+void components_add( Components c, uint32_t id ){
+	assert(id == c->users);
+	uint32_t x;
+	if(c->spare_count > 0){ //Reuse a removed user's node
+		x = c->spare[--c->spare_count];
+	}
+	else{
+		if(c->nodes == c->capacity){ //Grow every array geometrically
+			size_t capacity = c->capacity == 0 ? 64 : c->capacity * 2;
+			c->parent = (uint32_t *)realloc(c->parent, capacity * sizeof(uint32_t));
+			c->size = (uint32_t *)realloc(c->size, capacity * sizeof(uint32_t));
+			c->stamp = (uint32_t *)realloc(c->stamp, capacity * sizeof(uint32_t));
+			c->owner = (uint32_t *)realloc(c->owner, capacity * sizeof(uint32_t));
+			c->node = (uint32_t *)realloc(c->node, capacity * sizeof(uint32_t));
+			c->spare = (uint32_t *)realloc(c->spare, capacity * sizeof(uint32_t));
+			c->retired = (uint32_t *)realloc(c->retired, capacity * sizeof(uint32_t));
+			c->histogram = (uint32_t *)realloc(c->histogram, (capacity + 1) * sizeof(uint32_t));
+			assert(c->parent != NULL && c->size != NULL && c->stamp != NULL && c->owner != NULL && c->node != NULL
+				&& c->spare != NULL && c->retired != NULL && c->histogram != NULL);
+			size_t from = c->capacity == 0 ? 0 : c->capacity + 1;
+			memset(c->histogram + from, 0, (capacity + 1 - from) * sizeof(uint32_t));
+			c->capacity = capacity;
+		}
+		x = (uint32_t)c->nodes++;
+	}
+	c->parent[x] = x;
+	c->size[x] = 1;
+	c->stamp[x] = c->pass;
+	c->owner[x] = id;
+	c->node[id] = x;
+	c->users++;
+	c->count++;
+	resize(c, 0, 1);
+}
+
+void components_remove( Components c, uint32_t id ){
+	uint32_t x = c->node[id];
+	c->owner[x] = NO_USER;
+	if(c->ends_length == 0){ //The components are exact and the user has no friends, so they are alone
+		c->count--;
+		resize(c, 1, 0);
+		c->spare[c->spare_count++] = x;
+	}
+	else{ //Let the next pass drop the node from its component
+		pushEnd(c, x);
+		c->retired[c->retired_count++] = x;
+	}
+
+	uint32_t last = (uint32_t)(c->users - 1);
+	if(id != last){
+		c->node[id] = c->node[last];
+		c->owner[c->node[id]] = id;
+	}
+	c->users--;
+}
+
+void components_union( Components c, uint32_t a, uint32_t b ){
+	a = find(c, c->node[a]);
+	b = find(c, c->node[b]);
+	if(a == b){
+		return;
+	}
+	if(c->size[a] < c->size[b]){ //Hang the smaller tree under the larger
+		uint32_t swap = a;
+		a = b;
+		b = swap;
+	}
+	size_t before_a = c->size[a];
+	size_t before_b = c->size[b];
+	c->parent[b] = a;
+	c->size[a] += c->size[b];
+	c->count--;
+	resize(c, before_b, 0);
+	resize(c, before_a, c->size[a]);
+}
+
+void components_split( Components c, uint32_t a, uint32_t b ){
+	pushEnd(c, c->node[a]);
+	pushEnd(c, c->node[b]);
+}
+
+bool components_pending( const Components c ){
+	return c->ends_length != 0;
+}
+
+bool components_connected( Components c, person_t** users, unsigned threads, uint32_t a, uint32_t b ){
+	refresh(c, users, threads);
+	return find(c, c->node[a]) == find(c, c->node[b]);
+}
+
+size_t components_count( Components c, person_t** users, unsigned threads ){
+	refresh(c, users, threads);
+	return c->count;
+}
+
+size_t components_largest( Components c, person_t** users, unsigned threads ){
+	refresh(c, users, threads);
+	return c->largest;
+}
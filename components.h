@@ -0,0 +1,130 @@
+/// @file components.h
+/// @brief Connected components of the friendship graph, kept up to date as
+/// friendships come and go.
+///
+/// General Notes on components Operation
+///
+/// - New friendships merge components right away with union-find (union by
+///   size with path halving), which costs near-constant time.
+///
+/// - A removed friendship may split its component, which union-find cannot
+///   undo.  The two users are remembered instead, and the next query
+///   relabels only the components that lost friendships, by searching from
+///   the remembered users.  Several such components are relabeled in
+///   parallel when more than one thread is allowed.
+///
+/// - A histogram of component sizes keeps the largest component at hand
+///   without scanning every component.
+///
+/// - User ids stay dense: removing a user hands the last user's id to the
+///   removed user's place, in constant time.
+///
+/// @author Bennett Moore bwm7637@rit.edu
+
+#ifndef COMPONENTS_H
+#define COMPONENTS_H
+
+#include <stdbool.h>    // bool
+#include <stddef.h>     // size_t
+#include <stdint.h>     // uint32_t
+
+#include "person.h"
+
+/// The Components data type is a pointer to an opaque structure.
+typedef struct Components_t * Components;
+
+/// Create an empty set of components.
+///
+/// @exception Assert fails if it cannot allocate space
+/// @return A set with no users
+///
+Components components_create( void );
+
+/// Release a set of components.
+///
+/// @param c The components
+/// @post c is not a valid instance of components.
+///
+void components_destroy( Components c );
+
+/// Forget every user.
+///
+/// @param c The components
+///
+void components_clear( Components c );
+
+/// Add a new user with no friends.
+///
+/// @param c The components
+/// @param id The user's id
+/// @exception Assert fails if it cannot allocate space
+/// @pre id is the number of users added since the last clear.
+///
+void components_add( Components c, uint32_t id );
+
+/// Forget a user, and give the user with the highest id the removed user's
+/// id.
+///
+/// @param c The components
+/// @param id The id of the user to forget
+/// @pre The user has no friends left, and components_split() has recorded
+///      every friendship they had since the last query.
+///
+void components_remove( Components c, uint32_t id );
+
+/// Record a new friendship.
+///
+/// @param c The components
+/// @param a The id of one friend
+/// @param b The id of the other friend
+///
+void components_union( Components c, uint32_t a, uint32_t b );
+
+/// Record a removed friendship.
+///
+/// @param c The components
+/// @param a The id of one former friend
+/// @param b The id of the other former friend
+/// @exception Assert fails if it cannot allocate space
+///
+void components_split( Components c, uint32_t a, uint32_t b );
+
+/// Check whether any removed friendship has yet to be accounted for.  If
+/// not, the queries below only read the components; otherwise they first
+/// walk the friend lists of the affected users.
+///
+/// @param c The components
+/// @return Whether a query would need to relabel any component
+///
+bool components_pending( const Components c );
+
+/// Check whether two users are linked by any chain of friendships.
+///
+/// @param c The components
+/// @param users Every user, indexed by id, with current friend lists
+/// @param threads The most threads to relabel split components with
+/// @param a The id of one user
+/// @param b The id of the other user
+/// @return Whether a and b are in the same component
+///
+bool components_connected( Components c, person_t** users, unsigned threads, uint32_t a, uint32_t b );
+
+/// Get the number of components.
+///
+/// @param c The components
+/// @param users Every user, indexed by id, with current friend lists
+/// @param threads The most threads to relabel split components with
+/// @return The number of components
+///
+size_t components_count( Components c, person_t** users, unsigned threads );
+
+/// Get the size of the largest component.
+///
+/// @param c The components
+/// @param users Every user, indexed by id, with current friend lists
+/// @param threads The most threads to relabel split components with
+/// @return The number of users in the largest component, 0 if there are none
+///
+size_t components_largest( Components c, person_t** users, unsigned threads );
+
+#endif // COMPONENTS_H
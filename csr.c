@@ -0,0 +1,84 @@
+/*
+ * file: csr.c
+ *
+ * Compressed sparse row graph. Row i of the neighbor array holds user i's
+ * friends and runs from offsets[i] up to offsets[i + 1].
+ *
+ * @author Bennett Moore bwm7637@rit.edu
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "csr.h"
+#include "intersect.h"
+
+struct Csr_t{
+	size_t count;			// Number of users
+	uint64_t *offsets;		// count + 1 row starts
+	uint32_t *neighbors;		// Friend ids, row after row
+	uint32_t *sorted;		// The same rows, each sorted by id
+	csr_user_t *users;		// Names, indexed by id
+};
+
+Csr csr_build( person_t** users, size_t count ){
+	Csr g = (Csr)malloc(sizeof(struct Csr_t));
+	assert(g != NULL);
+	g->count = count;
+	g->offsets = (uint64_t *)malloc((count + 1) * sizeof(uint64_t));
+	g->users = (csr_user_t *)malloc((count + 1) * sizeof(csr_user_t));
+	assert(g->offsets != NULL && g->users != NULL);
+
+	g->offsets[0] = 0;
+	for(size_t i = 0; i < count; i++){
+		g->offsets[i + 1] = g->offsets[i] + users[i]->friend_count;
+		g->users[i].first_name = users[i]->first_name;
+		g->users[i].last_name = users[i]->last_name;
+		g->users[i].handle = users[i]->handle;
+	}
+
+	g->neighbors = (uint32_t *)malloc((size_t)(g->offsets[count] + 1) * sizeof(uint32_t));
+	assert(g->neighbors != NULL);
+	for(size_t i = 0; i < count; i++){
+		if(users[i]->friend_count > 0){
+			memcpy(g->neighbors + g->offsets[i], users[i]->friends, users[i]->friend_count * sizeof(uint32_t));
+		}
+	}
+
+	g->sorted = (uint32_t *)malloc((size_t)(g->offsets[count] + 1) * sizeof(uint32_t));
+	assert(g->sorted != NULL);
+	memcpy(g->sorted, g->neighbors, (size_t)g->offsets[count] * sizeof(uint32_t));
+	for(size_t i = 0; i < count; i++){
+		intersect_sort(g->sorted + g->offsets[i], (size_t)(g->offsets[i + 1] - g->offsets[i]));
+	}
+	return g;
+}
+
+void csr_destroy( Csr g ){
+	free(g->offsets);
+	free(g->neighbors);
+	free(g->sorted);
+	free(g->users);
+	free(g);
+}
+
+size_t csr_users( const Csr g ){
+	return g->count;
+}
+
+size_t csr_degree( const Csr g, uint32_t id ){
+	return (size_t)(g->offsets[id + 1] - g->offsets[id]);
+}
+
+const uint32_t* csr_neighbors( const Csr g, uint32_t id ){
+	return g->neighbors + g->offsets[id];
+}
+
+const uint32_t* csr_sorted( const Csr g, uint32_t id ){
+	return g->sorted + g->offsets[id];
+}
+
+const csr_user_t* csr_user( const Csr g, uint32_t id ){
+	return &g->users[id];
+}
@@ -0,0 +1,97 @@
+/// @file csr.h
+/// @brief A read-only, compressed sparse row copy of the friendship graph.
+///
+/// Freezing the network copies every friend list into one contiguous array
+/// of 32-bit user ids, indexed by a row offset array, next to a dense array
+/// of user names.  Reading a friend list then walks two flat arrays instead
+/// of following a person_t pointer per friend.
+///
+/// Each friend list is also kept sorted by user id, for set operations
+/// such as finding mutual friends.
+///
+/// A frozen copy does not follow later changes to the network; callers
+/// discard it (thaw the graph) on the first change and freeze again when
+/// reads dominate once more.
+///
+/// @author Bennett Moore bwm7637@rit.edu
+
+#ifndef CSR_H
+#define CSR_H
+
+#include <stddef.h>     // size_t
+#include <stdint.h>     // uint32_t, uint64_t
+
+#include "person.h"
+
+/// The names of a user in a frozen graph.  The strings belong to the
+/// network, not to the graph.
+typedef struct csr_user_s{
+	const char *first_name;		// First name
+	const char *last_name;		// Last name
+	const char *handle;		// Username
+} csr_user_t;
+
+/// The Csr data type is a pointer to an opaque structure.
+typedef struct Csr_t * Csr;
+
+/// Freeze the network into a new graph.
+///
+/// @param users Every user, indexed by id
+/// @param count The number of users
+/// @exception Assert fails if it cannot allocate space
+/// @pre users[i]->id == i for every user.
+/// @return The frozen graph; friend lists keep their current order
+///
+Csr csr_build( person_t** users, size_t count );
+
+/// Release a frozen graph.
+///
+/// @param g The graph
+/// @post g is not a valid instance of csr.
+///
+void csr_destroy( Csr g );
+
+/// Get the number of users in a frozen graph.
+///
+/// @param g The graph
+/// @return The number of users
+///
+size_t csr_users( const Csr g );
+
+/// Get the number of friends of a user in a frozen graph.
+///
+/// @param g The graph
+/// @param id The user
+/// @pre id < csr_users(g).
+/// @return The user's number of friends
+///
+size_t csr_degree( const Csr g, uint32_t id );
+
+/// Get the friends of a user in a frozen graph.
+///
+/// @param g The graph
+/// @param id The user
+/// @pre id < csr_users(g).
+/// @return csr_degree(g, id) user ids
+///
+const uint32_t* csr_neighbors( const Csr g, uint32_t id );
+
+/// Get the friends of a user in a frozen graph, sorted by id.
+///
+/// @param g The graph
+/// @param id The user
+/// @pre id < csr_users(g).
+/// @return csr_degree(g, id) user ids in increasing order
+///
+const uint32_t* csr_sorted( const Csr g, uint32_t id );
+
+/// Get the names of a user in a frozen graph.
+///
+/// @param g The graph
+/// @param id The user
+/// @pre id < csr_users(g).
+/// @return The user's names
+///
+const csr_user_t* csr_user( const Csr g, uint32_t id );
+
+#endif // CSR_H
@@ -0,0 +1,326 @@
+/*
+ * file: friends.c
+ *
+ * Friend list storage for person_t, as arrays of friends' ids. The index is
+ * a linear-probing table of (position + 1) entries into the friends array, with 0 marking an empty
+ * slot; removals use backward-shift deletion so no tombstones build up. A
+ * table never holds as many entries as slots, so tables of up to
+ * FRIEND_NARROW_SLOTS slots store their entries in 16 bits.
+ *
+ * @author Bennett Moore bwm7637@rit.edu
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "friends.h"
+
+/*
+ * Hashes a friend's id into an index slot
+ *
+ * @param f The friend's id
+ * @param mask The index mask of the list being searched
+ * @return The home slot of f
+ */
+static inline size_t slotOf(uint32_t f, size_t mask){
+	return (size_t)(((uint64_t)f * 0x9e3779b97f4a7c15ULL) >> 32) & mask;
+}
+
+/*
+ * Computes the bytes of an index
+ *
+ * @param slots The number of slots
+ * @return The bytes the slots take
+ */
+static inline size_t indexBytes(size_t slots){
+	return slots * (slots <= FRIEND_NARROW_SLOTS ? sizeof(uint16_t) : sizeof(uint32_t));
+}
+
+/*
+ * Reads an index slot
+ *
+ * @param p The person whose index is read
+ * @param slot The slot
+ * @pre p->friend_index is not NULL
+ * @return The position plus one of the friend in the slot, 0 if it is empty
+ */
+static inline uint32_t entryAt(const person_t *p, size_t slot){
+	if(p->index_mask < FRIEND_NARROW_SLOTS){
+		return ((const uint16_t *)p->friend_index)[slot];
+	}
+	return ((const uint32_t *)p->friend_index)[slot];
+}
+
+/*
+ * Writes an index slot
+ *
+ * @param p The person whose index is written
+ * @param slot The slot
+ * @param entry The position plus one of a friend, or 0 to empty the slot
+ * @pre p->friend_index is not NULL, and entry is less than the number of slots
+ */
+static inline void setEntry(person_t *p, size_t slot, uint32_t entry){
+	if(p->index_mask < FRIEND_NARROW_SLOTS){
+		((uint16_t *)p->friend_index)[slot] = (uint16_t)entry;
+	}
+	else{
+		((uint32_t *)p->friend_index)[slot] = entry;
+	}
+}
+
+/*
+ * Finds the index slot holding a friend
+ *
+ * @param p The person whose index is searched
+ * @param f The friend's id
+ * @pre p->friend_index is not NULL
+ * @return The slot holding f, or the empty slot that ends its probe sequence
+ */
+static size_t findSlot(const person_t *p, uint32_t f){
+	size_t i = slotOf(f, p->index_mask);
+	uint32_t entry;
+	while((entry = entryAt(p, i)) != 0 && p->friends[entry - 1] != f){
+		i = (i + 1) & p->index_mask;
+	}
+	return i;
+}
+
+/*
+ * Rebuilds a person's index, or drops it if the list has become small
+ *
+ * @param a The arena that owns the index
+ * @param p The person whose index is rebuilt
+ */
+static void reindex(Arena a, person_t *p){
+	if(p->friend_index != NULL){
+		arena_free(a, p->friend_index, friends_index_bytes(p));
+	}
+	p->friend_index = NULL;
+	p->index_mask = 0;
+	if(p->friend_count <= FRIEND_INDEX_THRESHOLD / 2){ //Hysteresis below the threshold
+		return;
+	}
+
+	//Start at most half full; adds may fill it to 3/4, removes empty it to 1/8
+	size_t slots = FRIEND_INDEX_THRESHOLD * 2;
+	while(slots < p->friend_count * 2){
+		slots *= 2;
+	}
+	p->friend_index = arena_alloc(a, indexBytes(slots));
+	memset(p->friend_index, 0, indexBytes(slots));
+	p->index_mask = (uint32_t)(slots - 1);
+
+	for(size_t i = 0; i < p->friend_count; i++){
+		setEntry(p, findSlot(p, p->friends[i]), (uint32_t)(i + 1));
+	}
+}
+
+/*
+ * Resizes a person's friends array
+ *
+ * @param a The arena that owns the array
+ * @param p The person
+ * @param capacity The new capacity of the friends array
+ */
+static void resize(Arena a, person_t *p, size_t capacity){
+	uint32_t *friends = (uint32_t *)arena_alloc(a, capacity * sizeof(uint32_t));
+	if(p->friend_count > 0){
+		memcpy(friends, p->friends, p->friend_count * sizeof(uint32_t));
+	}
+	if(p->friends != NULL){
+		arena_free(a, p->friends, p->max_friends * sizeof(uint32_t));
+	}
+	p->friends = friends;
+	p->max_friends = (uint32_t)capacity;
+}
+
+/*
+ * Finds where a friend sits in a person's friend list
+ *
+ * @param p The person
+ * @param f The friend's id
+ * @return f's position in p's friend list, or p->friend_count if f is not in it
+ */
+static size_t positionOf(const person_t *p, uint32_t f){
+	if(p->friend_index != NULL){
+		uint32_t entry = entryAt(p, findSlot(p, f));
+		return entry == 0 ? p->friend_count : entry - 1;
+	}
+	size_t pos;
+	for(pos = 0; pos < p->friend_count && p->friends[pos] != f; pos++);
+	return pos;
+}
+
+/*
+ * Empties an index slot, shifting later entries of the same cluster back
+ *
+ * @param p The person whose index is updated
+ * @param hole The slot to empty
+ */
+static void eraseSlot(person_t *p, size_t hole){
+	size_t i = hole;
+	while(true){
+		i = (i + 1) & p->index_mask;
+		uint32_t entry = entryAt(p, i);
+		if(entry == 0){
+			break;
+		}
+
+		//Move the entry back if its home slot does not lie in (hole, i]
+		size_t home = slotOf(p->friends[entry - 1], p->index_mask);
+		if(((i - home) & p->index_mask) >= ((i - hole) & p->index_mask)){
+			setEntry(p, hole, entry);
+			hole = i;
+		}
+	}
+	setEntry(p, hole, 0);
+}
+
+bool friends_has( const person_t* p1, const person_t* p2 ){
+	//Friendship is mutual, so search whichever side is cheaper
+	if(p1->friend_index == NULL && p2->friend_index != NULL){
+		const person_t *swap = p1;
+		p1 = p2;
+		p2 = swap;
+	}
+	if(p1->friend_index == NULL && p2->friend_count < p1->friend_count){
+		const person_t *swap = p1;
+		p1 = p2;
+		p2 = swap;
+	}
+	return positionOf(p1, p2->id) < p1->friend_count;
+}
+
+bool friends_contains( const person_t* p, uint32_t id ){
+	return positionOf(p, id) < p->friend_count;
+}
+
+size_t friends_common( const person_t* p1, const person_t* p2, uint32_t* out ){
+	if(p2->friend_count < p1->friend_count){
+		const person_t *swap = p1;
+		p1 = p2;
+		p2 = swap;
+	}
+	size_t n = 0;
+	for(size_t i = 0; i < p1->friend_count; i++){
+		if(friends_contains(p2, p1->friends[i])){
+			if(out != NULL){
+				out[n] = p1->friends[i];
+			}
+			n++;
+		}
+	}
+	return n;
+}
+
+size_t friends_position( const person_t* p, const person_t* f ){
+	return positionOf(p, f->id);
+}
+
+void friends_add( Arena a, person_t* p, person_t* f ){
+	if(p->friend_count == p->max_friends){ //Grow geometrically
+		resize(a, p, p->max_friends == 0 ? FRIEND_BLOCK : p->max_friends * 2);
+	}
+	p->friends[p->friend_count++] = f->id;
+
+	if(p->friend_index != NULL && p->friend_count * 4 <= ((size_t)p->index_mask + 1) * 3){
+		setEntry(p, findSlot(p, f->id), p->friend_count);
+	}
+	else if(p->friend_count > FRIEND_INDEX_THRESHOLD){ //Index is missing or too full
+		reindex(a, p);
+	}
+}
+
+bool friends_remove( Arena a, person_t* p, person_t* f ){
+	size_t pos;
+	if(p->friend_index != NULL){
+		size_t slot = findSlot(p, f->id);
+		if(entryAt(p, slot) == 0){
+			return false;
+		}
+		pos = entryAt(p, slot) - 1;
+		eraseSlot(p, slot);
+	}
+	else{
+		for(pos = 0; pos < p->friend_count && p->friends[pos] != f->id; pos++);
+		if(pos == p->friend_count){
+			return false;
+		}
+	}
+
+	//Fill the gap with the last friend
+	size_t last = p->friend_count - 1;
+	if(pos != last){
+		p->friends[pos] = p->friends[last];
+		if(p->friend_index != NULL){
+			setEntry(p, findSlot(p, p->friends[pos]), (uint32_t)(pos + 1));
+		}
+	}
+	p->friend_count--;
+
+	//Shrink only once the list is a quarter full so add/remove cannot thrash
+	if(p->friend_count == 0){
+		friends_clear(a, p);
+	}
+	else if(p->max_friends > FRIEND_BLOCK && p->friend_count * 4 <= p->max_friends){
+		resize(a, p, p->max_friends / 2);
+	}
+	if(p->friend_index != NULL && (p->friend_count <= FRIEND_INDEX_THRESHOLD / 2 || p->friend_count * 8 < (size_t)p->index_mask + 1)){
+		reindex(a, p);
+	}
+	return true;
+}
+
+void friends_rename( person_t* p, uint32_t from, uint32_t to ){
+	size_t pos;
+	if(p->friend_index != NULL){
+		size_t slot = findSlot(p, from);
+		assert(entryAt(p, slot) != 0);
+		pos = entryAt(p, slot) - 1;
+		eraseSlot(p, slot);
+		p->friends[pos] = to;
+		setEntry(p, findSlot(p, to), (uint32_t)(pos + 1));
+	}
+	else{
+		for(pos = 0; p->friends[pos] != from; pos++);
+		p->friends[pos] = to;
+	}
+}
+
+void friends_assign( Arena a, person_t* p, const uint32_t* list, size_t count ){
+	friends_clear(a, p);
+	if(count == 0){
+		return;
+	}
+
+	//Same capacities friends_add would reach, without the intermediate copies
+	size_t capacity = FRIEND_BLOCK;
+	while(capacity < count){
+		capacity *= 2;
+	}
+	resize(a, p, capacity);
+	memcpy(p->friends, list, count * sizeof(uint32_t));
+	p->friend_count = (uint32_t)count;
+	if(count > FRIEND_INDEX_THRESHOLD){
+		reindex(a, p);
+	}
+}
+
+size_t friends_index_bytes( const person_t* p ){
+	return p->friend_index != NULL ? indexBytes((size_t)p->index_mask + 1) : 0;
+}
+
+void friends_clear( Arena a, person_t* p ){
+	if(p->friends != NULL){
+		arena_free(a, p->friends, p->max_friends * sizeof(uint32_t));
+	}
+	if(p->friend_index != NULL){
+		arena_free(a, p->friend_index, friends_index_bytes(p));
+	}
+	p->friends = NULL;
+	p->friend_index = NULL;
+	p->friend_count = 0;
+	p->max_friends = 0;
+	p->index_mask = 0;
+}
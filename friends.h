@@ -0,0 +1,134 @@
+/// @file friends.h
+/// @brief Constant-time friend list operations on a person_t.
+///
+/// A person's friends are kept as 32-bit user ids in the dense
+/// person_t::friends array, which grows and shrinks geometrically; ids take
+/// half the space of pointers. Small lists are searched directly; once
+/// a list grows past FRIEND_INDEX_THRESHOLD entries, an open-addressing
+/// index from friend to array position is built alongside it so membership,
+/// insertion and removal stay O(1) regardless of how popular a user is.
+/// The index is kept between 1/8 and 3/4 full, and stores positions in 16
+/// bits while it has at most FRIEND_NARROW_SLOTS slots.
+///
+/// Friend storage is allocated from the network's Arena, so it is released
+/// along with everything else when the arena is reset.
+///
+/// Removing a friend moves the last friend into the vacated position, so
+/// the order of the list is insertion order only until the first removal.
+///
+/// @author Bennett Moore bwm7637@rit.edu
+
+#ifndef FRIENDS_H
+#define FRIENDS_H
+
+#include <stdbool.h>    // bool
+#include <stddef.h>     // size_t
+#include <stdint.h>     // uint32_t
+
+#include "arena.h"
+#include "person.h"
+
+/// Smallest non-empty capacity of a friend list
+#define FRIEND_BLOCK 4
+
+/// Friend lists longer than this are given a hash index
+#define FRIEND_INDEX_THRESHOLD 32
+
+/// Indexes with at most this many slots store positions in 16 bits
+#define FRIEND_NARROW_SLOTS 65536
+
+/// Check whether two people are friends.
+///
+/// @param p1 The first person
+/// @param p2 The second person
+/// @return Whether p2 is in p1's friend list
+///
+bool friends_has( const person_t* p1, const person_t* p2 );
+
+/// Check whether a person's friend list holds an id.
+///
+/// @param p The person
+/// @param id The id to look for
+/// @return Whether id is in p's friend list
+///
+bool friends_contains( const person_t* p, uint32_t id );
+
+/// Find the friends two people have in common, walking the shorter list
+/// and looking each friend up in the longer one.
+///
+/// @param p1 The first person
+/// @param p2 The second person
+/// @param out Receives the common friends' ids in the shorter list's order,
+///        or NULL to only count them; must have room for the shorter list
+/// @return The number of common friends
+///
+size_t friends_common( const person_t* p1, const person_t* p2, uint32_t* out );
+
+/// Find where a friend sits in a person's friend list, through the index
+/// when the list has one.
+///
+/// @param p The person
+/// @param f The friend to look for
+/// @return f's position in p's friend list, or p->friend_count if f is not
+///         in it; positions change when p loses a friend, so they do not
+///         mark a place across removals
+///
+size_t friends_position( const person_t* p, const person_t* f );
+
+/// Add a person to another person's friend list.
+///
+/// @param a The arena that owns p's friend storage
+/// @param p The person whose list grows
+/// @param f The new friend
+/// @exception Assert fails if it cannot allocate space
+/// @pre friends_has(p, f) is false.
+///
+void friends_add( Arena a, person_t* p, person_t* f );
+
+/// Remove a person from another person's friend list.
+///
+/// @param a The arena that owns p's friend storage
+/// @param p The person whose list shrinks
+/// @param f The friend to remove
+/// @return Whether f was in p's friend list
+///
+bool friends_remove( Arena a, person_t* p, person_t* f );
+
+/// Change one id in a person's friend list, after the friend it names is
+/// given a new id.
+///
+/// @param p The person
+/// @param from The friend's old id
+/// @param to The friend's new id
+/// @pre from is in p's friend list and to is not.
+///
+void friends_rename( person_t* p, uint32_t from, uint32_t to );
+
+/// Replace a person's friend list with a copy of an array, sizing its
+/// storage once instead of growing it a friend at a time.
+///
+/// @param a The arena that owns p's friend storage
+/// @param p The person whose list is replaced
+/// @param list The new friends' ids, in list order
+/// @param count The number of entries in list
+/// @exception Assert fails if it cannot allocate space
+/// @pre list has no duplicates and does not contain p.
+///
+void friends_assign( Arena a, person_t* p, const uint32_t* list, size_t count );
+
+/// Get the bytes taken by a person's friend index.
+///
+/// @param p The person
+/// @return The bytes of p's index, 0 if p has none
+///
+size_t friends_index_bytes( const person_t* p );
+
+/// Release the storage behind a person's friend list.
+///
+/// @param a The arena that owns p's friend storage
+/// @param p The person
+/// @post p has no friends and owns no friend storage.
+///
+void friends_clear( Arena a, person_t* p );
+
+#endif // FRIENDS_H
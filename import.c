@@ -0,0 +1,538 @@
+/*
+ * file: import.c
+ *
+ * Parallel bulk loading. Each stage splits its input into one slice per
+ * thread and writes only to memory its slice owns, so the stages need no
+ * locks; results are merged in slice order, which keeps everything in
+ * file order.
+ *
+ * @author Bennett Moore bwm7637@rit.edu
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "batch.h"
+#include "friends.h"
+#include "import.h"
+
+#define MAX_FIELDS 4			// Most fields a row may be asked to have
+#define INVALID_KEY UINT64_MAX		// Key of a row that names no friendship
+
+struct Import_t{
+	char *map;			// The file, mapped copy-on-write
+	size_t len;			// Bytes in map
+	size_t fields;			// Fields per row
+	char **cells;			// Fields of every row, row after row
+	size_t rows;			// Number of well-formed rows
+	size_t malformed;		// Number of rows skipped
+	char *tail;			// Copy of an unterminated last line, or NULL
+};
+
+typedef struct parse_s{
+	char *begin;			// Slice of the file to split
+	char *end;
+	size_t fields;
+	char **cells;			// Fields of the slice's rows
+	size_t rows;
+	size_t capacity;		// Room for this many rows
+	size_t malformed;
+	char *tail;			// Copy of an unterminated last line, or NULL
+} parse_t;
+
+typedef struct entry_s{
+	uint64_t key;			// Lower id in the high half, higher id in the low half
+	size_t row;			// Row the friendship was read from
+} entry_t;
+
+typedef struct resolve_s{
+	Import im;
+	Table t;
+	size_t count;			// Number of users
+	size_t begin;			// Slice of rows to resolve
+	size_t end;
+	uint64_t *keys;			// Receives each row's key
+	size_t shards;			// Number of shards
+	size_t *cursor;			// Rows per shard, then where the next one goes
+	entry_t *entries;		// Rows grouped by shard
+	size_t invalid;
+} resolve_t;
+
+typedef struct shard_s{
+	person_t **users;
+	entry_t *entries;		// The shard's rows
+	size_t length;			// Number of rows in the shard
+	unsigned char *keep;		// Set for each row that makes a new friendship
+	size_t repeated;
+} shard_t;
+
+typedef struct link_s{
+	Arena a;
+	person_t **users;
+	const size_t *offsets;		// Where each user's new friends start in adj
+	uint32_t *adj;			// New friends' ids, user after user
+	size_t begin;			// Slice of users to link
+	size_t end;
+} link_t;
+
+/*
+ * Runs one job per thread and waits for all of them
+ *
+ * @param fn The job function
+ * @param jobs The jobs
+ * @param size The size of one job
+ * @param n The number of jobs
+ */
+static void runJobs(void *(*fn)(void *), void *jobs, size_t size, size_t n){
+	pthread_t *workers = (pthread_t *)malloc(n * sizeof(pthread_t));
+	assert(workers != NULL);
+	size_t started = 1;
+	for(size_t i = 1; i < n; i++){ //Fall back to this thread if one cannot start
+		if(pthread_create(&workers[i], NULL, fn, (char *)jobs + i * size) != 0){
+			break;
+		}
+		started++;
+	}
+	for(size_t i = started; i < n; i++){
+		fn((char *)jobs + i * size);
+	}
+	fn(jobs);
+	for(size_t i = 1; i < started; i++){
+		pthread_join(workers[i], NULL);
+	}
+	free(workers);
+}
+
+/*
+ * Splits one line into a row, ignoring any fields past the last one a row
+ * has, as the add and friend commands do
+ *
+ * @param job The slice the line belongs to
+ * @param line The line, NUL terminated
+ */
+static void parseLine(parse_t *job, char *line){
+	char *tokens[MAX_FIELDS];
+	size_t n = batch_tokenize(line, tokens, job->fields);
+	if(n == 0){ //Blank line
+		return;
+	}
+	if(n < job->fields){
+		job->malformed++;
+		return;
+	}
+	if(job->rows == job->capacity){
+		job->capacity = job->capacity == 0 ? 1024 : job->capacity * 2;
+		job->cells = (char **)realloc(job->cells, job->capacity * job->fields * sizeof(char *));
+		assert(job->cells != NULL);
+	}
+	memcpy(job->cells + job->rows * job->fields, tokens, job->fields * sizeof(char *));
+	job->rows++;
+}
+
+/*
+ * Splits every line of a slice into rows
+ *
+ * @param arg The slice
+ * @return NULL
+ */
+static void *parseSlice(void *arg){
+	parse_t *job = (parse_t *)arg;
+	char *c = job->begin;
+	while(c < job->end){
+		char *nl = memchr(c, '\n', (size_t)(job->end - c));
+		if(nl == NULL){ //Last line of the file, which may end the mapping
+			job->tail = strndup(c, (size_t)(job->end - c));
+			assert(job->tail != NULL);
+			parseLine(job, job->tail);
+			break;
+		}
+		*nl = '\0';
+		parseLine(job, c);
+		c = nl + 1;
+	}
+	return NULL;
+}
+
+/*
+ * Looks up the users named by a slice of rows and counts them into shards
+ *
+ * @param arg The slice
+ * @return NULL
+ */
+static void *resolveSlice(void *arg){
+	resolve_t *job = (resolve_t *)arg;
+	for(size_t i = job->begin; i < job->end; i++){
+		char **row = import_row(job->im, i);
+		person_t *p1 = ht_find(job->t, row[0]);
+		person_t *p2 = ht_find(job->t, row[1]);
+		if(p1 == NULL || p2 == NULL || p1 == p2){
+			job->keys[i] = INVALID_KEY;
+			job->invalid++;
+			continue;
+		}
+		uint32_t lo = p1->id < p2->id ? p1->id : p2->id;
+		uint32_t hi = p1->id < p2->id ? p2->id : p1->id;
+		job->keys[i] = ((uint64_t)lo << 32) | hi;
+		job->cursor[(size_t)lo * job->shards / job->count]++;
+	}
+	return NULL;
+}
+
+/*
+ * Copies a slice of rows into the shards, in row order
+ *
+ * @param arg The slice
+ * @return NULL
+ */
+static void *scatterSlice(void *arg){
+	resolve_t *job = (resolve_t *)arg;
+	for(size_t i = job->begin; i < job->end; i++){
+		uint64_t key = job->keys[i];
+		if(key != INVALID_KEY){
+			size_t shard = (size_t)(key >> 32) * job->shards / job->count;
+			entry_t *e = &job->entries[job->cursor[shard]++];
+			e->key = key;
+			e->row = i;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Sorts entries by key with a least significant digit radix sort, which
+ * keeps entries with equal keys in their original order
+ *
+ * @param a The entries
+ * @param tmp Scratch space for as many entries
+ * @param n The number of entries
+ */
+static void radixSort(entry_t *a, entry_t *tmp, size_t n){
+	if(n < 2){
+		return;
+	}
+	size_t (*counts)[256] = (size_t (*)[256])calloc(8, sizeof(*counts));
+	assert(counts != NULL);
+	for(size_t i = 0; i < n; i++){
+		for(unsigned d = 0; d < 8; d++){
+			counts[d][(a[i].key >> (8 * d)) & 0xff]++;
+		}
+	}
+
+	entry_t *from = a;
+	entry_t *to = tmp;
+	for(unsigned d = 0; d < 8; d++){
+		if(counts[d][(from[0].key >> (8 * d)) & 0xff] == n){ //Every key shares this digit
+			continue;
+		}
+		size_t sum = 0;
+		for(size_t b = 0; b < 256; b++){
+			size_t c = counts[d][b];
+			counts[d][b] = sum;
+			sum += c;
+		}
+		for(size_t i = 0; i < n; i++){
+			to[counts[d][(from[i].key >> (8 * d)) & 0xff]++] = from[i];
+		}
+		entry_t *swap = from;
+		from = to;
+		to = swap;
+	}
+	if(from != a){
+		memcpy(a, from, n * sizeof(entry_t));
+	}
+	free(counts);
+}
+
+/*
+ * Sorts a shard and keeps the first row of each friendship not yet made
+ *
+ * @param arg The shard
+ * @return NULL
+ */
+static void *dedupeShard(void *arg){
+	shard_t *job = (shard_t *)arg;
+	entry_t *tmp = (entry_t *)malloc((job->length + 1) * sizeof(entry_t));
+	assert(tmp != NULL);
+	radixSort(job->entries, tmp, job->length);
+	free(tmp);
+
+	for(size_t i = 0; i < job->length; i++){
+		entry_t *e = &job->entries[i];
+		if(i > 0 && e->key == job->entries[i - 1].key){ //Repeat within the file
+			job->repeated++;
+		}
+		else if(friends_has(job->users[e->key >> 32], job->users[(uint32_t)e->key])){ //Already friends
+			job->repeated++;
+		}
+		else{
+			job->keep[e->row] = 1;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Appends new friends to a slice of users' friend lists
+ *
+ * @param arg The slice
+ * @return NULL
+ */
+static void *linkSlice(void *arg){
+	link_t *job = (link_t *)arg;
+	uint32_t *list = NULL;
+	size_t capacity = 0;
+	for(size_t u = job->begin; u < job->end; u++){
+		size_t extra = job->offsets[u + 1] - job->offsets[u];
+		if(extra == 0){
+			continue;
+		}
+		person_t *p = job->users[u];
+		size_t total = p->friend_count + extra;
+		if(total > capacity){
+			capacity = total;
+			list = (uint32_t *)realloc(list, capacity * sizeof(uint32_t));
+			assert(list != NULL);
+		}
+		if(p->friend_count > 0){
+			memcpy(list, p->friends, p->friend_count * sizeof(uint32_t));
+		}
+		memcpy(list + p->friend_count, job->adj + job->offsets[u], extra * sizeof(uint32_t));
+		friends_assign(job->a, p, list, total);
+	}
+	free(list);
+	return NULL;
+}
+
+Import import_read( const char* path, size_t fields, unsigned threads ){
+	assert(fields > 0 && fields <= MAX_FIELDS && threads > 0);
+	int fd = open(path, O_RDONLY);
+	if(fd < 0){
+		return NULL;
+	}
+	struct stat st;
+	if(fstat(fd, &st) != 0){
+		close(fd);
+		return NULL;
+	}
+	Import im = (Import)calloc(1, sizeof(struct Import_t));
+	assert(im != NULL);
+	im->fields = fields;
+	im->len = (size_t)st.st_size;
+	if(im->len == 0){
+		close(fd);
+		return im;
+	}
+
+	//Private mapping: writing the NUL terminators never reaches the file
+	im->map = mmap(NULL, im->len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(im->map == MAP_FAILED){
+		free(im);
+		return NULL;
+	}
+
+	//Cut the file into slices that end just after a newline
+	size_t n = threads;
+	parse_t *jobs = (parse_t *)calloc(n, sizeof(parse_t));
+	assert(jobs != NULL);
+	char *start = im->map;
+	char *end = im->map + im->len;
+	for(size_t i = 0; i < n; i++){
+		char *cut = i + 1 == n ? end : im->map + im->len * (i + 1) / n;
+		if(cut < start){
+			cut = start;
+		}
+		if(cut < end){
+			char *nl = memchr(cut, '\n', (size_t)(end - cut));
+			cut = nl == NULL ? end : nl + 1;
+		}
+		jobs[i].begin = start;
+		jobs[i].end = cut;
+		jobs[i].fields = fields;
+		start = cut;
+	}
+	runJobs(parseSlice, jobs, sizeof(parse_t), n);
+
+	//Merge the slices' rows in file order
+	for(size_t i = 0; i < n; i++){
+		im->rows += jobs[i].rows;
+		im->malformed += jobs[i].malformed;
+	}
+	im->cells = (char **)malloc((im->rows * fields + 1) * sizeof(char *));
+	assert(im->cells != NULL);
+	size_t row = 0;
+	for(size_t i = 0; i < n; i++){
+		if(jobs[i].rows > 0){
+			memcpy(im->cells + row * fields, jobs[i].cells, jobs[i].rows * fields * sizeof(char *));
+		}
+		row += jobs[i].rows;
+		if(jobs[i].tail != NULL){
+			im->tail = jobs[i].tail;
+		}
+		free(jobs[i].cells);
+	}
+	free(jobs);
+	return im;
+}
+
+size_t import_rows( const Import im ){
+	return im->rows;
+}
+
+size_t import_malformed( const Import im ){
+	return im->malformed;
+}
+
+char** import_row( const Import im, size_t row ){
+	return im->cells + row * im->fields;
+}
+
+void import_close( Import im ){
+	if(im->map != NULL){
+		munmap(im->map, im->len);
+	}
+	free(im->cells);
+	free(im->tail);
+	free(im);
+}
+
+void import_edges( const Import im, const Table t, person_t** users, size_t count, unsigned threads,
+                   import_edges_t* out ){
+	assert(im->fields == 2 && threads > 0);
+	memset(out, 0, sizeof(import_edges_t));
+	size_t rows = im->rows;
+	size_t n = threads;
+	uint64_t *keys = (uint64_t *)malloc((rows + 1) * sizeof(uint64_t));
+	resolve_t *jobs = (resolve_t *)calloc(n, sizeof(resolve_t));
+	assert(keys != NULL && jobs != NULL);
+	for(size_t i = 0; i < n; i++){
+		jobs[i].im = im;
+		jobs[i].t = t;
+		jobs[i].count = count;
+		jobs[i].begin = rows * i / n;
+		jobs[i].end = rows * (i + 1) / n;
+		jobs[i].keys = keys;
+		jobs[i].shards = n;
+		jobs[i].cursor = (size_t *)calloc(n, sizeof(size_t));
+		assert(jobs[i].cursor != NULL);
+	}
+	runJobs(resolveSlice, jobs, sizeof(resolve_t), n);
+
+	//Each slice writes its rows of each shard after the slices before it
+	size_t *shard_start = (size_t *)malloc((n + 1) * sizeof(size_t));
+	assert(shard_start != NULL);
+	size_t total = 0;
+	for(size_t s = 0; s < n; s++){
+		shard_start[s] = total;
+		for(size_t i = 0; i < n; i++){
+			size_t rows_here = jobs[i].cursor[s];
+			jobs[i].cursor[s] = total;
+			total += rows_here;
+		}
+	}
+	shard_start[n] = total;
+	entry_t *entries = (entry_t *)malloc((total + 1) * sizeof(entry_t));
+	assert(entries != NULL);
+	for(size_t i = 0; i < n; i++){
+		jobs[i].entries = entries;
+		out->invalid += jobs[i].invalid;
+	}
+	runJobs(scatterSlice, jobs, sizeof(resolve_t), n);
+
+	//Sort and dedupe each shard on its own thread
+	unsigned char *keep = (unsigned char *)calloc(rows + 1, 1);
+	shard_t *shards = (shard_t *)calloc(n, sizeof(shard_t));
+	assert(keep != NULL && shards != NULL);
+	for(size_t s = 0; s < n; s++){
+		shards[s].users = users;
+		shards[s].entries = entries + shard_start[s];
+		shards[s].length = shard_start[s + 1] - shard_start[s];
+		shards[s].keep = keep;
+	}
+	runJobs(dedupeShard, shards, sizeof(shard_t), n);
+
+	//Collect the kept friendships back in file order
+	for(size_t s = 0; s < n; s++){
+		out->repeated += shards[s].repeated;
+	}
+	out->count = total - out->repeated;
+	out->pairs = (uint32_t *)malloc((out->count * 2 + 1) * sizeof(uint32_t));
+	assert(out->pairs != NULL);
+	size_t k = 0;
+	for(size_t i = 0; i < rows; i++){
+		if(keep[i]){
+			out->pairs[k++] = (uint32_t)(keys[i] >> 32);
+			out->pairs[k++] = (uint32_t)keys[i];
+		}
+	}
+
+	for(size_t i = 0; i < n; i++){
+		free(jobs[i].cursor);
+	}
+	free(shards);
+	free(keep);
+	free(entries);
+	free(shard_start);
+	free(jobs);
+	free(keys);
+}
+
+void import_link( Arena a, person_t** users, size_t count, const import_edges_t* edges, unsigned threads ){
+	assert(threads > 0);
+	if(edges->count == 0){
+		return;
+	}
+
+	//Group the new friends by user, each user's in file order
+	size_t *offsets = (size_t *)calloc(count + 1, sizeof(size_t));
+	uint32_t *adj = (uint32_t *)malloc(edges->count * 2 * sizeof(uint32_t));
+	assert(offsets != NULL && adj != NULL);
+	for(size_t i = 0; i < edges->count * 2; i++){
+		offsets[edges->pairs[i] + 1]++;
+	}
+	for(size_t u = 0; u < count; u++){
+		offsets[u + 1] += offsets[u];
+	}
+	size_t *next = (size_t *)malloc((count + 1) * sizeof(size_t));
+	assert(next != NULL);
+	memcpy(next, offsets, count * sizeof(size_t));
+	for(size_t i = 0; i < edges->count; i++){
+		uint32_t u = edges->pairs[2 * i];
+		uint32_t v = edges->pairs[2 * i + 1];
+		adj[next[u]++] = v;
+		adj[next[v]++] = u;
+	}
+	free(next);
+
+	//Give each thread about the same number of new friends to place
+	size_t n = threads;
+	link_t *jobs = (link_t *)calloc(n, sizeof(link_t));
+	assert(jobs != NULL);
+	size_t u = 0;
+	for(size_t i = 0; i < n; i++){
+		jobs[i].a = a;
+		jobs[i].users = users;
+		jobs[i].offsets = offsets;
+		jobs[i].adj = adj;
+		jobs[i].begin = u;
+		size_t target = offsets[count] * (i + 1) / n;
+		while(u < count && (i + 1 == n || offsets[u] < target)){
+			u++;
+		}
+		jobs[i].end = u;
+	}
+	runJobs(linkSlice, jobs, sizeof(link_t), n);
+
+	free(jobs);
+	free(adj);
+	free(offsets);
+}
@@ -0,0 +1,107 @@
+/// @file import.h
+/// @brief Bulk loading of users and friendships from plain text exports.
+///
+/// A users file holds one "first-name last-name handle" line per user, and
+/// an edges file one "handle1 handle2" line per friendship.  Loading them
+/// has the same effect as replaying the matching add and friend commands
+/// in file order, but every stage is spread across threads:
+///
+/// - import_read() maps a file and splits it into rows in parallel, one
+///   slice of the file per thread.
+///
+/// - import_edges() resolves handles to ids in parallel, scatters the
+///   friendships into shards by id range, and sorts each shard on its own
+///   thread to drop repeats, keeping the first occurrence of each.
+///
+/// - import_link() gives every user their whole new friend list with a
+///   single allocation, instead of growing it one friend at a time.
+///
+/// @author Bennett Moore bwm7637@rit.edu
+
+#ifndef IMPORT_H
+#define IMPORT_H
+
+#include <stddef.h>     // size_t
+#include <stdint.h>     // uint32_t
+
+#include "arena.h"
+#include "person.h"
+#include "table.h"
+
+/// The Import data type is a pointer to an opaque structure.
+typedef struct Import_t * Import;
+
+/// New friendships found by import_edges
+typedef struct import_edges_s{
+	uint32_t *pairs;		// Two ids per friendship, in file order
+	size_t count;			// Number of friendships in pairs
+	size_t invalid;			// Rows naming a missing user, or one user twice
+	size_t repeated;		// Rows naming a friendship already made
+} import_edges_t;
+
+/// Read a text file of space separated rows.
+///
+/// @param path The file to read
+/// @param fields The number of fields every row must have; fields after
+///        them are ignored
+/// @param threads The most threads to split the file with
+/// @exception Assert fails if it cannot allocate space
+/// @return The rows, or NULL if the file could not be read
+///
+Import import_read( const char* path, size_t fields, unsigned threads );
+
+/// Get the number of well-formed rows.
+///
+/// @param im The rows
+/// @return The number of rows with enough fields
+///
+size_t import_rows( const Import im );
+
+/// Get the number of non-blank rows that were skipped.
+///
+/// @param im The rows
+/// @return The number of rows with too few fields
+///
+size_t import_malformed( const Import im );
+
+/// Get the fields of one row.
+///
+/// @param im The rows
+/// @param row The row, counting only well-formed rows
+/// @return The fields of the row
+///
+char** import_row( const Import im, size_t row );
+
+/// Release a file read by import_read.
+///
+/// @param im The rows
+/// @post im and every row it returned are no longer valid.
+///
+void import_close( Import im );
+
+/// Find the new friendships in a file of handle pairs.
+///
+/// @param im Rows of two handles each
+/// @param t The table of every user
+/// @param users Every user, indexed by id
+/// @param count The number of users
+/// @param threads The most threads to use
+/// @param out Receives the new friendships; the caller frees out->pairs
+/// @exception Assert fails if it cannot allocate space
+/// @pre Nothing changes t or any friend list until this returns.
+///
+void import_edges( const Import im, const Table t, person_t** users, size_t count, unsigned threads,
+                   import_edges_t* out );
+
+/// Add new friendships to every user's friend list.
+///
+/// @param a The arena that owns the friend lists
+/// @param users Every user, indexed by id
+/// @param count The number of users
+/// @param edges New friendships from import_edges
+/// @param threads The most threads to use
+/// @exception Assert fails if it cannot allocate space
+///
+void import_link( Arena a, person_t** users, size_t count, const import_edges_t* edges, unsigned threads );
+
+#endif // IMPORT_H
@@ -0,0 +1,321 @@
+/*
+ * file: influence.c
+ *
+ * PageRank by pulling: each user's new score is gathered from their friends'
+ * shares of the old scores, so every thread writes only its own slice of
+ * users and no updates need to be atomic. A share is a friend's score
+ * divided by their number of friends, worked out once per user per
+ * iteration by the thread that owns them.
+ *
+ * @author Bennett Moore bwm7637@rit.edu
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "influence.h"
+
+struct Influence_t{
+	double *scores;			// Each user's last score, 0 until their first run
+	size_t users;			// Number of users
+	size_t capacity;		// Room in scores
+};
+
+//One thread's share of an iteration
+typedef struct sweep_s{
+	Csr g;
+	const double *scores;		// Scores of the last iteration
+	const double *shares;		// Each user's score divided by their number of friends
+	double *next;			// Scores of this iteration
+	double *next_shares;		// Shares of this iteration
+	double base;			// Score every user gets from random jumps and users without friends
+	size_t begin;			// Slice of users to score
+	size_t end;
+	double change;			// Total change of the slice's scores
+	double stranded;		// Total new score of the slice's users without friends
+} sweep_t;
+
+/*
+ * Scores a slice of users from their friends' shares
+ *
+ * @param arg The slice, a sweep_t
+ * @return NULL
+ */
+static void *sweepSlice(void *arg){
+	sweep_t *job = (sweep_t *)arg;
+	double change = 0;
+	double stranded = 0;
+	for(size_t u = job->begin; u < job->end; u++){
+		size_t degree = csr_degree(job->g, (uint32_t)u);
+		const uint32_t *row = csr_neighbors(job->g, (uint32_t)u);
+
+		//Independent totals let the adds overlap
+		double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+		size_t i = 0;
+		for(; i + 4 <= degree; i += 4){
+			s0 += job->shares[row[i]];
+			s1 += job->shares[row[i + 1]];
+			s2 += job->shares[row[i + 2]];
+			s3 += job->shares[row[i + 3]];
+		}
+		for(; i < degree; i++){
+			s0 += job->shares[row[i]];
+		}
+
+		double score = job->base + INFLUENCE_DAMPING * ((s0 + s1) + (s2 + s3));
+		double moved = score - job->scores[u];
+		change += moved < 0 ? -moved : moved;
+		job->next[u] = score;
+		if(degree > 0){
+			job->next_shares[u] = score / (double)degree;
+		}
+		else{
+			job->next_shares[u] = 0;
+			stranded += score;
+		}
+	}
+	job->change = change;
+	job->stranded = stranded;
+	return NULL;
+}
+
+/*
+ * Runs one job per thread and waits for all of them
+ *
+ * @param jobs The jobs
+ * @param n The number of jobs
+ */
+static void runJobs(sweep_t *jobs, size_t n){
+	if(n == 1){
+		sweepSlice(&jobs[0]);
+		return;
+	}
+	pthread_t *workers = (pthread_t *)malloc(n * sizeof(pthread_t));
+	assert(workers != NULL);
+	size_t started = 1;
+	for(size_t i = 1; i < n; i++){ //Fall back to this thread if one cannot start
+		if(pthread_create(&workers[i], NULL, sweepSlice, &jobs[i]) != 0){
+			break;
+		}
+		started++;
+	}
+	for(size_t i = started; i < n; i++){
+		sweepSlice(&jobs[i]);
+	}
+	sweepSlice(&jobs[0]);
+	for(size_t i = 1; i < started; i++){
+		pthread_join(workers[i], NULL);
+	}
+	free(workers);
+}
+
+/*
+ * Whether one user ranks above another
+ *
+ * @param scores Every user's score
+ * @param a One user
+ * @param b The other user
+ * @return Whether a has the higher score, or the same score and a lower id
+ */
+static bool above(const double *scores, uint32_t a, uint32_t b){
+	return scores[a] > scores[b] || (scores[a] == scores[b] && a < b);
+}
+
+/*
+ * Restores a heap whose lowest-ranked user is on top after its top changed
+ *
+ * @param scores Every user's score
+ * @param heap The heap
+ * @param n The number of users in the heap
+ * @param i Where the changed user is
+ */
+static void siftDown(const double *scores, uint32_t *heap, size_t n, size_t i){
+	for(;;){
+		size_t low = i;
+		size_t left = 2 * i + 1;
+		size_t right = left + 1;
+		if(left < n && above(scores, heap[low], heap[left])){
+			low = left;
+		}
+		if(right < n && above(scores, heap[low], heap[right])){
+			low = right;
+		}
+		if(low == i){
+			return;
+		}
+		uint32_t swap = heap[i];
+		heap[i] = heap[low];
+		heap[low] = swap;
+		i = low;
+	}
+}
+
+Influence influence_create( void ){
+	Influence inf = (Influence)calloc(1, sizeof(struct Influence_t));
+	assert(inf != NULL);
+	return inf;
+}
+
+void influence_destroy( Influence inf ){
+	free(inf->scores);
+	free(inf);
+}
+
+void influence_clear( Influence inf ){
+	inf->users = 0;
+}
+
+void influence_add( Influence inf, uint32_t id ){
+	assert(id == inf->users);
+	if(inf->users == inf->capacity){ //Grow geometrically
+		inf->capacity = inf->capacity == 0 ? 64 : inf->capacity * 2;
+		inf->scores = (double *)realloc(inf->scores, inf->capacity * sizeof(double));
+		assert(inf->scores != NULL);
+	}
+	inf->scores[id] = 0;
+	inf->users++;
+}
+
+void influence_remove( Influence inf, uint32_t id ){
+	inf->users--;
+	if(id != inf->users){ //The last user takes the removed user's id
+		inf->scores[id] = inf->scores[inf->users];
+	}
+}
+
+size_t influence_run( Influence inf, const Csr g, size_t iterations, unsigned threads, double* change ){
+	assert(threads > 0 && csr_users(g) == inf->users);
+	size_t n = inf->users;
+	if(change != NULL){
+		*change = 0;
+	}
+	if(n == 0){
+		return 0;
+	}
+
+	//Start from the last scores, with new users at the average, adding up to 1
+	double *scores = (double *)malloc(n * sizeof(double));
+	double *shares = (double *)malloc(n * sizeof(double));
+	double *next = (double *)malloc(n * sizeof(double));
+	double *next_shares = (double *)malloc(n * sizeof(double));
+	assert(scores != NULL && shares != NULL && next != NULL && next_shares != NULL);
+	double sum = 0;
+	for(size_t u = 0; u < n; u++){
+		scores[u] = inf->scores[u] > 0 ? inf->scores[u] : 1.0 / (double)n;
+		sum += scores[u];
+	}
+	double stranded = 0;
+	for(size_t u = 0; u < n; u++){
+		scores[u] /= sum;
+		size_t degree = csr_degree(g, (uint32_t)u);
+		if(degree > 0){
+			shares[u] = scores[u] / (double)degree;
+		}
+		else{
+			shares[u] = 0;
+			stranded += scores[u];
+		}
+	}
+
+	//Give each thread about the same number of friends to gather
+	size_t slices = n < INFLUENCE_PARALLEL_USERS ? 1 : threads;
+	uint64_t links = 0;
+	for(size_t u = 0; u < n; u++){
+		links += csr_degree(g, (uint32_t)u);
+	}
+	sweep_t *jobs = (sweep_t *)calloc(slices, sizeof(sweep_t));
+	assert(jobs != NULL);
+	size_t u = 0;
+	uint64_t seen = 0;
+	for(size_t i = 0; i < slices; i++){
+		jobs[i].g = g;
+		jobs[i].begin = u;
+		uint64_t target = links * (i + 1) / slices;
+		while(u < n && (i + 1 == slices || seen < target)){
+			seen += csr_degree(g, (uint32_t)u);
+			u++;
+		}
+		jobs[i].end = u;
+	}
+
+	size_t done = 0;
+	double moved = 0;
+	while(done < iterations){
+		double base = (1.0 - INFLUENCE_DAMPING) / (double)n + INFLUENCE_DAMPING * stranded / (double)n;
+		for(size_t i = 0; i < slices; i++){
+			jobs[i].scores = scores;
+			jobs[i].shares = shares;
+			jobs[i].next = next;
+			jobs[i].next_shares = next_shares;
+			jobs[i].base = base;
+		}
+		runJobs(jobs, slices);
+		done++;
+
+		moved = 0;
+		stranded = 0;
+		for(size_t i = 0; i < slices; i++){
+			moved += jobs[i].change;
+			stranded += jobs[i].stranded;
+		}
+		double *swap = scores;
+		scores = next;
+		next = swap;
+		swap = shares;
+		shares = next_shares;
+		next_shares = swap;
+		if(moved < INFLUENCE_TOLERANCE){
+			break;
+		}
+	}
+
+	memcpy(inf->scores, scores, n * sizeof(double));
+	if(change != NULL){
+		*change = moved;
+	}
+	free(jobs);
+	free(scores);
+	free(shares);
+	free(next);
+	free(next_shares);
+	return done;
+}
+
+double influence_score( const Influence inf, uint32_t id ){
+	return inf->scores[id];
+}
+
+size_t influence_top( const Influence inf, size_t k, uint32_t* top ){
+	if(k > inf->users){
+		k = inf->users;
+	}
+	if(k == 0){
+		return 0;
+	}
+
+	//Keep the k best in a heap with the lowest-ranked of them on top
+	for(size_t i = 0; i < k; i++){
+		top[i] = (uint32_t)i;
+	}
+	for(size_t i = k / 2; i-- > 0; ){
+		siftDown(inf->scores, top, k, i);
+	}
+	for(size_t u = k; u < inf->users; u++){
+		if(above(inf->scores, (uint32_t)u, top[0])){
+			top[0] = (uint32_t)u;
+			siftDown(inf->scores, top, k, 0);
+		}
+	}
+
+	//Taking the lowest off the top each time fills the array from the back
+	for(size_t n = k; n > 1; n--){
+		uint32_t low = top[0];
+		top[0] = top[n - 1];
+		top[n - 1] = low;
+		siftDown(inf->scores, top, n - 1, 0);
+	}
+	return k;
+}
@@ -0,0 +1,127 @@
+/// @file influence.h
+/// @brief Influence scores (PageRank) over the friendship graph, kept
+/// between runs so a rerun starts from the last answer.
+///
+/// General Notes on influence Operation
+///
+/// - A user's influence is the chance that a walk which follows a random
+///   friendship with probability INFLUENCE_DAMPING, and jumps to a random
+///   user otherwise, is at that user.  Users without friends spread their
+///   share over everyone.  The scores of all users add up to 1.
+///
+/// - Each iteration reads the frozen graph: every user's new score is the
+///   sum of their friends' scores, each divided by that friend's number of
+///   friends.  The sum runs over one contiguous row of friend ids and is
+///   split over four running totals so the compiler can vectorize it.
+///
+/// - Users are split into one slice per thread with about the same number
+///   of friends, and each thread writes only its own users' scores.
+///   Graphs with fewer than INFLUENCE_PARALLEL_USERS users use one thread.
+///
+/// - Scores are kept after a run and the next run starts from them, with
+///   users added since then starting at the average, so a rerun after a few
+///   changes stops after a few iterations, once the scores change by less
+///   than INFLUENCE_TOLERANCE in total.
+///
+/// - User ids stay dense: removing a user hands the last user's id to the
+///   removed user's place, in constant time.
+///
+/// @author Bennett Moore bwm7637@rit.edu
+
+#ifndef INFLUENCE_H
+#define INFLUENCE_H
+
+#include <stddef.h>     // size_t
+#include <stdint.h>     // uint32_t
+
+#include "csr.h"
+
+/// Chance of following a friendship rather than jumping to a random user
+#define INFLUENCE_DAMPING 0.85
+
+/// A run stops once the scores change by less than this in total
+#define INFLUENCE_TOLERANCE 1e-6
+
+/// Default most iterations of a run
+#define INFLUENCE_ITERATIONS 100
+
+/// Default number of users influence lists
+#define INFLUENCE_TOP 10
+
+/// Graphs with this many users are scored by several threads
+#define INFLUENCE_PARALLEL_USERS 4096
+
+/// The Influence data type is a pointer to an opaque structure.
+typedef struct Influence_t * Influence;
+
+/// Create an empty set of scores.
+///
+/// @exception Assert fails if it cannot allocate space
+/// @return Scores with no users
+///
+Influence influence_create( void );
+
+/// Release a set of scores.
+///
+/// @param inf The scores
+/// @post inf is not a valid instance of influence.
+///
+void influence_destroy( Influence inf );
+
+/// Forget every user.
+///
+/// @param inf The scores
+///
+void influence_clear( Influence inf );
+
+/// Add a new user, who has no score until the next run.
+///
+/// @param inf The scores
+/// @param id The user's id
+/// @exception Assert fails if it cannot allocate space
+/// @pre id is the number of users in the scores.
+///
+void influence_add( Influence inf, uint32_t id );
+
+/// Forget a user, and give the user with the highest id the removed user's
+/// id.
+///
+/// @param inf The scores
+/// @param id The id of the user to forget
+///
+void influence_remove( Influence inf, uint32_t id );
+
+/// Score every user, starting from the last run's scores.
+///
+/// @param inf The scores
+/// @param g The frozen graph
+/// @param iterations The most iterations to run
+/// @param threads The most threads to use
+/// @param change Receives the total change of the scores in the last
+///        iteration, or NULL
+/// @exception Assert fails if it cannot allocate space
+/// @pre g has one user per id in inf, and threads is not 0.
+/// @return The number of iterations run
+///
+size_t influence_run( Influence inf, const Csr g, size_t iterations, unsigned threads, double* change );
+
+/// Get a user's score from the last run.
+///
+/// @param inf The scores
+/// @param id The user's id
+/// @return The user's score, or 0 if they were added since
+///
+double influence_score( const Influence inf, uint32_t id );
+
+/// Find the users with the highest scores.
+///
+/// @param inf The scores
+/// @param k The most users to find
+/// @param top Receives up to k ids, highest score first, lower id first
+///        among equal scores
+/// @return The number of ids written, the smaller of k and the number of
+///         users
+///
+size_t influence_top( const Influence inf, size_t k, uint32_t* top );
+
+#endif // INFLUENCE_H
@@ -0,0 +1,150 @@
+/*
+ * file: intersect.c
+ *
+ * Sorted id list intersection. The block merge compares a block of a
+ * against every rotation of a block of b, then advances whichever block
+ * has the smaller last id (or both, if they end on the same id).
+ *
+ * @author Bennett Moore bwm7637@rit.edu
+ */
+
+#include <stdlib.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "intersect.h"
+
+/*
+ * Compares two ids for qsort
+ *
+ * @param x The first id
+ * @param y The second id
+ * @return Negative, zero or positive as x is below, equal to or above y
+ */
+static int compareIds(const void *x, const void *y){
+	uint32_t a = *(const uint32_t *)x;
+	uint32_t b = *(const uint32_t *)y;
+	return (a > b) - (a < b);
+}
+
+/*
+ * Intersects a short list with a much longer one by galloping
+ *
+ * @param a The short list
+ * @param na The number of ids in a
+ * @param b The long list
+ * @param nb The number of ids in b
+ * @param out Receives the common ids, or NULL
+ * @return The number of common ids
+ */
+static size_t gallop(const uint32_t *a, size_t na, const uint32_t *b, size_t nb, uint32_t *out){
+	size_t n = 0;
+	size_t lo = 0;
+	for(size_t i = 0; i < na && lo < nb; i++){
+		//Find a bound past a[i], doubling the step each time
+		size_t step = 1;
+		size_t hi = lo;
+		while(hi < nb && b[hi] < a[i]){
+			lo = hi + 1;
+			hi += step;
+			step *= 2;
+		}
+		if(hi > nb){
+			hi = nb;
+		}
+
+		//Binary search (lo, hi] for a[i]
+		while(lo < hi){
+			size_t mid = lo + (hi - lo) / 2;
+			if(b[mid] < a[i]){
+				lo = mid + 1;
+			}
+			else{
+				hi = mid;
+			}
+		}
+		if(lo < nb && b[lo] == a[i]){
+			if(out != NULL){
+				out[n] = a[i];
+			}
+			n++;
+			lo++;
+		}
+	}
+	return n;
+}
+
+size_t intersect_sorted( const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* out ){
+	if(na > nb){ //Keep a as the shorter list
+		const uint32_t *swap = a;
+		a = b;
+		b = swap;
+		size_t count = na;
+		na = nb;
+		nb = count;
+	}
+	if(na == 0){
+		return 0;
+	}
+	if(nb / na >= INTERSECT_GALLOP_RATIO){
+		return gallop(a, na, b, nb, out);
+	}
+
+	size_t n = 0;
+	size_t i = 0;
+	size_t j = 0;
+#ifdef __SSE2__
+	while(i + 4 <= na && j + 4 <= nb){
+		__m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+		__m128i vb = _mm_loadu_si128((const __m128i *)(b + j));
+		__m128i hit = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi32(va, vb),
+				_mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1)))),
+			_mm_or_si128(_mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2))),
+				_mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(2, 1, 0, 3)))));
+		int mask = _mm_movemask_ps(_mm_castsi128_ps(hit));
+		if(out != NULL){
+			for(int k = 0; k < 4; k++){
+				if(mask & (1 << k)){
+					out[n + (size_t)__builtin_popcount((unsigned)mask & ((1u << k) - 1))] = a[i + (size_t)k];
+				}
+			}
+		}
+		n += (size_t)__builtin_popcount((unsigned)mask);
+
+		uint32_t a_last = a[i + 3];
+		uint32_t b_last = b[j + 3];
+		if(a_last <= b_last){
+			i += 4;
+		}
+		if(b_last <= a_last){
+			j += 4;
+		}
+	}
+#endif
+
+	//Merge whatever is left one id at a time
+	while(i < na && j < nb){
+		if(a[i] < b[j]){
+			i++;
+		}
+		else if(b[j] < a[i]){
+			j++;
+		}
+		else{
+			if(out != NULL){
+				out[n] = a[i];
+			}
+			n++;
+			i++;
+			j++;
+		}
+	}
+	return n;
+}
+
+void intersect_sort( uint32_t* ids, size_t count ){
+	qsort(ids, count, sizeof(uint32_t), compareIds);
+}
@@ -0,0 +1,39 @@
+/// @file intersect.h
+/// @brief Intersection of sorted lists of user ids.
+///
+/// Lists of similar length are merged a block of four ids against a block
+/// of four at a time (with SSE2 when available).  When one list is much
+/// longer than the other, each id of the short list is found in the long
+/// one by galloping (exponential then binary search) instead.
+///
+/// @author Bennett Moore bwm7637@rit.edu
+
+#ifndef INTERSECT_H
+#define INTERSECT_H
+
+#include <stddef.h>     // size_t
+#include <stdint.h>     // uint32_t
+
+/// Lists at least this many times longer than the other are galloped
+#define INTERSECT_GALLOP_RATIO 32
+
+/// Intersect two sorted lists of ids.
+///
+/// @param a The first list, strictly increasing
+/// @param na The number of ids in a
+/// @param b The second list, strictly increasing
+/// @param nb The number of ids in b
+/// @param out Receives the common ids in increasing order, or NULL to only
+///        count them; must have room for the shorter list's length
+/// @return The number of common ids
+///
+size_t intersect_sorted( const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint32_t* out );
+
+/// Sort a list of ids in place.
+///
+/// @param ids The list
+/// @param count The number of ids in the list
+///
+void intersect_sort( uint32_t* ids, size_t count );
+
+#endif // INTERSECT_H
@@ -0,0 +1,257 @@
+/*
+ * file: jobs.c
+ *
+ * Background jobs as forked children. Each job's results go to an unlinked
+ * temporary file the parent opened before forking, so the child never
+ * blocks on a reader and the parent reads the results only once the child
+ * has exited. The child ends the file with the time it finished, since the
+ * parent may not notice the exit until much later.
+ *
+ * @author Bennett Moore bwm7637@rit.edu
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "jobs.h"
+
+typedef struct job_s{
+	unsigned id;			// Number the job is known by
+	pid_t pid;			// The child running it
+	char *label;			// What it runs
+	FILE *result;			// Where the child writes its results, then the time it finished
+	long length;			// Bytes of results, once finished
+	uint64_t started;		// Monotonic nanoseconds when it was forked
+	uint64_t ended;			// When it finished, 0 while running
+	bool failed;			// Whether the child exited with an error or was killed
+	bool announced;			// Whether its finish was announced
+	struct job_s *next;		// The next newer job
+} job_t;
+
+struct Jobs_t{
+	pthread_mutex_t lock;		// Guards everything below
+	job_t *head;			// Oldest job first
+	unsigned next_id;		// Number of the next job
+};
+
+/*
+ * Reads the monotonic clock
+ *
+ * @return The time in nanoseconds
+ */
+static uint64_t now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ * Notes every job whose child has exited, without waiting for any
+ *
+ * @param j The jobs
+ * @pre j->lock is held
+ */
+static void reap(Jobs j){
+	for(job_t *job = j->head; job != NULL; job = job->next){
+		int status;
+		if(job->ended == 0 && waitpid(job->pid, &status, WNOHANG) == job->pid){
+			job->failed = !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS;
+			fseek(job->result, 0, SEEK_END);
+			job->length = ftell(job->result);
+			if(!job->failed && job->length >= (long)sizeof(uint64_t)){ //Split off the finishing time
+				job->length -= (long)sizeof(uint64_t);
+				fseek(job->result, job->length, SEEK_SET);
+				if(fread(&job->ended, sizeof(uint64_t), 1, job->result) != 1){
+					job->ended = 0;
+				}
+			}
+			if(job->ended == 0){ //Killed before it could say
+				job->ended = now();
+			}
+		}
+	}
+}
+
+/*
+ * Prints a finished job's results, then removes it from the list and
+ * releases it
+ *
+ * @param link The list pointer that points at the job
+ * @param out Where to print
+ * @pre the job has finished, and the jobs' lock is held
+ */
+static void collect(job_t **link, FILE *out){
+	job_t *job = *link;
+	double seconds = (double)(job->ended - job->started) / 1e9;
+	fprintf(out, "Job %u (%s) %s after %.3f s:\n", job->id, job->label, job->failed ? "failed" : "finished", seconds);
+
+	char buffer[BUFSIZ];
+	size_t left = job->length > 0 ? (size_t)job->length : 0;
+	rewind(job->result);
+	while(left > 0){
+		size_t length = fread(buffer, 1, left < sizeof(buffer) ? left : sizeof(buffer), job->result);
+		if(length == 0){
+			break;
+		}
+		fwrite(buffer, 1, length, out);
+		left -= length;
+	}
+
+	*link = job->next;
+	fclose(job->result);
+	free(job->label);
+	free(job);
+}
+
+Jobs jobs_create( void ){
+	Jobs j = (Jobs)calloc(1, sizeof(struct Jobs_t));
+	assert(j != NULL);
+	pthread_mutex_init(&j->lock, NULL);
+	j->next_id = 1;
+	return j;
+}
+
+void jobs_destroy( Jobs j ){
+	while(j->head != NULL){
+		job_t *job = j->head;
+		if(job->ended == 0){ //Nobody is left to collect the results
+			kill(job->pid, SIGKILL);
+			waitpid(job->pid, NULL, 0);
+		}
+		j->head = job->next;
+		fclose(job->result);
+		free(job->label);
+		free(job);
+	}
+	pthread_mutex_destroy(&j->lock);
+	free(j);
+}
+
+unsigned jobs_start( Jobs j, const char* label, void (*run)(FILE* out, void* arg), void* arg ){
+	FILE *result = tmpfile();
+	if(result == NULL){
+		return 0;
+	}
+
+	uint64_t started = now(); //Before the child can finish
+	pid_t pid = fork();
+	if(pid == 0){ //Skip exit handlers, which would flush the parent's buffered output a second time
+		run(result, arg);
+		uint64_t ended = now();
+		fwrite(&ended, sizeof(ended), 1, result);
+		_exit(fflush(result) == 0 && !ferror(result) ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+	if(pid < 0){
+		fclose(result);
+		return 0;
+	}
+
+	job_t *job = (job_t *)calloc(1, sizeof(job_t));
+	assert(job != NULL);
+	job->pid = pid;
+	job->label = strdup(label);
+	assert(job->label != NULL);
+	job->result = result;
+	job->started = started;
+
+	pthread_mutex_lock(&j->lock);
+	job->id = j->next_id++;
+	job_t **link = &j->head;
+	while(*link != NULL){ //Keep the list oldest first
+		link = &(*link)->next;
+	}
+	*link = job;
+	unsigned id = job->id;
+	pthread_mutex_unlock(&j->lock);
+	return id;
+}
+
+size_t jobs_running( Jobs j ){
+	size_t running = 0;
+	pthread_mutex_lock(&j->lock);
+	reap(j);
+	for(job_t *job = j->head; job != NULL; job = job->next){
+		if(job->ended == 0){
+			running++;
+		}
+	}
+	pthread_mutex_unlock(&j->lock);
+	return running;
+}
+
+void jobs_list( Jobs j, FILE* out ){
+	pthread_mutex_lock(&j->lock);
+	reap(j);
+	if(j->head == NULL){
+		fprintf(out, "No jobs\n");
+	}
+	uint64_t time = now();
+	for(job_t *job = j->head; job != NULL; job = job->next){
+		if(job->ended == 0){
+			fprintf(out, "Job %u (%s) running for %.3f s\n", job->id, job->label, (double)(time - job->started) / 1e9);
+		}
+		else{
+			fprintf(out, "Job %u (%s) %s after %.3f s\n", job->id, job->label, job->failed ? "failed" : "finished",
+				(double)(job->ended - job->started) / 1e9);
+		}
+	}
+	pthread_mutex_unlock(&j->lock);
+}
+
+job_state_t jobs_collect( Jobs j, unsigned id, FILE* out ){
+	job_state_t state = JOB_UNKNOWN;
+	pthread_mutex_lock(&j->lock);
+	reap(j);
+	for(job_t **link = &j->head; *link != NULL; link = &(*link)->next){
+		if((*link)->id == id){
+			state = (*link)->ended == 0 ? JOB_RUNNING : JOB_DONE;
+			if(state == JOB_DONE){
+				collect(link, out);
+			}
+			break;
+		}
+	}
+	pthread_mutex_unlock(&j->lock);
+	return state;
+}
+
+size_t jobs_collect_all( Jobs j, FILE* out ){
+	size_t collected = 0;
+	pthread_mutex_lock(&j->lock);
+	reap(j);
+	job_t **link = &j->head;
+	while(*link != NULL){
+		if((*link)->ended != 0){ //collect unlinks the job, so link already points at the next one
+			collect(link, out);
+			collected++;
+		}
+		else{
+			link = &(*link)->next;
+		}
+	}
+	pthread_mutex_unlock(&j->lock);
+	return collected;
+}
+
+void jobs_announce( Jobs j, FILE* out ){
+	pthread_mutex_lock(&j->lock);
+	reap(j);
+	for(job_t *job = j->head; job != NULL; job = job->next){
+		if(job->ended != 0 && !job->announced){
+			fprintf(out, "Job %u (%s) %s; poll %u for its results\n", job->id, job->label,
+				job->failed ? "failed" : "finished", job->id);
+			job->announced = true;
+		}
+	}
+	pthread_mutex_unlock(&j->lock);
+}
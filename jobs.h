@@ -0,0 +1,106 @@
+/// @file jobs.h
+/// @brief Read-only commands run in the background, each in a forked copy
+/// of the process.
+///
+/// General Notes on jobs Operation
+///
+/// - Starting a job forks the process.  The child sees the network exactly
+///   as it was at the fork, however the parent changes it afterwards, since
+///   the two share memory pages only until one of them writes to a page.
+///   The parent goes straight back to its commands.
+///
+/// - The child writes its results to an unnamed temporary file and exits;
+///   the parent finds finished jobs without waiting for them, whenever jobs
+///   are listed, polled or announced.
+///
+/// - A finished job's results are kept until they are collected once; the
+///   job is forgotten then.  Jobs still running when the set is destroyed
+///   are killed.
+///
+/// - Every function may be called from several threads at once.
+///
+/// @author Bennett Moore bwm7637@rit.edu
+
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <stdbool.h>    // bool
+#include <stddef.h>     // size_t
+#include <stdio.h>      // FILE
+
+/// Outcome of looking for a job's results
+typedef enum job_state_e{
+	JOB_UNKNOWN,		// No such job
+	JOB_RUNNING,		// Not finished yet
+	JOB_DONE		// Finished; its results were written out
+} job_state_t;
+
+/// The Jobs data type is a pointer to an opaque structure.
+typedef struct Jobs_t * Jobs;
+
+/// Create an empty set of jobs.
+///
+/// @exception Assert fails if it cannot allocate space
+/// @return A set with no jobs
+///
+Jobs jobs_create( void );
+
+/// Kill every running job and release the set.
+///
+/// @param j The jobs
+/// @post j is not a valid instance of jobs.
+///
+void jobs_destroy( Jobs j );
+
+/// Run a function in a forked copy of the process.
+///
+/// @param j The jobs
+/// @param label What the job runs, shown when it is listed
+/// @param run Called in the child with the stream its results go to
+/// @param arg Passed to run
+/// @exception Assert fails if it cannot allocate space
+/// @pre Nothing the child reads is halfway through a change on another
+///      thread.
+/// @return The new job's number, or 0 if the process could not fork
+///
+unsigned jobs_start( Jobs j, const char* label, void (*run)(FILE* out, void* arg), void* arg );
+
+/// Count the jobs still running.
+///
+/// @param j The jobs
+/// @return The number of children that have not exited
+///
+size_t jobs_running( Jobs j );
+
+/// Print one line for every job: running for how long, or finished.
+///
+/// @param j The jobs
+/// @param out Where to print
+///
+void jobs_list( Jobs j, FILE* out );
+
+/// Print a finished job's results and forget the job.
+///
+/// @param j The jobs
+/// @param id The job's number
+/// @param out Where to print
+/// @return Whether the job was unknown, still running, or done
+///
+job_state_t jobs_collect( Jobs j, unsigned id, FILE* out );
+
+/// Print the results of every finished job and forget them.
+///
+/// @param j The jobs
+/// @param out Where to print
+/// @return The number of jobs collected
+///
+size_t jobs_collect_all( Jobs j, FILE* out );
+
+/// Print a line for each job that has finished since it was last announced.
+///
+/// @param j The jobs
+/// @param out Where to print
+///
+void jobs_announce( Jobs j, FILE* out );
+
+#endif // JOBS_H
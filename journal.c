@@ -0,0 +1,319 @@
+/*
+ * file: journal.c
+ *
+ * Write-ahead journal. The file is a short header followed by records of
+ * the form (body length, body checksum, body), where the body is an
+ * operation byte followed by NUL terminated arguments.
+ *
+ * @author Bennett Moore bwm7637@rit.edu
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "journal.h"
+
+#define BYTE_ORDER_MARK 0x01020304u	// Rejects files from other-endian machines
+#define MAX_ARGS 3			// Most arguments any record has
+
+typedef struct header_s{
+	char magic[8];			// JOURNAL_MAGIC, not NUL terminated
+	uint32_t version;		// JOURNAL_VERSION
+	uint32_t byte_order;		// BYTE_ORDER_MARK
+} header_t;
+
+typedef struct record_s{
+	uint32_t length;		// Bytes in the body that follows
+	uint32_t checksum;		// Checksum of the body
+} record_t;
+
+struct Journal_t{
+	int fd;				// Journal file, opened for appending
+	char *buf;			// Records not yet written
+	size_t len;			// Bytes in buf
+	size_t capacity;		// Size of buf
+	size_t pending;			// Records not yet synced
+	size_t group;			// Records per group commit
+	unsigned interval;		// Longest wait before a sync, in milliseconds
+	struct timespec oldest;		// When the oldest unsynced record was added
+	bool failed;			// Whether any write has failed
+	pthread_mutex_t lock;		// Held by every public function but open
+};
+
+/*
+ * Gets the number of arguments a record has
+ *
+ * @param op The kind of record
+ * @return The number of arguments, or -1 if op is not a known kind
+ */
+static int argCount(int op){
+	switch(op){
+		case JOURNAL_ADD: return 3;
+		case JOURNAL_FRIEND: return 2;
+		case JOURNAL_UNFRIEND: return 2;
+		case JOURNAL_INIT: return 0;
+		case JOURNAL_REMOVE: return 1;
+		default: return -1;
+	}
+}
+
+/*
+ * Checksums a record body
+ *
+ * @param body The body
+ * @param len The number of bytes in body
+ * @return A 32-bit FNV-1a hash of body
+ */
+static uint32_t checksum(const char *body, size_t len){
+	uint32_t h = 0x811c9dc5u;
+	for(size_t i = 0; i < len; i++){
+		h = (h ^ (unsigned char)body[i]) * 0x01000193u;
+	}
+	return h;
+}
+
+/*
+ * Writes a whole buffer, retrying short or interrupted writes
+ *
+ * @param fd The file
+ * @param data The bytes to write
+ * @param len The number of bytes
+ * @return Whether every byte was written
+ */
+static bool writeAll(int fd, const char *data, size_t len){
+	while(len > 0){
+		ssize_t n = write(fd, data, len);
+		if(n < 0 && errno == EINTR){
+			continue;
+		}
+		if(n <= 0){
+			return false;
+		}
+		data += n;
+		len -= (size_t)n;
+	}
+	return true;
+}
+
+/*
+ * Gets the milliseconds elapsed since a point in time
+ *
+ * @param since The earlier time
+ * @return The milliseconds from since until now
+ */
+static long elapsedMs(const struct timespec *since){
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - since->tv_sec) * 1000L + (now.tv_nsec - since->tv_nsec) / 1000000L;
+}
+
+/*
+ * Replays the records of a journal file
+ *
+ * @param fd The journal file
+ * @param size The size of the file
+ * @param apply The record callback
+ * @param replayed Receives the number of records replayed
+ * @return The length of the valid part of the file, or 0 if it is not a journal
+ */
+static size_t replay(int fd, size_t size, void (*apply)(journal_op_t op, char **args), size_t *replayed){
+	char *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	if(map == MAP_FAILED){
+		return 0;
+	}
+	posix_madvise(map, size, POSIX_MADV_SEQUENTIAL);
+
+	header_t h;
+	memcpy(&h, map, sizeof(h));
+	if(memcmp(h.magic, JOURNAL_MAGIC, sizeof(h.magic)) != 0 || h.version != JOURNAL_VERSION
+			|| h.byte_order != BYTE_ORDER_MARK){
+		munmap(map, size);
+		return 0;
+	}
+
+	size_t off = sizeof(header_t);
+	while(off + sizeof(record_t) <= size){
+		record_t r;
+		memcpy(&r, map + off, sizeof(r));
+		char *body = map + off + sizeof(record_t);
+		if(r.length == 0 || r.length > size - off - sizeof(record_t)
+				|| checksum(body, r.length) != r.checksum){
+			break; //Torn or damaged tail
+		}
+
+		//Split the arguments, which must exactly fill the body
+		int nargs = argCount((unsigned char)body[0]);
+		char *args[MAX_ARGS];
+		int found = 0;
+		char *c = body + 1;
+		while(nargs > 0 && found < nargs && c < body + r.length){
+			args[found++] = c;
+			c += strnlen(c, (size_t)(body + r.length - c)) + 1;
+		}
+		if(nargs < 0 || found != nargs || c != body + r.length){
+			break;
+		}
+
+		apply((journal_op_t)body[0], args);
+		(*replayed)++;
+		off += sizeof(record_t) + r.length;
+	}
+
+	munmap(map, size);
+	return off;
+}
+
+Journal journal_open( const char* path, size_t group, unsigned interval,
+                      void (*apply)(journal_op_t op, char** args), size_t* replayed ){
+	assert(group != 0);
+	*replayed = 0;
+	int fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+	if(fd < 0){
+		return NULL;
+	}
+	struct stat st;
+	if(fstat(fd, &st) != 0){
+		close(fd);
+		return NULL;
+	}
+
+	if(st.st_size == 0){ //New journal
+		header_t h;
+		memset(&h, 0, sizeof(h));
+		memcpy(h.magic, JOURNAL_MAGIC, sizeof(h.magic));
+		h.version = JOURNAL_VERSION;
+		h.byte_order = BYTE_ORDER_MARK;
+		if(!writeAll(fd, (const char *)&h, sizeof(h)) || fdatasync(fd) != 0){
+			close(fd);
+			return NULL;
+		}
+	}
+	else{
+		size_t valid = 0;
+		if((size_t)st.st_size >= sizeof(header_t)){
+			valid = replay(fd, (size_t)st.st_size, apply, replayed);
+		}
+		if(valid == 0){ //Not a journal; leave it alone
+			close(fd);
+			return NULL;
+		}
+		if(valid < (size_t)st.st_size && (ftruncate(fd, (off_t)valid) != 0 || fdatasync(fd) != 0)){
+			close(fd);
+			return NULL;
+		}
+	}
+
+	Journal j = (Journal)calloc(1, sizeof(struct Journal_t));
+	assert(j != NULL);
+	j->fd = fd;
+	j->capacity = JOURNAL_BUFFER;
+	j->buf = (char *)malloc(j->capacity);
+	assert(j->buf != NULL);
+	j->group = group;
+	j->interval = interval;
+	pthread_mutex_init(&j->lock, NULL);
+	return j;
+}
+
+/*
+ * Writes and syncs the buffered records, with the journal's mutex held
+ *
+ * @param j The journal
+ * @return Whether every write so far has succeeded
+ */
+static bool flush(Journal j){
+	if(j->pending == 0 && j->len == 0){
+		return !j->failed;
+	}
+	if(!j->failed && (!writeAll(j->fd, j->buf, j->len) || fdatasync(j->fd) != 0)){
+		j->failed = true;
+	}
+	j->len = 0;
+	j->pending = 0;
+	return !j->failed;
+}
+
+bool journal_append( Journal j, journal_op_t op, char** args ){
+	int nargs = argCount(op);
+	assert(nargs >= 0);
+	size_t body = 1;
+	for(int i = 0; i < nargs; i++){
+		body += strlen(args[i]) + 1;
+	}
+
+	size_t need = sizeof(record_t) + body;
+	pthread_mutex_lock(&j->lock);
+	if(j->len + need > j->capacity){
+		if(!j->failed && !writeAll(j->fd, j->buf, j->len)){
+			j->failed = true;
+		}
+		j->len = 0;
+		while(need > j->capacity){ //Record bigger than the whole buffer
+			j->capacity *= 2;
+			j->buf = (char *)realloc(j->buf, j->capacity);
+			assert(j->buf != NULL);
+		}
+	}
+
+	//Build the body in place, then checksum it
+	char *start = j->buf + j->len + sizeof(record_t);
+	char *c = start;
+	*c++ = (char)op;
+	for(int i = 0; i < nargs; i++){
+		size_t len = strlen(args[i]) + 1;
+		memcpy(c, args[i], len);
+		c += len;
+	}
+	record_t r = {(uint32_t)body, checksum(start, body)};
+	memcpy(j->buf + j->len, &r, sizeof(r));
+	j->len += need;
+
+	if(j->pending++ == 0){
+		clock_gettime(CLOCK_MONOTONIC, &j->oldest);
+	}
+	bool ok = !j->failed;
+	if(j->pending >= j->group || elapsedMs(&j->oldest) >= (long)j->interval){
+		ok = flush(j);
+	}
+	pthread_mutex_unlock(&j->lock);
+	return ok;
+}
+
+bool journal_sync( Journal j ){
+	pthread_mutex_lock(&j->lock);
+	bool ok = flush(j);
+	pthread_mutex_unlock(&j->lock);
+	return ok;
+}
+
+bool journal_truncate( Journal j ){
+	pthread_mutex_lock(&j->lock);
+	j->len = 0;
+	j->pending = 0;
+	bool ok = ftruncate(j->fd, (off_t)sizeof(header_t)) == 0 && fdatasync(j->fd) == 0;
+	if(ok){
+		j->failed = false;
+	}
+	pthread_mutex_unlock(&j->lock);
+	return ok;
+}
+
+bool journal_close( Journal j ){
+	bool ok = journal_sync(j);
+	ok = close(j->fd) == 0 && ok;
+	pthread_mutex_destroy(&j->lock);
+	free(j->buf);
+	free(j);
+	return ok;
+}
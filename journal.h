@@ -0,0 +1,111 @@
+/// @file journal.h
+/// @brief An append-only write-ahead journal of network changes.
+///
+/// Every successful add, friend, unfriend, remove and init is appended to the
+/// journal as a small binary record, so the network can be rebuilt after a
+/// crash by replaying the journal on top of the last snapshot.
+///
+/// General Notes on journal Operation
+///
+/// - Records are buffered and written with group commit: the buffer is
+///   written and synced to disk once it holds the configured number of
+///   records, once the oldest unsynced record is older than the configured
+///   interval, or when journal_sync() is called.  A crash can lose at most
+///   the records of the current group.
+///
+/// - Each record carries a checksum.  Replay stops at the first incomplete
+///   or damaged record and cuts the file off there, so a write torn by a
+///   crash is discarded rather than misread.
+///
+/// - Only successful changes are recorded.  Replaying a record whose
+///   effect is already present does nothing, so replaying a journal over a
+///   snapshot that already contains some of its records is safe.
+///
+/// - Several threads may append to and sync the same journal at once;
+///   records from different threads are never interleaved.
+///
+/// @author Bennett Moore bwm7637@rit.edu
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdbool.h>    // bool
+#include <stddef.h>     // size_t
+
+/// Identifies a journal file
+#define JOURNAL_MAGIC "AMICIJNL"
+
+/// Current journal format version
+#define JOURNAL_VERSION 1
+
+/// Default number of records per group commit
+#define JOURNAL_GROUP 1024
+
+/// Default longest time, in milliseconds, a record may wait to be synced
+#define JOURNAL_INTERVAL 100
+
+/// Size of the in-memory record buffer
+#define JOURNAL_BUFFER (1024 * 1024)
+
+/// The kinds of change stored in a journal
+typedef enum{
+	JOURNAL_ADD = 1,	// args: first name, last name, handle
+	JOURNAL_FRIEND,		// args: handle1, handle2
+	JOURNAL_UNFRIEND,	// args: handle1, handle2
+	JOURNAL_INIT,		// no args
+	JOURNAL_REMOVE,		// args: handle
+} journal_op_t;
+
+/// The Journal data type is a pointer to an opaque structure.
+typedef struct Journal_t * Journal;
+
+/// Open a journal, replaying any records it already holds, and prepare it
+/// for appending.  The file is created if it does not exist.
+///
+/// @param path The journal file
+/// @param group The number of records per group commit
+/// @param interval The longest time in milliseconds a record may wait to
+///        be synced
+/// @param apply Called with each replayed record, in order
+/// @param replayed Receives the number of records replayed
+/// @exception Assert fails if it cannot allocate space
+/// @pre group is not 0.
+/// @return The open journal, or NULL if the file cannot be read or written
+///         or is not a journal
+///
+Journal journal_open( const char* path, size_t group, unsigned interval,
+                      void (*apply)(journal_op_t op, char** args), size_t* replayed );
+
+/// Append a record, writing and syncing the current group if it is due.
+///
+/// @param j The journal
+/// @param op The kind of change
+/// @param args The handles and names the change was made with
+/// @pre args holds as many strings as op needs.
+/// @return Whether every write so far has succeeded
+///
+bool journal_append( Journal j, journal_op_t op, char** args );
+
+/// Write and sync every buffered record.
+///
+/// @param j The journal
+/// @return Whether every write so far has succeeded
+///
+bool journal_sync( Journal j );
+
+/// Discard every record, after the network has been saved elsewhere.
+///
+/// @param j The journal
+/// @return Whether the journal was emptied
+///
+bool journal_truncate( Journal j );
+
+/// Sync and close a journal.
+///
+/// @param j The journal
+/// @post j is not a valid instance of journal.
+/// @return Whether every write succeeded
+///
+bool journal_close( Journal j );
+
+#endif // JOURNAL_H
@@ -0,0 +1,109 @@
+/*
+ * file: locks.c
+ *
+ * Structure lock plus striped user locks. Each user lock sits on its own
+ * cache line so threads working on neighbouring stripes do not slow each
+ * other down.
+ *
+ * @author Bennett Moore bwm7637@rit.edu
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "locks.h"
+
+#define STRIPE_SHIFT 22			// 32 - log2(LOCKS_STRIPES)
+
+typedef union stripe_u{
+	pthread_rwlock_t lock;
+	char pad[64];			// One lock per cache line
+} stripe_t;
+
+struct Locks_t{
+	pthread_rwlock_t structure;
+	_Alignas(64) stripe_t stripes[LOCKS_STRIPES];
+};
+
+/*
+ * Gets the stripe a user's lock lives in
+ *
+ * @param id The user's id
+ * @return The stripe index
+ */
+static inline uint32_t stripeOf(uint32_t id){
+	return (id * 0x9e3779b1u) >> STRIPE_SHIFT; //Top bits, so neighbouring ids spread out
+}
+
+Locks locks_create( void ){
+	Locks l = (Locks)aligned_alloc(64, sizeof(struct Locks_t));
+	assert(l != NULL);
+	int failed = pthread_rwlock_init(&l->structure, NULL);
+	for(size_t i = 0; i < LOCKS_STRIPES; i++){
+		failed |= pthread_rwlock_init(&l->stripes[i].lock, NULL);
+	}
+	assert(failed == 0);
+	(void)failed;
+	return l;
+}
+
+void locks_destroy( Locks l ){
+	pthread_rwlock_destroy(&l->structure);
+	for(size_t i = 0; i < LOCKS_STRIPES; i++){
+		pthread_rwlock_destroy(&l->stripes[i].lock);
+	}
+	free(l);
+}
+
+void locks_structure( Locks l, bool exclusive ){
+	if(exclusive){
+		pthread_rwlock_wrlock(&l->structure);
+	}
+	else{
+		pthread_rwlock_rdlock(&l->structure);
+	}
+}
+
+void locks_release_structure( Locks l ){
+	pthread_rwlock_unlock(&l->structure);
+}
+
+void locks_user( Locks l, uint32_t id, bool exclusive ){
+	pthread_rwlock_t *lock = &l->stripes[stripeOf(id)].lock;
+	if(exclusive){
+		pthread_rwlock_wrlock(lock);
+	}
+	else{
+		pthread_rwlock_rdlock(lock);
+	}
+}
+
+void locks_release_user( Locks l, uint32_t id ){
+	pthread_rwlock_unlock(&l->stripes[stripeOf(id)].lock);
+}
+
+void locks_pair( Locks l, uint32_t a, uint32_t b ){
+	uint32_t first = stripeOf(a);
+	uint32_t second = stripeOf(b);
+	if(first > second){ //Always lock the lower stripe first
+		uint32_t swap = first;
+		first = second;
+		second = swap;
+	}
+	pthread_rwlock_wrlock(&l->stripes[first].lock);
+	if(second != first){
+		pthread_rwlock_wrlock(&l->stripes[second].lock);
+	}
+}
+
+void locks_release_pair( Locks l, uint32_t a, uint32_t b ){
+	uint32_t first = stripeOf(a);
+	uint32_t second = stripeOf(b);
+	pthread_rwlock_unlock(&l->stripes[first].lock);
+	if(second != first){
+		pthread_rwlock_unlock(&l->stripes[second].lock);
+	}
+}
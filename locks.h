@@ -0,0 +1,96 @@
+/// @file locks.h
+/// @brief Reader-writer locks that let many threads use the network at once.
+///
+/// General Notes on locks Operation
+///
+/// - One structure lock guards everything that moves when the network
+///   changes shape: the handle table, the user directory and the frozen
+///   graph.  Commands that only look users up, or that change friendships,
+///   hold it shared, so any number of them run side by side; adding users,
+///   clearing or loading the network and freezing it hold it exclusively.
+///
+/// - Each user's friend list is guarded by one of LOCKS_STRIPES user locks,
+///   chosen by user id, so the locks take a fixed amount of memory however
+///   many users there are.  Readers of a friend list hold its lock shared;
+///   a change to a friendship holds both users' locks exclusively.
+///
+/// - To avoid deadlock, the structure lock is always taken before any user
+///   lock, and locks_pair() takes two user locks in stripe order.
+///
+/// @author Bennett Moore bwm7637@rit.edu
+
+#ifndef LOCKS_H
+#define LOCKS_H
+
+#include <stdbool.h>    // bool
+#include <stdint.h>     // uint32_t
+
+/// Number of user locks, a power of two
+#define LOCKS_STRIPES 1024
+
+/// The Locks data type is a pointer to an opaque structure.
+typedef struct Locks_t * Locks;
+
+/// Create a set of unlocked locks.
+///
+/// @exception Assert fails if it cannot allocate space
+/// @return The locks
+///
+Locks locks_create( void );
+
+/// Release a set of locks.
+///
+/// @param l The locks
+/// @pre No lock in l is held.
+/// @post l is not a valid instance of locks.
+///
+void locks_destroy( Locks l );
+
+/// Hold the structure lock shared or exclusively.
+///
+/// @param l The locks
+/// @param exclusive Whether no other thread may hold the lock
+///
+void locks_structure( Locks l, bool exclusive );
+
+/// Release the structure lock.
+///
+/// @param l The locks
+/// @pre The calling thread holds the structure lock.
+///
+void locks_release_structure( Locks l );
+
+/// Hold the lock on one user's friend list.
+///
+/// @param l The locks
+/// @param id The user's id
+/// @param exclusive Whether no other thread may hold the lock
+/// @pre The calling thread holds the structure lock.
+///
+void locks_user( Locks l, uint32_t id, bool exclusive );
+
+/// Release the lock on one user's friend list.
+///
+/// @param l The locks
+/// @param id The user's id
+///
+void locks_release_user( Locks l, uint32_t id );
+
+/// Hold the locks on two users' friend lists exclusively.
+///
+/// @param l The locks
+/// @param a The id of one user
+/// @param b The id of the other user
+/// @pre The calling thread holds the structure lock.
+///
+void locks_pair( Locks l, uint32_t a, uint32_t b );
+
+/// Release the locks on two users' friend lists.
+///
+/// @param l The locks
+/// @param a The id of one user
+/// @param b The id of the other user
+///
+void locks_release_pair( Locks l, uint32_t a, uint32_t b );
+
+#endif // LOCKS_H
@@ -0,0 +1,465 @@
+/*
+ * file: names.c
+ *
+ * Name index. Distinct names and (last, first) pairs each live in a growing
+ * array, found through an open-addressing table of array positions, and
+ * each holds growing lists of user ids. Each user remembers where they sit
+ * in their three lists, so removing them is a swap with each list's last id.
+ *
+ * @author Bennett Moore bwm7637@rit.edu
+ */
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "names.h"
+
+#define INITIAL_SLOTS 64	// Initial table size, a power of two
+#define NO_NAME UINT32_MAX	// Marks an empty table slot
+#define MIN_RECENT 64		// Recent names always allowed before a merge
+
+typedef struct ids_s{
+	uint32_t *ids;			// User ids, in the order they were added until a removal
+	uint32_t count;			// Number of ids
+	uint32_t capacity;		// Room in ids
+} ids_t;
+
+typedef struct name_s{
+	const char *str;		// The name, owned by the network's arena
+	size_t hash;			// Hash of str
+	ids_t as_first;			// Users with this first name
+	ids_t as_last;			// Users with this last name
+} name_t;
+
+typedef struct pair_s{
+	uint32_t last;			// Number of the last name
+	uint32_t first;			// Number of the first name
+	ids_t ids;			// Users with both names
+} pair_t;
+
+typedef struct entry_s{
+	uint32_t first;			// Number of the first name
+	uint32_t last;			// Number of the last name
+	uint32_t pair;			// Number of the pair
+	uint32_t at[3];			// Place in the first name, last name and pair lists
+} entry_t;
+
+struct Names_t{
+	name_t *names;			// Distinct names, numbered by first use
+	uint32_t *sorted;		// Older name numbers in alphabetical order
+	size_t sorted_count;		// Number of names in sorted
+	uint32_t *recent;		// Newer name numbers in alphabetical order
+	size_t recent_count;		// Number of names in recent
+	size_t count;			// Number of names
+	size_t capacity;		// Room in names, sorted and recent
+	uint32_t *name_slots;		// Hash table of name numbers
+	size_t name_mask;		// Number of name slots minus one
+	pair_t *pairs;			// Distinct (last, first) pairs
+	size_t pair_count;		// Number of pairs
+	size_t pair_capacity;		// Room in pairs
+	uint32_t *pair_slots;		// Hash table of pair numbers
+	size_t pair_mask;		// Number of pair slots minus one
+	entry_t *entries;		// Each user's names and places, indexed by id
+	size_t users;			// Number of users
+	size_t user_capacity;		// Room in entries
+};
+
+/*
+ * Hashes a name
+ *
+ * @param str The name
+ * @return A well-mixed hash of the name
+ */
+static size_t hashName(const char *str){
+	uint64_t h = 0xcbf29ce484222325ULL;
+	for(const unsigned char *c = (const unsigned char *)str; *c != '\0'; c++){
+		h = (h ^ *c) * 0x100000001b3ULL;
+	}
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	return (size_t)h;
+}
+
+/*
+ * Hashes a pair of name numbers
+ *
+ * @param last The number of the last name
+ * @param first The number of the first name
+ * @return A well-mixed hash of the pair
+ */
+static size_t hashPair(uint32_t last, uint32_t first){
+	uint64_t h = ((uint64_t)last << 32 | first) * 0x9e3779b97f4a7c15ULL;
+	return (size_t)(h ^ h >> 29);
+}
+
+/*
+ * Allocates a hash table of empty slots
+ *
+ * @param size The number of slots, a power of two
+ * @return The slots
+ */
+static uint32_t *emptySlots(size_t size){
+	uint32_t *slots = (uint32_t *)malloc(size * sizeof(uint32_t));
+	assert(slots != NULL);
+	memset(slots, 0xff, size * sizeof(uint32_t)); //Every slot NO_NAME
+	return slots;
+}
+
+/*
+ * Appends an id to a list
+ *
+ * @param list The list
+ * @param id The id
+ */
+static void pushId(ids_t *list, uint32_t id){
+	if(list->count == list->capacity){
+		list->capacity = list->capacity == 0 ? 4 : list->capacity * 2;
+		list->ids = (uint32_t *)realloc(list->ids, list->capacity * sizeof(uint32_t));
+		assert(list->ids != NULL);
+	}
+	list->ids[list->count++] = id;
+}
+
+/*
+ * Gets one of the three lists a user is in
+ *
+ * @param n The index
+ * @param e The user's entry
+ * @param which 0 for the first name list, 1 for the last name list, 2 for the pair list
+ * @return The list
+ */
+static ids_t *listOf(Names n, const entry_t *e, int which){
+	switch(which){
+	case 0:
+		return &n->names[e->first].as_first;
+	case 1:
+		return &n->names[e->last].as_last;
+	default:
+		return &n->pairs[e->pair].ids;
+	}
+}
+
+/*
+ * Finds where a name belongs in an alphabetical list of name numbers
+ *
+ * @param n The index
+ * @param list The list
+ * @param length The number of entries in list
+ * @param str The name
+ * @return The position of the first entry not before str
+ */
+static size_t lowerBound(const Names n, const uint32_t *list, size_t length, const char *str){
+	size_t lo = 0;
+	size_t hi = length;
+	while(lo < hi){
+		size_t mid = lo + (hi - lo) / 2;
+		if(strcmp(n->names[list[mid]].str, str) < 0){
+			lo = mid + 1;
+		}
+		else{
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+/*
+ * Merges the recent names into the sorted ones
+ *
+ * @param n The index
+ */
+static void mergeRecent(Names n){
+	//Merge from the back so sorted can hold the result in place
+	size_t i = n->sorted_count;
+	size_t j = n->recent_count;
+	size_t k = i + j;
+	while(j > 0){
+		if(i > 0 && strcmp(n->names[n->sorted[i - 1]].str, n->names[n->recent[j - 1]].str) > 0){
+			n->sorted[--k] = n->sorted[--i];
+		}
+		else{
+			n->sorted[--k] = n->recent[--j];
+		}
+	}
+	n->sorted_count += n->recent_count;
+	n->recent_count = 0;
+}
+
+/*
+ * Finds the number of a name
+ *
+ * @param n The index
+ * @param str The name
+ * @param hash The hash of str
+ * @return The slot holding the name's number, or the empty slot where it belongs
+ */
+static size_t findName(const Names n, const char *str, size_t hash){
+	size_t i = hash & n->name_mask;
+	while(n->name_slots[i] != NO_NAME){
+		const name_t *name = &n->names[n->name_slots[i]];
+		if(name->hash == hash && (name->str == str || strcmp(name->str, str) == 0)){
+			break;
+		}
+		i = (i + 1) & n->name_mask;
+	}
+	return i;
+}
+
+/*
+ * Finds the number of a pair of names
+ *
+ * @param n The index
+ * @param last The number of the last name
+ * @param first The number of the first name
+ * @return The slot holding the pair's number, or the empty slot where it belongs
+ */
+static size_t findPair(const Names n, uint32_t last, uint32_t first){
+	size_t i = hashPair(last, first) & n->pair_mask;
+	while(n->pair_slots[i] != NO_NAME){
+		const pair_t *pair = &n->pairs[n->pair_slots[i]];
+		if(pair->last == last && pair->first == first){
+			break;
+		}
+		i = (i + 1) & n->pair_mask;
+	}
+	return i;
+}
+
+/*
+ * Gets the number of a name, numbering it if it is new
+ *
+ * @param n The index
+ * @param str The name, which lives as long as the index's users
+ * @return The name's number
+ */
+static uint32_t nameNumber(Names n, const char *str){
+	size_t hash = hashName(str);
+	size_t i = findName(n, str, hash);
+	if(n->name_slots[i] != NO_NAME){
+		return n->name_slots[i];
+	}
+
+	if(n->count == n->capacity){
+		n->capacity = n->capacity == 0 ? INITIAL_SLOTS : n->capacity * 2;
+		n->names = (name_t *)realloc(n->names, n->capacity * sizeof(name_t));
+		n->sorted = (uint32_t *)realloc(n->sorted, n->capacity * sizeof(uint32_t));
+		n->recent = (uint32_t *)realloc(n->recent, n->capacity * sizeof(uint32_t));
+		assert(n->names != NULL && n->sorted != NULL && n->recent != NULL);
+	}
+	uint32_t number = (uint32_t)n->count++;
+	name_t *name = &n->names[number];
+	memset(name, 0, sizeof(name_t));
+	name->str = str;
+	name->hash = hash;
+	n->name_slots[i] = number;
+
+	//Insert into the short recent list, and fold it into the long one once
+	//it outgrows eight times the square root of the long one's length; the
+	//moves within recent are cheap next to a merge's string compares
+	size_t lo = lowerBound(n, n->recent, n->recent_count, str);
+	memmove(n->recent + lo + 1, n->recent + lo, (n->recent_count - lo) * sizeof(uint32_t));
+	n->recent[lo] = number;
+	n->recent_count++;
+	if(n->recent_count > MIN_RECENT && n->recent_count * n->recent_count > 64 * n->sorted_count){
+		mergeRecent(n);
+	}
+
+	if(n->count * 2 > n->name_mask + 1){ //Keep the table at most half full
+		free(n->name_slots);
+		n->name_mask = n->name_mask * 2 + 1;
+		n->name_slots = emptySlots(n->name_mask + 1);
+		for(uint32_t j = 0; j < n->count; j++){
+			size_t k = n->names[j].hash & n->name_mask;
+			while(n->name_slots[k] != NO_NAME){
+				k = (k + 1) & n->name_mask;
+			}
+			n->name_slots[k] = j;
+		}
+	}
+	return number;
+}
+
+/*
+ * Gets the number of a pair of names, numbering it if it is new
+ *
+ * @param n The index
+ * @param last The number of the last name
+ * @param first The number of the first name
+ * @return The pair's number
+ */
+static uint32_t pairNumber(Names n, uint32_t last, uint32_t first){
+	size_t i = findPair(n, last, first);
+	if(n->pair_slots[i] != NO_NAME){
+		return n->pair_slots[i];
+	}
+
+	if(n->pair_count == n->pair_capacity){
+		n->pair_capacity = n->pair_capacity == 0 ? INITIAL_SLOTS : n->pair_capacity * 2;
+		n->pairs = (pair_t *)realloc(n->pairs, n->pair_capacity * sizeof(pair_t));
+		assert(n->pairs != NULL);
+	}
+	uint32_t number = (uint32_t)n->pair_count++;
+	pair_t *pair = &n->pairs[number];
+	memset(pair, 0, sizeof(pair_t));
+	pair->last = last;
+	pair->first = first;
+	n->pair_slots[i] = number;
+
+	if(n->pair_count * 2 > n->pair_mask + 1){ //Keep the table at most half full
+		free(n->pair_slots);
+		n->pair_mask = n->pair_mask * 2 + 1;
+		n->pair_slots = emptySlots(n->pair_mask + 1);
+		for(uint32_t j = 0; j < n->pair_count; j++){
+			size_t k = hashPair(n->pairs[j].last, n->pairs[j].first) & n->pair_mask;
+			while(n->pair_slots[k] != NO_NAME){
+				k = (k + 1) & n->pair_mask;
+			}
+			n->pair_slots[k] = j;
+		}
+	}
+	return number;
+}
+
+/*
+ * Checks whether a string starts with another
+ *
+ * @param str The string
+ * @param prefix The start to look for
+ * @param len The length of prefix
+ * @return Whether str starts with prefix
+ */
+static inline bool startsWith(const char *str, const char *prefix, size_t len){
+	return strncmp(str, prefix, len) == 0;
+}
+
+Names names_create( void ){
+	Names n = (Names)calloc(1, sizeof(struct Names_t));
+	assert(n != NULL);
+	n->name_mask = INITIAL_SLOTS - 1;
+	n->name_slots = emptySlots(INITIAL_SLOTS);
+	n->pair_mask = INITIAL_SLOTS - 1;
+	n->pair_slots = emptySlots(INITIAL_SLOTS);
+	return n;
+}
+
+void names_destroy( Names n ){
+	names_clear(n);
+	free(n->names);
+	free(n->sorted);
+	free(n->recent);
+	free(n->name_slots);
+	free(n->pairs);
+	free(n->pair_slots);
+	free(n->entries);
+	free(n);
+}
+
+void names_clear( Names n ){
+	for(size_t i = 0; i < n->count; i++){
+		free(n->names[i].as_first.ids);
+		free(n->names[i].as_last.ids);
+	}
+	for(size_t i = 0; i < n->pair_count; i++){
+		free(n->pairs[i].ids.ids);
+	}
+	n->count = 0;
+	n->sorted_count = 0;
+	n->recent_count = 0;
+	n->pair_count = 0;
+	n->users = 0;
+	memset(n->name_slots, 0xff, (n->name_mask + 1) * sizeof(uint32_t));
+	memset(n->pair_slots, 0xff, (n->pair_mask + 1) * sizeof(uint32_t));
+}
+
+void names_add( Names n, const person_t* p ){
+	assert(p->id == n->users);
+	if(n->users == n->user_capacity){
+		n->user_capacity = n->user_capacity == 0 ? INITIAL_SLOTS : n->user_capacity * 2;
+		n->entries = (entry_t *)realloc(n->entries, n->user_capacity * sizeof(entry_t));
+		assert(n->entries != NULL);
+	}
+	entry_t *e = &n->entries[n->users++];
+	e->first = nameNumber(n, p->first_name);
+	e->last = nameNumber(n, p->last_name);
+	e->pair = pairNumber(n, e->last, e->first);
+	for(int which = 0; which < 3; which++){
+		ids_t *list = listOf(n, e, which);
+		e->at[which] = list->count;
+		pushId(list, p->id);
+	}
+}
+
+void names_remove( Names n, uint32_t id ){
+	entry_t *e = &n->entries[id];
+	for(int which = 0; which < 3; which++){ //Fill the gap with the list's last user
+		ids_t *list = listOf(n, e, which);
+		uint32_t moved = list->ids[--list->count];
+		list->ids[e->at[which]] = moved;
+		n->entries[moved].at[which] = e->at[which];
+	}
+
+	uint32_t last = (uint32_t)--n->users;
+	if(id != last){ //The last user takes the removed user's id
+		*e = n->entries[last];
+		for(int which = 0; which < 3; which++){
+			listOf(n, e, which)->ids[e->at[which]] = id;
+		}
+	}
+}
+
+const uint32_t* names_find( const Names n, const char* last, const char* first, size_t* count ){
+	*count = 0;
+	size_t i = findName(n, last, hashName(last));
+	if(n->name_slots[i] == NO_NAME){
+		return NULL;
+	}
+	const ids_t *list = &n->names[n->name_slots[i]].as_last;
+	if(first != NULL){
+		size_t j = findName(n, first, hashName(first));
+		if(n->name_slots[j] == NO_NAME){
+			return NULL;
+		}
+		size_t k = findPair(n, n->name_slots[i], n->name_slots[j]);
+		if(n->pair_slots[k] == NO_NAME){
+			return NULL;
+		}
+		list = &n->pairs[n->pair_slots[k]].ids;
+	}
+	*count = list->count;
+	return list->ids;
+}
+
+size_t names_prefix( const Names n, const char* prefix, person_t** users, size_t limit, uint32_t* ids ){
+	size_t len = strlen(prefix);
+
+	//Walk both alphabetical lists together from the first name not before the prefix
+	size_t i = lowerBound(n, n->sorted, n->sorted_count, prefix);
+	size_t j = lowerBound(n, n->recent, n->recent_count, prefix);
+	size_t found = 0;
+	while(found < limit && (i < n->sorted_count || j < n->recent_count)){
+		const name_t *name;
+		if(j == n->recent_count || (i < n->sorted_count
+				&& strcmp(n->names[n->sorted[i]].str, n->names[n->recent[j]].str) < 0)){
+			name = &n->names[n->sorted[i++]];
+		}
+		else{
+			name = &n->names[n->recent[j++]];
+		}
+		if(!startsWith(name->str, prefix, len)){ //Past the last match
+			break;
+		}
+		for(uint32_t k = 0; k < name->as_last.count && found < limit; k++){
+			ids[found++] = name->as_last.ids[k];
+		}
+		for(uint32_t k = 0; k < name->as_first.count && found < limit; k++){
+			uint32_t id = name->as_first.ids[k];
+			if(!startsWith(users[id]->last_name, prefix, len)){ //Otherwise found by last name
+				ids[found++] = id;
+			}
+		}
+	}
+	return found;
+}
@@ -0,0 +1,103 @@
+/// @file names.h
+/// @brief A secondary index that finds users by name instead of handle.
+///
+/// General Notes on names Operation
+///
+/// - Every distinct name gets a number the first time a user has it, and
+///   keeps two lists of user ids: users with it as their first name, and
+///   users with it as their last name.  A second table keeps one list per
+///   (last name, first name) pair, so finding "John Smith" never walks the
+///   other Smiths.
+///
+/// - Distinct names are also kept in sorted order, so a prefix search is a
+///   binary search followed by a walk over just the matching names.  New
+///   names go to a short sorted list that is merged into the main one once
+///   it outgrows a multiple of the square root of its length, so adding a
+///   name costs about that many moves rather than one per name after it.
+///
+/// - Lists hold ids in the order users were added, and queries return the
+///   lists themselves, so a lookup costs the same however many users there
+///   are, and listing the matches costs time proportional to their number.
+///
+/// - Removing a user moves the last id of each of their lists into their
+///   place, and the user with the highest id takes over their id, so it
+///   costs constant time but leaves the lists out of age order.
+///
+/// - Adding a user is safe only while no other thread uses the index.
+///   Lookups may run side by side.
+///
+/// @author Bennett Moore bwm7637@rit.edu
+
+#ifndef NAMES_H
+#define NAMES_H
+
+#include <stddef.h>     // size_t
+#include <stdint.h>     // uint32_t
+
+#include "person.h"
+
+/// The Names data type is a pointer to an opaque structure.
+typedef struct Names_t * Names;
+
+/// Create an empty index.
+///
+/// @exception Assert fails if it cannot allocate space
+/// @return An index with no users
+///
+Names names_create( void );
+
+/// Release an index.
+///
+/// @param n The index
+/// @post n is not a valid instance of names.
+///
+void names_destroy( Names n );
+
+/// Forget every user.
+///
+/// @param n The index
+///
+void names_clear( Names n );
+
+/// Add a new user under their first and last names.
+///
+/// @param n The index
+/// @param p The user
+/// @exception Assert fails if it cannot allocate space
+/// @pre p's id is the number of users in the index.
+///
+void names_add( Names n, const person_t* p );
+
+/// Remove a user, and give the user with the highest id the removed user's
+/// id.
+///
+/// @param n The index
+/// @param id The id of the user to remove
+///
+void names_remove( Names n, uint32_t id );
+
+/// Find the users with a last name, and optionally a first name.
+///
+/// @param n The index
+/// @param last The last name
+/// @param first The first name, or NULL to match any first name
+/// @param count Receives the number of users found
+/// @return The ids of the users found, oldest first unless users have been
+///         removed; valid until the next change to the index
+///
+const uint32_t* names_find( const Names n, const char* last, const char* first, size_t* count );
+
+/// Find users whose first or last name starts with some text.
+///
+/// @param n The index
+/// @param prefix The start of the name
+/// @param users Every user, indexed by id
+/// @param limit The most users to find
+/// @param ids Receives the ids of the users found, limit entries at most
+/// @return The number of users found; users are ordered by the matching name,
+///         then as names_find() orders them, and a user whose names both
+///         match is found once
+///
+size_t names_prefix( const Names n, const char* prefix, person_t** users, size_t limit, uint32_t* ids );
+
+#endif // NAMES_H
@@ -0,0 +1,24 @@
+/// @file person.h
+/// @brief The user record stored in the AMICI network.
+///
+/// @author Bennett Moore bwm7637@rit.edu
+
+#ifndef PERSON_H
+#define PERSON_H
+
+#include <stddef.h>     // size_t
+#include <stdint.h>     // uint32_t
+
+typedef struct person_s{
+	char *first_name;		// First name
+	char *last_name;		// Last name
+	char *handle;			// Username
+	uint32_t *friends;		// Dynamic collection of friends' ids
+	void *friend_index;		// Hash index into friends, of 16-bit entries up to FRIEND_NARROW_SLOTS slots, NULL for small lists
+	uint32_t friend_count;		// Current number of friends
+	uint32_t max_friends;		// Maximum number of friends
+	uint32_t index_mask;		// Number of index slots minus one
+	uint32_t id;			// Dense user number, unique among current users
+} person_t;
+
+#endif // PERSON_H
@@ -0,0 +1,118 @@
+/*
+ * file: profile.c
+ *
+ * Log2 latency histograms, one cache-line aligned block of counters per
+ * command so threads running different commands do not share lines.
+ *
+ * @author Bennett Moore bwm7637@rit.edu
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "profile.h"
+
+typedef struct histogram_s{
+	_Alignas(64) uint64_t buckets[PROFILE_BUCKETS];	// Runs by floor(log2(nanoseconds))
+	uint64_t count;			// Number of runs
+	uint64_t total;			// Sum of latencies in nanoseconds
+} histogram_t;
+
+struct Profile_t{
+	histogram_t *commands;		// One histogram per command
+	size_t count;			// Number of commands
+	bool enabled;			// Whether to collect latencies
+};
+
+/*
+ * Reads the monotonic clock
+ *
+ * @return The time in nanoseconds, never 0
+ */
+static inline uint64_t now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec + 1;
+}
+
+Profile profile_create( size_t commands ){
+	Profile p = (Profile)malloc(sizeof(struct Profile_t));
+	assert(p != NULL);
+	p->commands = (histogram_t *)aligned_alloc(64, (commands == 0 ? 1 : commands) * sizeof(histogram_t));
+	assert(p->commands != NULL);
+	p->count = commands;
+	p->enabled = true;
+	profile_reset(p);
+	return p;
+}
+
+void profile_destroy( Profile p ){
+	free(p->commands);
+	free(p);
+}
+
+void profile_enable( Profile p, bool on ){
+	__atomic_store_n(&p->enabled, on, __ATOMIC_RELAXED);
+}
+
+bool profile_enabled( const Profile p ){
+	return __atomic_load_n(&p->enabled, __ATOMIC_RELAXED);
+}
+
+void profile_reset( Profile p ){
+	memset(p->commands, 0, p->count * sizeof(histogram_t));
+}
+
+uint64_t profile_start( const Profile p ){
+	return profile_enabled(p) ? now() : 0;
+}
+
+void profile_record( Profile p, size_t command, uint64_t start ){
+	if(start == 0 || command >= p->count){
+		return;
+	}
+	uint64_t ns = now() - start;
+	unsigned k = ns < 2 ? 0 : 63 - (unsigned)__builtin_clzll(ns);
+	histogram_t *h = &p->commands[command];
+	__atomic_fetch_add(&h->buckets[k < PROFILE_BUCKETS ? k : PROFILE_BUCKETS - 1], 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&h->count, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&h->total, ns, __ATOMIC_RELAXED);
+}
+
+uint64_t profile_count( const Profile p, size_t command ){
+	return __atomic_load_n(&p->commands[command].count, __ATOMIC_RELAXED);
+}
+
+uint64_t profile_total( const Profile p, size_t command ){
+	return __atomic_load_n(&p->commands[command].total, __ATOMIC_RELAXED);
+}
+
+uint64_t profile_quantile( const Profile p, size_t command, double q ){
+	const histogram_t *h = &p->commands[command];
+	uint64_t counts[PROFILE_BUCKETS];
+	uint64_t count = 0;
+	for(size_t k = 0; k < PROFILE_BUCKETS; k++){ //Sum the buckets, not count, so the two agree
+		counts[k] = __atomic_load_n(&h->buckets[k], __ATOMIC_RELAXED);
+		count += counts[k];
+	}
+	if(count == 0){
+		return 0;
+	}
+
+	uint64_t rank = (uint64_t)(q * (double)count);
+	if(rank >= count){
+		rank = count - 1;
+	}
+	uint64_t seen = 0;
+	for(size_t k = 0; k < PROFILE_BUCKETS; k++){
+		seen += counts[k];
+		if(seen > rank){
+			return (uint64_t)1 << (k + 1);
+		}
+	}
+	return (uint64_t)1 << PROFILE_BUCKETS;
+}
@@ -0,0 +1,109 @@
+/// @file profile.h
+/// @brief Per-command latency histograms cheap enough to leave running.
+///
+/// General Notes on profile Operation
+///
+/// - Each command has PROFILE_BUCKETS counters; a command that took t
+///   nanoseconds is counted in bucket floor(log2(t)), so recording costs two
+///   clock reads and three relaxed atomic adds, with no locking.
+///
+/// - Quantiles are read from the buckets, so they are upper bounds that may
+///   be up to twice the true latency.
+///
+/// - Turning collection off makes profile_start() return 0 without reading
+///   the clock, and profile_record() ignores a start of 0.
+///
+/// - Every function may be called from several threads at once.
+///
+/// @author Bennett Moore bwm7637@rit.edu
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdbool.h>    // bool
+#include <stddef.h>     // size_t
+#include <stdint.h>     // uint64_t
+
+/// Number of latency buckets; the last one also counts anything slower
+#define PROFILE_BUCKETS 48
+
+/// The Profile data type is a pointer to an opaque structure.
+typedef struct Profile_t * Profile;
+
+/// Create empty histograms, with collection turned on.
+///
+/// @param commands The number of commands to keep histograms for
+/// @exception Assert fails if it cannot allocate space
+/// @return The histograms
+///
+Profile profile_create( size_t commands );
+
+/// Release a set of histograms.
+///
+/// @param p The histograms
+/// @post p is not a valid instance of profile.
+///
+void profile_destroy( Profile p );
+
+/// Turn collection on or off.
+///
+/// @param p The histograms
+/// @param on Whether to collect latencies
+///
+void profile_enable( Profile p, bool on );
+
+/// Check whether latencies are being collected.
+///
+/// @param p The histograms
+/// @return Whether collection is on
+///
+bool profile_enabled( const Profile p );
+
+/// Empty every histogram.
+///
+/// @param p The histograms
+///
+void profile_reset( Profile p );
+
+/// Note when a command starts.
+///
+/// @param p The histograms
+/// @return The time in nanoseconds, or 0 if collection is off
+///
+uint64_t profile_start( const Profile p );
+
+/// Count a finished command.
+///
+/// @param p The histograms
+/// @param command The command's number
+/// @param start What profile_start() returned when the command started
+///
+void profile_record( Profile p, size_t command, uint64_t start );
+
+/// Get the number of times a command ran.
+///
+/// @param p The histograms
+/// @param command The command's number
+/// @return The number of recorded runs
+///
+uint64_t profile_count( const Profile p, size_t command );
+
+/// Get the total time spent in a command.
+///
+/// @param p The histograms
+/// @param command The command's number
+/// @return The sum of every recorded latency, in nanoseconds
+///
+uint64_t profile_total( const Profile p, size_t command );
+
+/// Get a latency that a given share of a command's runs did not exceed.
+///
+/// @param p The histograms
+/// @param command The command's number
+/// @param q The share of runs, between 0 and 1
+/// @return The upper bound of the bucket holding that run, in nanoseconds,
+///         or 0 if the command never ran
+///
+uint64_t profile_quantile( const Profile p, size_t command, double q );
+
+#endif // PROFILE_H
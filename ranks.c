@@ -0,0 +1,148 @@
+/*
+ * file: ranks.c
+ *
+ * Users sorted by number of friends in one array of blocks, one block per
+ * number of friends. A user changes blocks by swapping places with the
+ * user at the edge of their block and moving the boundary past them.
+ *
+ * @author Bennett Moore bwm7637@rit.edu
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ranks.h"
+
+struct Ranks_t{
+	uint32_t *order;		// User ids, most friends first
+	uint32_t *place;		// Position of each user in order
+	uint32_t *degree;		// Number of friends of each user
+	size_t users;			// Number of users
+	size_t capacity;		// Room in order, place and degree
+	size_t *at_least;		// Users with at least d friends, for d >= 1
+	size_t max_degree;		// Largest d with room in at_least
+};
+
+/*
+ * Counts the users with at least some number of friends
+ *
+ * @param r The ordering
+ * @param d The number of friends
+ * @return The number of users with d or more friends, which is also where
+ *         the block of users with d - 1 friends starts
+ */
+static inline size_t atLeast(const Ranks r, size_t d){
+	if(d == 0){
+		return r->users;
+	}
+	return d <= r->max_degree ? r->at_least[d] : 0;
+}
+
+/*
+ * Swaps two users' places
+ *
+ * @param r The ordering
+ * @param i The first position
+ * @param j The second position
+ */
+static inline void swap(Ranks r, size_t i, size_t j){
+	uint32_t a = r->order[i];
+	uint32_t b = r->order[j];
+	r->order[i] = b;
+	r->order[j] = a;
+	r->place[a] = (uint32_t)j;
+	r->place[b] = (uint32_t)i;
+}
+
+Ranks ranks_create( void ){
+	Ranks r = (Ranks)calloc(1, sizeof(struct Ranks_t));
+	assert(r != NULL);
+	return r;
+}
+
+void ranks_destroy( Ranks r ){
+	free(r->order);
+	free(r->place);
+	free(r->degree);
+	free(r->at_least);
+	free(r);
+}
+
+void ranks_clear( Ranks r ){
+	r->users = 0;
+	if(r->at_least != NULL){
+		memset(r->at_least, 0, (r->max_degree + 1) * sizeof(size_t));
+	}
+}
+
+void ranks_add( Ranks r, uint32_t id ){
+	assert(id == r->users);
+	if(r->users == r->capacity){ //Grow every array geometrically
+		r->capacity = r->capacity == 0 ? 64 : r->capacity * 2;
+		r->order = (uint32_t *)realloc(r->order, r->capacity * sizeof(uint32_t));
+		r->place = (uint32_t *)realloc(r->place, r->capacity * sizeof(uint32_t));
+		r->degree = (uint32_t *)realloc(r->degree, r->capacity * sizeof(uint32_t));
+		assert(r->order != NULL && r->place != NULL && r->degree != NULL);
+	}
+
+	//Users with no friends come last
+	r->order[r->users] = id;
+	r->place[id] = (uint32_t)r->users;
+	r->degree[id] = 0;
+	r->users++;
+}
+
+void ranks_remove( Ranks r, uint32_t id ){
+	assert(r->degree[id] == 0);
+
+	//The last position is in the block of users with no friends
+	swap(r, r->place[id], r->users - 1);
+	r->users--;
+
+	uint32_t last = (uint32_t)r->users;
+	if(id != last){ //The last user takes the removed user's id
+		r->order[r->place[last]] = id;
+		r->place[id] = r->place[last];
+		r->degree[id] = r->degree[last];
+	}
+}
+
+void ranks_raise( Ranks r, uint32_t id ){
+	size_t d = r->degree[id];
+	if(d + 1 > r->max_degree){ //Make room for the new block
+		size_t max_degree = r->max_degree < 16 ? 16 : r->max_degree * 2;
+		r->at_least = (size_t *)realloc(r->at_least, (max_degree + 1) * sizeof(size_t));
+		assert(r->at_least != NULL);
+		size_t from = r->max_degree == 0 ? 0 : r->max_degree + 1;
+		memset(r->at_least + from, 0, (max_degree + 1 - from) * sizeof(size_t));
+		r->max_degree = max_degree;
+	}
+
+	//Move to the front of block d, which becomes the back of block d + 1
+	swap(r, r->place[id], r->at_least[d + 1]);
+	r->at_least[d + 1]++;
+	r->degree[id]++;
+}
+
+void ranks_lower( Ranks r, uint32_t id ){
+	size_t d = r->degree[id];
+	assert(d > 0);
+
+	//Move to the back of block d, which becomes the front of block d - 1
+	swap(r, r->place[id], r->at_least[d] - 1);
+	r->at_least[d]--;
+	r->degree[id]--;
+}
+
+const uint32_t* ranks_order( const Ranks r ){
+	return r->order;
+}
+
+size_t ranks_degree( const Ranks r, uint32_t id ){
+	return r->degree[id];
+}
+
+size_t ranks_rank( const Ranks r, uint32_t id ){
+	return atLeast(r, (size_t)r->degree[id] + 1) + 1;
+}
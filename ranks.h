@@ -0,0 +1,115 @@
+/// @file ranks.h
+/// @brief Users ordered by number of friends, kept in order as friendships
+/// come and go.
+///
+/// General Notes on ranks Operation
+///
+/// - Users are kept in one array, most friends first, so users with the
+///   same number of friends form one block.  For each number of friends d
+///   the structure also counts the users with at least d friends, which is
+///   where block d - 1 starts.
+///
+/// - Gaining or losing a friend moves a user only to the edge of their
+///   block, by swapping them with the user already there, so both cost
+///   constant time.
+///
+/// - The k users with the most friends are the first k of the array, and a
+///   user's rank is one more than the number of users with more friends
+///   than they have, so both queries avoid sorting.
+///
+/// - User ids stay dense: removing a user hands the last user's id to the
+///   removed user's place, in constant time.
+///
+/// @author Bennett Moore bwm7637@rit.edu
+
+#ifndef RANKS_H
+#define RANKS_H
+
+#include <stddef.h>     // size_t
+#include <stdint.h>     // uint32_t
+
+#include "person.h"
+
+/// The Ranks data type is a pointer to an opaque structure.
+typedef struct Ranks_t * Ranks;
+
+/// Create an empty ordering.
+///
+/// @exception Assert fails if it cannot allocate space
+/// @return An ordering with no users
+///
+Ranks ranks_create( void );
+
+/// Release an ordering.
+///
+/// @param r The ordering
+/// @post r is not a valid instance of ranks.
+///
+void ranks_destroy( Ranks r );
+
+/// Forget every user.
+///
+/// @param r The ordering
+///
+void ranks_clear( Ranks r );
+
+/// Add a new user with no friends.
+///
+/// @param r The ordering
+/// @param id The user's id
+/// @exception Assert fails if it cannot allocate space
+/// @pre id is the number of users in the ordering.
+///
+void ranks_add( Ranks r, uint32_t id );
+
+/// Forget a user, and give the user with the highest id the removed user's
+/// id.
+///
+/// @param r The ordering
+/// @param id The id of the user to forget
+/// @pre The user has no friends left.
+///
+void ranks_remove( Ranks r, uint32_t id );
+
+/// Count a new friend for a user.
+///
+/// @param r The ordering
+/// @param id The user's id
+/// @exception Assert fails if it cannot allocate space
+///
+void ranks_raise( Ranks r, uint32_t id );
+
+/// Count a lost friend for a user.
+///
+/// @param r The ordering
+/// @param id The user's id
+/// @pre The user has at least one friend.
+///
+void ranks_lower( Ranks r, uint32_t id );
+
+/// Get users in order of their number of friends.
+///
+/// @param r The ordering
+/// @return Every user's id, most friends first, with ties in no particular
+///         order; valid until the next change to the ordering
+///
+const uint32_t* ranks_order( const Ranks r );
+
+/// Get a user's number of friends.
+///
+/// @param r The ordering
+/// @param id The user's id
+/// @return The number of friends counted for the user
+///
+size_t ranks_degree( const Ranks r, uint32_t id );
+
+/// Get a user's rank by number of friends.
+///
+/// @param r The ordering
+/// @param id The user's id
+/// @return One more than the number of users with more friends, so users
+///         with the same number of friends share a rank
+///
+size_t ranks_rank( const Ranks r, uint32_t id );
+
+#endif // RANKS_H
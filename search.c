@@ -0,0 +1,359 @@
+/*
+ * file: search.c
+ *
+ * Bidirectional breadth-first search. Each side keeps a visited bitset, a
+ * small hash map from reached user to (parent, depth), and its current
+ * frontier. A level is expanded by one or more jobs, each of which scans a
+ * slice of the frontier and collects newly claimed users and meetings with
+ * the other side; the jobs' results are merged once the level is done.
+ *
+ * @author Bennett Moore bwm7637@rit.edu
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "search.h"
+
+typedef struct visit_s{
+	uint32_t key;			// User id plus one, 0 if the slot is empty
+	uint32_t parent;		// Neighbor the user was reached from
+	uint32_t depth;			// Hops from this side's root
+} visit_t;
+
+typedef struct side_s{
+	uint64_t *seen;			// Bit per user, set once reached
+	visit_t *visits;		// Reached users
+	size_t capacity;		// Number of visit slots, a power of two
+	size_t size;			// Number of reached users
+	uint32_t *frontier;		// Users reached at the deepest level
+	size_t length;			// Number of users in frontier
+	size_t depth;			// Hops from the root to the frontier
+	size_t work;			// Friend list entries the frontier would scan
+} side_t;
+
+typedef struct graph_s{
+	person_t **users;		// Every user, indexed by id
+	Csr frozen;			// Frozen graph, or NULL
+} graph_t;
+
+typedef struct list_s{
+	uint32_t *ids;			// Pairs of ids
+	size_t length;			// Number of pairs
+	size_t capacity;		// Room for this many pairs
+} list_t;
+
+typedef struct job_s{
+	const graph_t *g;
+	side_t *self;			// Side being expanded
+	const side_t *other;		// Side being met
+	size_t begin;			// Slice of self's frontier to expand
+	size_t end;
+	bool atomic;			// Whether other jobs share self->seen
+	list_t next;			// (claimed user, parent) pairs
+	list_t meets;			// (user seen by other, parent) pairs
+	size_t work;			// Friend list entries of claimed users
+} job_t;
+
+/*
+ * Gets the number of friends of a user
+ *
+ * @param g The graph
+ * @param id The user
+ * @return The user's number of friends
+ */
+static inline size_t degreeOf(const graph_t *g, uint32_t id){
+	return g->users[id]->friend_count;
+}
+
+/*
+ * Appends a pair of ids to a list
+ *
+ * @param l The list
+ * @param a The first id
+ * @param b The second id
+ */
+static void push(list_t *l, uint32_t a, uint32_t b){
+	if(l->length == l->capacity){
+		l->capacity = l->capacity == 0 ? 64 : l->capacity * 2;
+		l->ids = (uint32_t *)realloc(l->ids, l->capacity * 2 * sizeof(uint32_t));
+		assert(l->ids != NULL);
+	}
+	l->ids[2 * l->length] = a;
+	l->ids[2 * l->length + 1] = b;
+	l->length++;
+}
+
+/*
+ * Finds the visit slot of a user
+ *
+ * @param s The side
+ * @param id The user
+ * @return The user's slot, or the empty slot where it would go
+ */
+static visit_t *visitOf(const side_t *s, uint32_t id){
+	size_t mask = s->capacity - 1;
+	size_t i = ((size_t)id * 0x9e3779b1u) & mask;
+	while(s->visits[i].key != 0 && s->visits[i].key != id + 1){
+		i = (i + 1) & mask;
+	}
+	return &s->visits[i];
+}
+
+/*
+ * Records how a user was reached
+ *
+ * @param s The side
+ * @param id The user
+ * @param parent The neighbor the user was reached from
+ * @param depth The user's distance from the root
+ */
+static void addVisit(side_t *s, uint32_t id, uint32_t parent, size_t depth){
+	if((s->size + 1) * 2 > s->capacity){ //Keep the map at most half full
+		visit_t *old = s->visits;
+		size_t old_capacity = s->capacity;
+		s->capacity *= 2;
+		s->visits = (visit_t *)calloc(s->capacity, sizeof(visit_t));
+		assert(s->visits != NULL);
+		for(size_t i = 0; i < old_capacity; i++){
+			if(old[i].key != 0){
+				*visitOf(s, old[i].key - 1) = old[i];
+			}
+		}
+		free(old);
+	}
+	visit_t *v = visitOf(s, id);
+	v->key = id + 1;
+	v->parent = parent;
+	v->depth = (uint32_t)depth;
+	s->size++;
+}
+
+/*
+ * Starts one side of the search at a root user
+ *
+ * @param s The side
+ * @param g The graph
+ * @param count The number of users
+ * @param root The root user
+ */
+static void initSide(side_t *s, const graph_t *g, size_t count, uint32_t root){
+	s->seen = (uint64_t *)calloc(count / 64 + 1, sizeof(uint64_t));
+	s->capacity = 64;
+	s->size = 0;
+	s->visits = (visit_t *)calloc(s->capacity, sizeof(visit_t));
+	s->frontier = (uint32_t *)malloc(sizeof(uint32_t));
+	assert(s->seen != NULL && s->visits != NULL && s->frontier != NULL);
+	s->seen[root / 64] |= (uint64_t)1 << (root % 64);
+	addVisit(s, root, root, 0);
+	s->frontier[0] = root;
+	s->length = 1;
+	s->depth = 0;
+	s->work = degreeOf(g, root);
+}
+
+/*
+ * Releases one side of the search
+ *
+ * @param s The side
+ */
+static void freeSide(side_t *s){
+	free(s->seen);
+	free(s->visits);
+	free(s->frontier);
+}
+
+/*
+ * Expands a slice of a frontier by one level
+ *
+ * @param arg The job describing the slice
+ * @return NULL
+ */
+static void *expand(void *arg){
+	job_t *job = (job_t *)arg;
+	const graph_t *g = job->g;
+	uint64_t *seen = job->self->seen;
+	const uint64_t *other = job->other->seen;
+
+	for(size_t i = job->begin; i < job->end; i++){
+		uint32_t u = job->self->frontier[i];
+		person_t *p = g->users[u];
+		const uint32_t *row = g->frozen != NULL ? csr_neighbors(g->frozen, u) : NULL;
+		for(size_t j = 0; j < p->friend_count; j++){
+			uint32_t v = row != NULL ? row[j] : p->friends[j];
+			uint64_t bit = (uint64_t)1 << (v % 64);
+			if(other[v / 64] & bit){ //The two searches meet at v
+				push(&job->meets, v, u);
+			}
+			uint64_t word = job->atomic ? __atomic_load_n(&seen[v / 64], __ATOMIC_RELAXED) : seen[v / 64];
+			if(word & bit){
+				continue;
+			}
+
+			//Claim v; with several jobs, only one may win it
+			bool claimed;
+			if(job->atomic){
+				claimed = !(__atomic_fetch_or(&seen[v / 64], bit, __ATOMIC_RELAXED) & bit);
+			}
+			else{
+				seen[v / 64] |= bit;
+				claimed = true;
+			}
+			if(claimed){
+				push(&job->next, v, u);
+				job->work += degreeOf(g, v);
+			}
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Follows parent links from a user back to a side's root
+ *
+ * @param s The side
+ * @param id The user to start from
+ * @param out Receives the ids from id to the root
+ * @return The number of ids written
+ */
+static size_t chain(const side_t *s, uint32_t id, uint32_t *out){
+	size_t n = 0;
+	while(true){
+		out[n++] = id;
+		const visit_t *v = visitOf(s, id);
+		if(v->depth == 0){
+			return n;
+		}
+		id = v->parent;
+	}
+}
+
+size_t search_path( person_t** users, size_t count, const Csr frozen, uint32_t from, uint32_t to,
+                    size_t max, unsigned threads, uint32_t** path ){
+	assert(from < count && to < count && threads != 0);
+	if(path != NULL){
+		*path = NULL;
+	}
+	if(from == to){
+		if(path != NULL){
+			*path = (uint32_t *)malloc(sizeof(uint32_t));
+			assert(*path != NULL);
+			(*path)[0] = from;
+		}
+		return 0;
+	}
+
+	graph_t g = {users, frozen};
+	side_t sides[2];
+	initSide(&sides[0], &g, count, from);
+	initSide(&sides[1], &g, count, to);
+	job_t *jobs = (job_t *)calloc(threads, sizeof(job_t));
+	pthread_t *workers = (pthread_t *)malloc(threads * sizeof(pthread_t));
+	assert(jobs != NULL && workers != NULL);
+
+	size_t hops = SEARCH_UNREACHABLE;
+	uint32_t meet = 0;
+	uint32_t meet_parent = 0;
+	int meet_side = 0;
+	while(hops == SEARCH_UNREACHABLE && sides[0].length > 0 && sides[1].length > 0
+			&& sides[0].depth + sides[1].depth + 1 <= max){
+		//Grow the side with less to scan
+		int which = sides[0].work <= sides[1].work ? 0 : 1;
+		side_t *self = &sides[which];
+		const side_t *other = &sides[1 - which];
+
+		size_t n = self->length >= SEARCH_PARALLEL_FRONTIER ? threads : 1;
+		for(size_t i = 0; i < n; i++){
+			jobs[i].g = &g;
+			jobs[i].self = self;
+			jobs[i].other = other;
+			jobs[i].begin = self->length * i / n;
+			jobs[i].end = self->length * (i + 1) / n;
+			jobs[i].atomic = n > 1;
+			jobs[i].next.length = 0;
+			jobs[i].meets.length = 0;
+			jobs[i].work = 0;
+		}
+		size_t started = 1;
+		for(size_t i = 1; i < n; i++){ //Fall back to this thread if one cannot start
+			if(pthread_create(&workers[i], NULL, expand, &jobs[i]) != 0){
+				break;
+			}
+			started++;
+		}
+		for(size_t i = started; i < n; i++){
+			expand(&jobs[i]);
+		}
+		expand(&jobs[0]);
+		for(size_t i = 1; i < started; i++){
+			pthread_join(workers[i], NULL);
+		}
+
+		//Pick the meeting closest to the other root, then merge the level
+		size_t best = SEARCH_UNREACHABLE;
+		size_t length = 0;
+		size_t work = 0;
+		for(size_t i = 0; i < n; i++){
+			for(size_t j = 0; j < jobs[i].meets.length; j++){
+				uint32_t v = jobs[i].meets.ids[2 * j];
+				size_t depth = visitOf(other, v)->depth;
+				if(depth < best){
+					best = depth;
+					meet = v;
+					meet_parent = jobs[i].meets.ids[2 * j + 1];
+					meet_side = which;
+				}
+			}
+			length += jobs[i].next.length;
+			work += jobs[i].work;
+		}
+		if(best != SEARCH_UNREACHABLE){
+			hops = self->depth + 1 + best;
+			if(hops > max){
+				hops = SEARCH_UNREACHABLE;
+			}
+			break;
+		}
+
+		self->frontier = (uint32_t *)realloc(self->frontier, (length + 1) * sizeof(uint32_t));
+		assert(self->frontier != NULL);
+		self->length = 0;
+		self->depth++;
+		self->work = work;
+		for(size_t i = 0; i < n; i++){
+			for(size_t j = 0; j < jobs[i].next.length; j++){
+				uint32_t v = jobs[i].next.ids[2 * j];
+				addVisit(self, v, jobs[i].next.ids[2 * j + 1], self->depth);
+				self->frontier[self->length++] = v;
+			}
+		}
+	}
+
+	if(hops != SEARCH_UNREACHABLE && path != NULL){
+		//Stitch the chain back to the first user onto the chain on to the second
+		uint32_t a = meet_side == 0 ? meet_parent : meet;
+		uint32_t b = meet_side == 0 ? meet : meet_parent;
+		*path = (uint32_t *)malloc((hops + 1) * sizeof(uint32_t));
+		assert(*path != NULL);
+		size_t n = chain(&sides[0], a, *path);
+		for(size_t i = 0; i < n / 2; i++){
+			uint32_t swap = (*path)[i];
+			(*path)[i] = (*path)[n - 1 - i];
+			(*path)[n - 1 - i] = swap;
+		}
+		chain(&sides[1], b, *path + n);
+	}
+
+	for(unsigned i = 0; i < threads; i++){
+		free(jobs[i].next.ids);
+		free(jobs[i].meets.ids);
+	}
+	free(jobs);
+	free(workers);
+	freeSide(&sides[0]);
+	freeSide(&sides[1]);
+	return hops;
+}
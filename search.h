@@ -0,0 +1,50 @@
+/// @file search.h
+/// @brief Shortest friendship chains between two users.
+///
+/// The search runs breadth-first from both users at once, always growing
+/// whichever side has the cheaper frontier (fewest friend list entries to
+/// scan), and stops at the first level where the two sides meet.  Visited
+/// users are marked in one dense bitset per side, indexed by user id, so a
+/// membership test is a single bit lookup; only the users actually reached
+/// are given a parent entry.
+///
+/// Frontiers with at least SEARCH_PARALLEL_FRONTIER users are split across
+/// the requested number of threads, which claim users with atomic bitset
+/// updates.
+///
+/// @author Bennett Moore bwm7637@rit.edu
+
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <stddef.h>     // size_t
+#include <stdint.h>     // uint32_t, SIZE_MAX
+
+#include "csr.h"
+#include "person.h"
+
+/// Returned when no chain exists within the allowed number of hops
+#define SEARCH_UNREACHABLE SIZE_MAX
+
+/// Frontiers this large are expanded by several threads
+#define SEARCH_PARALLEL_FRONTIER 4096
+
+/// Find a shortest chain of friendships between two users.
+///
+/// @param users Every user, indexed by id
+/// @param count The number of users
+/// @param frozen The frozen graph, or NULL if the network has changed since
+/// @param from The id of the first user
+/// @param to The id of the second user
+/// @param max The most hops to search, or SEARCH_UNREACHABLE for no limit
+/// @param threads The most threads to expand a frontier with
+/// @param path Receives the ids along the chain, from first to last, or
+///        NULL if only the distance is wanted; the caller frees the array
+/// @exception Assert fails if it cannot allocate space
+/// @pre from and to are below count, and threads is not 0.
+/// @return The number of hops, or SEARCH_UNREACHABLE (with *path NULL)
+///
+size_t search_path( person_t** users, size_t count, const Csr frozen, uint32_t from, uint32_t to,
+                    size_t max, unsigned threads, uint32_t** path );
+
+#endif // SEARCH_H
@@ -0,0 +1,505 @@
+/*
+ * file: server.c
+ *
+ * Socket server. Every event loop waits on the shared listening socket
+ * with EPOLLEXCLUSIVE, so a new connection wakes one loop, which keeps it.
+ * Replies are written into the loop's memory stream by the command, then
+ * moved to the connection's reply buffer once per read, so pipelined
+ * requests are answered with one send. A pipe that is written once and
+ * never read wakes every loop when the server stops.
+ *
+ * @author Bennett Moore bwm7637@rit.edu
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <arpa/inet.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "batch.h"
+#include "server.h"
+
+//One client
+typedef struct connection_s{
+	int fd;
+	char *in;			// Request bytes not yet run
+	size_t in_length;
+	size_t in_capacity;
+	char *out;			// Reply bytes not yet sent
+	size_t out_length;
+	size_t out_sent;		// Bytes at the start of out already sent
+	size_t out_capacity;
+	uint32_t events;		// Events the loop waits for on fd
+	bool closing;			// No more requests will be read
+	struct connection_s *prev;	// The loop's other connections
+	struct connection_s *next;
+} connection_t;
+
+//One event loop and the connections it accepted
+typedef struct loop_s{
+	int epoll;
+	int listener;			// Shared by every loop
+	int wake;			// Read end of the stop pipe, shared by every loop
+	int stop;			// Write end of the stop pipe
+	bool *stopping;			// Set once a command stops the server
+	size_t max;			// Tokens per command
+	bool (*run)(char **data, FILE *out);
+	void (*idle)(void);
+	char **data;			// Tokens of the command being run
+	FILE *capture;			// Memory stream commands reply into
+	char *captured;			// The stream's buffer
+	size_t captured_length;
+	connection_t *connections;
+} loop_t;
+
+/*
+ * Makes a descriptor's reads and writes return instead of waiting
+ *
+ * @param fd The descriptor
+ * @return Whether the descriptor was changed
+ */
+static bool nonblocking(int fd){
+	int flags = fcntl(fd, F_GETFL);
+	return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+/*
+ * Opens the listening socket
+ *
+ * @param address A port number on the loopback address, or a socket path
+ * @param is_path Set to whether address was taken as a path
+ * @return The listening socket, or -1 if it could not be opened
+ */
+static int listenOn(const char *address, bool *is_path){
+	char *end;
+	unsigned long port = strtoul(address, &end, 10);
+	*is_path = *address == '\0' || *end != '\0';
+	int fd;
+	if(!*is_path){ //Loopback TCP port
+		if(port == 0 || port > 65535){
+			return -1;
+		}
+		fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if(fd < 0){
+			return -1;
+		}
+		int on = 1;
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+		struct sockaddr_in sin;
+		memset(&sin, 0, sizeof(sin));
+		sin.sin_family = AF_INET;
+		sin.sin_port = htons((uint16_t)port);
+		sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		if(bind(fd, (struct sockaddr *)&sin, sizeof(sin)) != 0){
+			close(fd);
+			return -1;
+		}
+	}
+	else{ //Unix domain socket, replacing one left behind by an earlier server
+		struct sockaddr_un sun;
+		memset(&sun, 0, sizeof(sun));
+		sun.sun_family = AF_UNIX;
+		if(strlen(address) >= sizeof(sun.sun_path)){
+			return -1;
+		}
+		strcpy(sun.sun_path, address);
+		struct stat st;
+		if(stat(address, &st) == 0 && S_ISSOCK(st.st_mode)){
+			unlink(address);
+		}
+		fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if(fd < 0){
+			return -1;
+		}
+		if(bind(fd, (struct sockaddr *)&sun, sizeof(sun)) != 0){
+			close(fd);
+			return -1;
+		}
+	}
+	if(listen(fd, SOMAXCONN) != 0 || !nonblocking(fd)){
+		close(fd);
+		if(*is_path){
+			unlink(address);
+		}
+		return -1;
+	}
+	return fd;
+}
+
+/*
+ * Changes the events a loop waits for on a connection
+ *
+ * @param loop The loop
+ * @param c The connection
+ * @param events The events to wait for
+ */
+static void watch(loop_t *loop, connection_t *c, uint32_t events){
+	if(events != c->events){
+		struct epoll_event ev = {.events = events, .data.ptr = c};
+		epoll_ctl(loop->epoll, EPOLL_CTL_MOD, c->fd, &ev);
+		c->events = events;
+	}
+}
+
+/*
+ * Closes a connection and forgets it
+ *
+ * @param loop The loop that accepted it
+ * @param c The connection
+ */
+static void hangUp(loop_t *loop, connection_t *c){
+	epoll_ctl(loop->epoll, EPOLL_CTL_DEL, c->fd, NULL);
+	close(c->fd);
+	if(c->prev != NULL){
+		c->prev->next = c->next;
+	}
+	else{
+		loop->connections = c->next;
+	}
+	if(c->next != NULL){
+		c->next->prev = c->prev;
+	}
+	free(c->in);
+	free(c->out);
+	free(c);
+}
+
+/*
+ * Accepts every waiting connection
+ *
+ * @param loop The loop to keep them
+ */
+static void acceptAll(loop_t *loop){
+	while(true){
+		int fd = accept(loop->listener, NULL, NULL);
+		if(fd < 0){ //Drained, or taken by another loop
+			return;
+		}
+		if(!nonblocking(fd)){
+			close(fd);
+			continue;
+		}
+		int on = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)); //Fails harmlessly on Unix sockets
+
+		connection_t *c = (connection_t *)calloc(1, sizeof(connection_t));
+		assert(c != NULL);
+		c->fd = fd;
+		c->events = EPOLLIN;
+		struct epoll_event ev = {.events = EPOLLIN, .data.ptr = c};
+		if(epoll_ctl(loop->epoll, EPOLL_CTL_ADD, fd, &ev) != 0){
+			close(fd);
+			free(c);
+			continue;
+		}
+		c->next = loop->connections;
+		if(c->next != NULL){
+			c->next->prev = c;
+		}
+		loop->connections = c;
+	}
+}
+
+/*
+ * Adds bytes to the end of a connection's replies
+ *
+ * @param c The connection
+ * @param bytes The bytes
+ * @param length The number of bytes
+ */
+static void reply(connection_t *c, const char *bytes, size_t length){
+	if(c->out_sent == c->out_length){ //Everything so far went out
+		c->out_sent = 0;
+		c->out_length = 0;
+	}
+	if(c->out_length + length > c->out_capacity){
+		size_t capacity = c->out_capacity == 0 ? SERVER_CHUNK : c->out_capacity;
+		while(capacity < c->out_length + length){
+			capacity *= 2;
+		}
+		c->out = (char *)realloc(c->out, capacity);
+		assert(c->out != NULL);
+		c->out_capacity = capacity;
+	}
+	memcpy(c->out + c->out_length, bytes, length);
+	c->out_length += length;
+}
+
+/*
+ * Sends as many waiting replies as the socket takes
+ *
+ * @param c The connection
+ * @return Whether the connection is still usable
+ */
+static bool flush(connection_t *c){
+	while(c->out_sent < c->out_length){
+		ssize_t sent = send(c->fd, c->out + c->out_sent, c->out_length - c->out_sent, MSG_NOSIGNAL);
+		if(sent < 0){
+			return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+		}
+		c->out_sent += (size_t)sent;
+	}
+	return true;
+}
+
+/*
+ * Runs one request line, replying into the loop's memory stream
+ *
+ * @param loop The loop
+ * @param line The line, NUL terminated
+ * @return Whether the server should keep running
+ */
+static bool runLine(loop_t *loop, char *line){
+	if(batch_tokenize(line, loop->data, loop->max) == 0){ //Blank lines get no reply
+		return true;
+	}
+	bool active = loop->run(loop->data, loop->capture);
+	fputc('\n', loop->capture); //An empty line ends every reply
+	return active;
+}
+
+/*
+ * Runs every complete request line a connection has sent, and queues the
+ * replies to all of them at once
+ *
+ * @param loop The loop
+ * @param c The connection
+ */
+static void runRequests(loop_t *loop, connection_t *c){
+	size_t start = 0;
+	char *nl;
+	bool active = true;
+	while(active && (nl = memchr(c->in + start, '\n', c->in_length - start)) != NULL){
+		*nl = '\0';
+		active = runLine(loop, c->in + start);
+		start = (size_t)(nl - c->in) + 1;
+	}
+	if(active && c->closing && start < c->in_length){ //Last line has no newline
+		c->in[c->in_length] = '\0';
+		active = runLine(loop, c->in + start);
+		start = c->in_length;
+	}
+	if(active && c->in_length - start > SERVER_LINE_LIMIT){
+		fprintf(loop->capture, "error: request line is longer than %d bytes\n\n", SERVER_LINE_LIMIT);
+		c->closing = true;
+		start = c->in_length;
+	}
+	memmove(c->in, c->in + start, c->in_length - start);
+	c->in_length -= start;
+
+	if(!active){ //Stop every loop once this client's replies are queued
+		__atomic_store_n(loop->stopping, true, __ATOMIC_RELAXED);
+		ssize_t woken = write(loop->stop, "", 1); //One byte into an empty pipe
+		(void)woken;
+		c->closing = true;
+	}
+
+	fflush(loop->capture);
+	if(loop->captured_length > 0){
+		reply(c, loop->captured, loop->captured_length);
+		rewind(loop->capture);
+	}
+}
+
+/*
+ * Handles the events of one connection
+ *
+ * @param loop The loop
+ * @param c The connection
+ * @param events The events that happened
+ */
+static void handle(loop_t *loop, connection_t *c, uint32_t events){
+	if(events & EPOLLIN){
+		if(c->in_capacity - c->in_length < SERVER_CHUNK + 1){ //Room for a chunk and a terminator
+			c->in_capacity = c->in_capacity == 0 ? SERVER_CHUNK * 2 : c->in_capacity * 2;
+			c->in = (char *)realloc(c->in, c->in_capacity);
+			assert(c->in != NULL);
+		}
+		ssize_t got = read(c->fd, c->in + c->in_length, SERVER_CHUNK);
+		if(got < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR){
+			hangUp(loop, c);
+			return;
+		}
+		if(got == 0){ //The client is done sending
+			c->closing = true;
+		}
+		if(got > 0){
+			c->in_length += (size_t)got;
+		}
+		runRequests(loop, c);
+	}
+	else if(events & (EPOLLERR | EPOLLHUP) && !(events & EPOLLOUT)){
+		hangUp(loop, c);
+		return;
+	}
+
+	if(!flush(c)){
+		hangUp(loop, c);
+		return;
+	}
+	size_t waiting = c->out_length - c->out_sent;
+	if(c->closing && waiting == 0){
+		hangUp(loop, c);
+		return;
+	}
+	uint32_t want = waiting > 0 ? EPOLLOUT : 0;
+	if(!c->closing && waiting < SERVER_BACKLOG){
+		want |= EPOLLIN;
+	}
+	watch(loop, c, want);
+}
+
+/*
+ * Sends what each connection still has waiting, giving slow clients a
+ * moment, and closes every connection
+ *
+ * @param loop The loop
+ */
+static void hangUpAll(loop_t *loop){
+	struct timeval patience = {.tv_sec = 1, .tv_usec = 0};
+	while(loop->connections != NULL){
+		connection_t *c = loop->connections;
+		int flags = fcntl(c->fd, F_GETFL);
+		if(flags >= 0 && fcntl(c->fd, F_SETFL, flags & ~O_NONBLOCK) == 0){
+			setsockopt(c->fd, SOL_SOCKET, SO_SNDTIMEO, &patience, sizeof(patience));
+			flush(c);
+		}
+		hangUp(loop, c);
+	}
+}
+
+/*
+ * Runs one event loop until the server stops
+ *
+ * @param arg The loop, a loop_t
+ * @return NULL
+ */
+static void *serve(void *arg){
+	loop_t *loop = (loop_t *)arg;
+	struct epoll_event events[SERVER_EVENTS];
+	while(!__atomic_load_n(loop->stopping, __ATOMIC_RELAXED)){
+		int n = epoll_wait(loop->epoll, events, SERVER_EVENTS, 0);
+		if(n == 0){ //Nothing to do, so wait
+			if(loop->idle != NULL){
+				loop->idle();
+			}
+			n = epoll_wait(loop->epoll, events, SERVER_EVENTS, -1);
+		}
+		if(n < 0){
+			if(errno == EINTR){
+				continue;
+			}
+			break;
+		}
+		for(int i = 0; i < n; i++){
+			if(events[i].data.ptr == &loop->wake){ //The server is stopping
+				break;
+			}
+			if(events[i].data.ptr == &loop->listener){
+				acceptAll(loop);
+			}
+			else{
+				handle(loop, (connection_t *)events[i].data.ptr, events[i].events);
+			}
+		}
+	}
+	hangUpAll(loop);
+	return NULL;
+}
+
+bool server_run( const char* address, unsigned loops, size_t max,
+                 bool (*run)(char** data, FILE* out), void (*idle)(void) ){
+	assert(loops > 0);
+	bool is_path;
+	int listener = listenOn(address, &is_path);
+	if(listener < 0){
+		return false;
+	}
+	int stop[2];
+	if(pipe(stop) != 0){
+		close(listener);
+		if(is_path){
+			unlink(address);
+		}
+		return false;
+	}
+
+	bool stopping = false;
+	loop_t *all = (loop_t *)calloc(loops, sizeof(loop_t));
+	assert(all != NULL);
+	size_t ready = 0;
+	size_t created = 0;
+	for(size_t i = 0; i < loops; i++){
+		loop_t *loop = &all[i];
+		loop->listener = listener;
+		loop->wake = stop[0];
+		loop->stop = stop[1];
+		loop->stopping = &stopping;
+		loop->max = max;
+		loop->run = run;
+		loop->idle = idle;
+		loop->data = (char **)calloc(max, sizeof(char *));
+		loop->capture = open_memstream(&loop->captured, &loop->captured_length);
+		loop->epoll = epoll_create1(EPOLL_CLOEXEC);
+		assert(loop->data != NULL && loop->capture != NULL);
+		created++;
+
+		//Only one loop wakes for each new connection
+		struct epoll_event accept_ev = {.events = EPOLLIN | EPOLLEXCLUSIVE, .data.ptr = &loop->listener};
+		struct epoll_event wake_ev = {.events = EPOLLIN, .data.ptr = &loop->wake};
+		if(loop->epoll < 0 || epoll_ctl(loop->epoll, EPOLL_CTL_ADD, listener, &accept_ev) != 0
+				|| epoll_ctl(loop->epoll, EPOLL_CTL_ADD, stop[0], &wake_ev) != 0){
+			break;
+		}
+		ready++;
+	}
+
+	//Run the first loop on this thread, and as many others as can start
+	pthread_t *workers = (pthread_t *)malloc(loops * sizeof(pthread_t));
+	assert(workers != NULL);
+	size_t started = 1;
+	for(size_t i = 1; i < ready; i++){
+		if(pthread_create(&workers[i], NULL, serve, &all[i]) != 0){
+			break;
+		}
+		started++;
+	}
+	if(ready > 0){
+		serve(&all[0]);
+	}
+	for(size_t i = 1; i < started; i++){
+		pthread_join(workers[i], NULL);
+	}
+
+	for(size_t i = 0; i < created; i++){
+		if(all[i].epoll >= 0){
+			close(all[i].epoll);
+		}
+		fclose(all[i].capture);
+		free(all[i].captured);
+		free(all[i].data);
+	}
+	free(workers);
+	free(all);
+	close(stop[0]);
+	close(stop[1]);
+	close(listener);
+	if(is_path){
+		unlink(address);
+	}
+	return ready > 0;
+}
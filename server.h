@@ -0,0 +1,65 @@
+/// @file server.h
+/// @brief Serves the command language to clients over a local socket.
+///
+/// General Notes on server Operation
+///
+/// - The server listens on a Unix domain socket, or on a TCP port of the
+///   loopback address, and reads the same one-command-per-line language as
+///   the prompt.  Each command's results and errors go back to the client
+///   that sent it, followed by an empty line that marks the end of the
+///   reply.  Blank request lines get no reply.
+///
+/// - Each of several event loops waits on its own epoll set, takes new
+///   connections as they arrive, and keeps every connection it accepted,
+///   so one client's commands run in order on one thread while different
+///   clients' commands run side by side.
+///
+/// - Clients may pipeline: every complete line read from a connection is
+///   run before anything is written back, and the replies to all of them
+///   are sent together.  Replies a client is slow to read are kept and sent
+///   as the socket drains; a connection stops being read while more than
+///   SERVER_BACKLOG bytes of its replies wait.
+///
+/// - A client that closes its side of the connection still gets the
+///   replies to every command it sent, including a last line without a
+///   newline.
+///
+/// @author Bennett Moore bwm7637@rit.edu
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdbool.h>    // bool
+#include <stddef.h>     // size_t
+#include <stdio.h>      // FILE
+
+/// Number of bytes read from a connection at a time
+#define SERVER_CHUNK (64 * 1024)
+
+/// Longest request line a client may send
+#define SERVER_LINE_LIMIT (1024 * 1024)
+
+/// Bytes of replies a connection may have waiting before it stops being read
+#define SERVER_BACKLOG (4 * 1024 * 1024)
+
+/// Most events one event loop handles per wait
+#define SERVER_EVENTS 64
+
+/// Serve clients until a command stops the server.
+///
+/// @param address A port number to listen on the loopback address, or the
+///        path of a Unix domain socket to create
+/// @param loops The number of event loops, each on its own thread
+/// @param max The number of tokens passed to run for each command
+/// @param run Called with the tokens of each non-empty request line and the
+///        stream its reply goes to; returning false stops the server
+/// @param idle Called, if not NULL, whenever an event loop is about to wait
+///        for clients
+/// @exception Assert fails if it cannot allocate space
+/// @pre loops is not 0.
+/// @return Whether the server could listen on the address
+///
+bool server_run( const char* address, unsigned loops, size_t max,
+                 bool (*run)(char** data, FILE* out), void (*idle)(void) );
+
+#endif // SERVER_H
@@ -0,0 +1,474 @@
+/*
+ * file: snapshot.c
+ *
+ * Snapshot files. Saving writes to a temporary file that is synced and
+ * renamed over the target once complete, then syncs the directory, so a
+ * crash never leaves a torn or missing snapshot behind.
+ * Opening validates every offset and id before anything is restored, and
+ * that the handles are distinct and the friend lists are those of a simple
+ * undirected graph, each in time linear in the size of the file.
+ *
+ * @author Bennett Moore bwm7637@rit.edu
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "friends.h"
+#include "snapshot.h"
+
+#define BYTE_ORDER_MARK 0x01020304u	// Rejects files from other-endian machines
+#define WRITE_BUFFER (1024 * 1024)
+
+typedef struct header_s{
+	char magic[8];			// SNAPSHOT_MAGIC, not NUL terminated
+	uint32_t version;		// SNAPSHOT_VERSION
+	uint32_t byte_order;		// BYTE_ORDER_MARK
+	uint64_t users;			// Number of user records
+	uint64_t friendships;		// Number of friendships
+	uint64_t names;			// Number of distinct names
+	uint64_t name_bytes;		// Bytes of name text, terminators included
+	uint64_t handle_bytes;		// Bytes of handle text, terminators included
+	uint64_t reserved;		// Zero
+} header_t;
+
+typedef struct record_s{
+	uint64_t handle;		// Offset of the handle in the handle text
+	uint32_t first_name;		// Index of the first name
+	uint32_t last_name;		// Index of the last name
+} record_t;
+
+typedef struct layout_s{
+	size_t names;			// Name text
+	size_t name_offsets;		// uint64_t per name
+	size_t handles;			// Handle text
+	size_t records;			// record_t per user
+	size_t rows;			// uint64_t per user, plus one
+	size_t neighbors;		// uint32_t per friend list entry
+	size_t end;			// File size
+} layout_t;
+
+struct Snapshot_t{
+	char *map;			// The mapped file
+	size_t size;			// Size of the mapping
+	const header_t *header;
+	layout_t layout;
+};
+
+typedef struct name_slot_s{
+	const char *name;		// Interned name, NULL if the slot is empty
+	uint32_t id;			// Index of the name in the snapshot
+} name_slot_t;
+
+/*
+ * Rounds a size up to the next section boundary
+ *
+ * @param n The size
+ * @return n rounded up to a multiple of 8
+ */
+static inline size_t align8(size_t n){
+	return (n + 7) & ~(size_t)7;
+}
+
+/*
+ * Computes where each section of a snapshot starts
+ *
+ * @param h The snapshot header
+ * @param size The size of the file, used to bound the counts
+ * @param l Receives the section offsets
+ * @return Whether the counts are small enough to fit in size bytes
+ */
+static bool locate(const header_t *h, size_t size, layout_t *l){
+	if(h->users > UINT32_MAX || h->names > UINT32_MAX || h->friendships > size
+			|| h->name_bytes > size || h->handle_bytes > size){
+		return false;
+	}
+	l->names = sizeof(header_t);
+	l->name_offsets = l->names + align8((size_t)h->name_bytes);
+	l->handles = l->name_offsets + (size_t)h->names * sizeof(uint64_t);
+	l->records = l->handles + align8((size_t)h->handle_bytes);
+	l->rows = l->records + (size_t)h->users * sizeof(record_t);
+	l->neighbors = l->rows + ((size_t)h->users + 1) * sizeof(uint64_t);
+	l->end = l->neighbors + align8((size_t)h->friendships * 2 * sizeof(uint32_t));
+	return true;
+}
+
+/*
+ * Writes the zero padding that follows a section
+ *
+ * @param f The file
+ * @param len The number of bytes in the section
+ */
+static void writePadding(FILE *f, size_t len){
+	static const char zeros[8] = {0};
+	fwrite(zeros, 1, align8(len) - len, f);
+}
+
+/*
+ * Finds or adds a name in the name map built while saving
+ *
+ * @param map The name map
+ * @param mask The number of map slots minus one
+ * @param name An interned name
+ * @param count The number of names so far, incremented if name is new
+ * @return The slot for name
+ */
+static name_slot_t *nameSlot(name_slot_t *map, size_t mask, const char *name, size_t *count){
+	//Names are interned, so equal names are the same pointer
+	size_t i = (size_t)(((uint64_t)(uintptr_t)name * 0x9e3779b97f4a7c15ULL) >> 32) & mask;
+	while(map[i].name != NULL && map[i].name != name){
+		i = (i + 1) & mask;
+	}
+	if(map[i].name == NULL){
+		map[i].name = name;
+		map[i].id = (uint32_t)(*count)++;
+	}
+	return &map[i];
+}
+
+/*
+ * Checks that no two user records name the same handle
+ *
+ * @param handles The handle text
+ * @param records The user records, whose offsets are already checked
+ * @param users The number of user records
+ * @exception Assert fails if it cannot allocate space
+ * @return Whether every handle is distinct
+ */
+static bool uniqueHandles(const char *handles, const record_t *records, size_t users){
+	size_t slots = 16;
+	while(slots < users * 2){
+		slots *= 2;
+	}
+	const char **seen = (const char **)calloc(slots, sizeof(char *));
+	assert(seen != NULL);
+	bool ok = true;
+	for(size_t i = 0; ok && i < users; i++){
+		const char *handle = handles + records[i].handle;
+		uint64_t hash = 0xcbf29ce484222325ULL; //FNV-1a
+		for(const char *c = handle; *c != '\0'; c++){
+			hash = (hash ^ (unsigned char)*c) * 0x100000001b3ULL;
+		}
+		size_t slot = (size_t)hash & (slots - 1);
+		while(seen[slot] != NULL && strcmp(seen[slot], handle) != 0){
+			slot = (slot + 1) & (slots - 1);
+		}
+		ok = seen[slot] == NULL;
+		seen[slot] = handle;
+	}
+	free(seen);
+	return ok;
+}
+
+/*
+ * Checks that the friend lists describe each friendship once from each
+ * side: no list repeats an id, and every user is in the list of each user
+ * in their own list. Ids and self-friendships are already checked.
+ *
+ * @param rows Where each user's list starts, plus one past the last
+ * @param neighbors The friend lists
+ * @param users The number of users
+ * @exception Assert fails if it cannot allocate space
+ * @return Whether the lists are symmetric and free of repeats
+ */
+static bool symmetricRows(const uint64_t *rows, const uint32_t *neighbors, size_t users){
+	//Turn the lists around by counting sort: reversed[i] holds every user who lists i
+	uint64_t *starts = (uint64_t *)calloc(users + 1, sizeof(uint64_t));
+	uint32_t *reversed = (uint32_t *)malloc((size_t)(rows[users] + 1) * sizeof(uint32_t));
+	uint32_t *mark = (uint32_t *)calloc(users + 1, sizeof(uint32_t));
+	assert(starts != NULL && reversed != NULL && mark != NULL);
+	for(uint64_t j = 0; j < rows[users]; j++){
+		starts[neighbors[j] + 1]++;
+	}
+	for(size_t i = 0; i < users; i++){
+		starts[i + 1] += starts[i];
+	}
+	for(size_t i = 0; i < users; i++){ //starts[f] walks forward and ends at the start of the next list
+		for(uint64_t j = rows[i]; j < rows[i + 1]; j++){
+			reversed[starts[neighbors[j]]++] = (uint32_t)i;
+		}
+	}
+
+	//Every list has as many entries as its reverse, none twice, and holds all of them
+	bool ok = true;
+	for(size_t i = 0; ok && i < users; i++){
+		uint64_t begin = i == 0 ? 0 : starts[i - 1];
+		ok = starts[i] - begin == rows[i + 1] - rows[i];
+		for(uint64_t j = rows[i]; ok && j < rows[i + 1]; j++){
+			ok = mark[neighbors[j]] != i + 1;
+			mark[neighbors[j]] = (uint32_t)(i + 1);
+		}
+		for(uint64_t j = begin; ok && j < starts[i]; j++){
+			ok = mark[reversed[j]] == i + 1;
+		}
+	}
+	free(mark);
+	free(reversed);
+	free(starts);
+	return ok;
+}
+
+/*
+ * Syncs the directory holding a file, so a rename into it survives a crash
+ *
+ * @param path The file
+ * @return Whether the directory was synced
+ */
+static bool syncDirectory(const char *path){
+	const char *slash = strrchr(path, '/');
+	char *dir;
+	if(slash == NULL){
+		dir = strdup(".");
+	}
+	else{
+		size_t len = slash == path ? 1 : (size_t)(slash - path); //The root keeps its slash
+		dir = strndup(path, len);
+	}
+	assert(dir != NULL);
+	int fd = open(dir, O_RDONLY);
+	free(dir);
+	if(fd < 0){
+		return false;
+	}
+	bool ok = fsync(fd) == 0 || errno == EINVAL; //Some file systems cannot sync a directory
+	close(fd);
+	return ok;
+}
+
+bool snapshot_save( const char* path, person_t** users, size_t count, size_t friendships ){
+	//Give every distinct name an index, in order of first use
+	size_t slots = 16;
+	while(slots < count * 4){
+		slots *= 2;
+	}
+	name_slot_t *map = (name_slot_t *)calloc(slots, sizeof(name_slot_t));
+	const char **names = (const char **)malloc((count * 2 + 1) * sizeof(char *));
+	record_t *records = (record_t *)malloc((count + 1) * sizeof(record_t));
+	assert(map != NULL && names != NULL && records != NULL);
+
+	header_t h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic));
+	h.version = SNAPSHOT_VERSION;
+	h.byte_order = BYTE_ORDER_MARK;
+	h.users = count;
+	h.friendships = friendships;
+
+	size_t name_count = 0;
+	for(size_t i = 0; i < count; i++){
+		const char *parts[] = {users[i]->first_name, users[i]->last_name};
+		uint32_t ids[2];
+		for(int j = 0; j < 2; j++){
+			size_t before = name_count;
+			name_slot_t *slot = nameSlot(map, slots - 1, parts[j], &name_count);
+			if(name_count > before){
+				names[slot->id] = parts[j];
+				h.name_bytes += strlen(parts[j]) + 1;
+			}
+			ids[j] = slot->id;
+		}
+		records[i].handle = h.handle_bytes;
+		records[i].first_name = ids[0];
+		records[i].last_name = ids[1];
+		h.handle_bytes += strlen(users[i]->handle) + 1;
+	}
+	h.names = name_count;
+
+	//Write everything to a temporary file, then move it into place
+	size_t len = strlen(path);
+	char *temp = (char *)malloc(len + 5);
+	assert(temp != NULL);
+	memcpy(temp, path, len);
+	memcpy(temp + len, ".tmp", 5);
+	FILE *f = fopen(temp, "wb");
+	bool ok = f != NULL;
+	if(ok){
+		setvbuf(f, NULL, _IOFBF, WRITE_BUFFER);
+		fwrite(&h, sizeof(h), 1, f);
+
+		uint64_t offset = 0;
+		for(size_t i = 0; i < name_count; i++){
+			fwrite(names[i], 1, strlen(names[i]) + 1, f);
+		}
+		writePadding(f, (size_t)h.name_bytes);
+		for(size_t i = 0; i < name_count; i++){
+			fwrite(&offset, sizeof(offset), 1, f);
+			offset += strlen(names[i]) + 1;
+		}
+
+		for(size_t i = 0; i < count; i++){
+			fwrite(users[i]->handle, 1, strlen(users[i]->handle) + 1, f);
+		}
+		writePadding(f, (size_t)h.handle_bytes);
+		if(count > 0){
+			fwrite(records, sizeof(record_t), count, f);
+		}
+
+		offset = 0;
+		fwrite(&offset, sizeof(offset), 1, f);
+		for(size_t i = 0; i < count; i++){
+			offset += users[i]->friend_count;
+			fwrite(&offset, sizeof(offset), 1, f);
+		}
+		for(size_t i = 0; i < count; i++){ //Lists are already ids
+			if(users[i]->friend_count > 0){
+				fwrite(users[i]->friends, sizeof(uint32_t), users[i]->friend_count, f);
+			}
+		}
+		writePadding(f, (size_t)offset * sizeof(uint32_t));
+
+		ok = !ferror(f) && offset == friendships * 2;
+		ok = ok && fflush(f) == 0 && fsync(fileno(f)) == 0; //The contents must be on disk before the name is
+		ok = fclose(f) == 0 && ok;
+		ok = ok && rename(temp, path) == 0;
+		if(!ok){
+			remove(temp);
+		}
+		ok = ok && syncDirectory(path);
+	}
+
+	free(temp);
+	free(records);
+	free(names);
+	free(map);
+	return ok;
+}
+
+Snapshot snapshot_open( const char* path ){
+	int fd = open(path, O_RDONLY);
+	if(fd < 0){
+		return NULL;
+	}
+	struct stat st;
+	if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(header_t)){
+		close(fd);
+		return NULL;
+	}
+	size_t size = (size_t)st.st_size;
+	char *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED){
+		return NULL;
+	}
+	posix_madvise(map, size, POSIX_MADV_SEQUENTIAL);
+
+	Snapshot s = (Snapshot)calloc(1, sizeof(struct Snapshot_t));
+	assert(s != NULL);
+	s->map = map;
+	s->size = size;
+	s->header = (const header_t *)map;
+	const header_t *h = s->header;
+
+	//Check the header, then every offset and id the restore will follow
+	bool ok = memcmp(h->magic, SNAPSHOT_MAGIC, sizeof(h->magic)) == 0
+		&& h->version == SNAPSHOT_VERSION && h->byte_order == BYTE_ORDER_MARK
+		&& locate(h, size, &s->layout) && s->layout.end == size;
+	const layout_t *l = &s->layout;
+	if(ok && h->name_bytes > 0){
+		ok = map[l->names + h->name_bytes - 1] == '\0';
+	}
+	if(ok && h->handle_bytes > 0){
+		ok = map[l->handles + h->handle_bytes - 1] == '\0';
+	}
+	const uint64_t *offsets = (const uint64_t *)(map + l->name_offsets);
+	for(size_t i = 0; ok && i < h->names; i++){
+		ok = offsets[i] < h->name_bytes;
+	}
+	const record_t *records = (const record_t *)(map + l->records);
+	for(size_t i = 0; ok && i < h->users; i++){
+		ok = records[i].handle < h->handle_bytes && records[i].first_name < h->names
+			&& records[i].last_name < h->names;
+	}
+	const uint64_t *rows = (const uint64_t *)(map + l->rows);
+	ok = ok && rows[0] == 0 && rows[h->users] == h->friendships * 2;
+	for(size_t i = 0; ok && i < h->users; i++){
+		ok = rows[i] <= rows[i + 1];
+	}
+	const uint32_t *neighbors = (const uint32_t *)(map + l->neighbors);
+	for(size_t i = 0; ok && i < h->users; i++){
+		for(uint64_t j = rows[i]; ok && j < rows[i + 1]; j++){
+			ok = neighbors[j] < h->users && neighbors[j] != i;
+		}
+	}
+	ok = ok && uniqueHandles(map + l->handles, records, (size_t)h->users);
+	ok = ok && symmetricRows(rows, neighbors, (size_t)h->users);
+
+	if(!ok){
+		snapshot_close(s);
+		return NULL;
+	}
+	return s;
+}
+
+size_t snapshot_users( const Snapshot s ){
+	return (size_t)s->header->users;
+}
+
+size_t snapshot_friendships( const Snapshot s ){
+	return (size_t)s->header->friendships;
+}
+
+void snapshot_restore( const Snapshot s, Arena a, Table t, person_t*** users, size_t* capacity ){
+	const header_t *h = s->header;
+	const layout_t *l = &s->layout;
+	size_t count = (size_t)h->users;
+	const uint64_t *offsets = (const uint64_t *)(s->map + l->name_offsets);
+	const record_t *records = (const record_t *)(s->map + l->records);
+	const uint64_t *rows = (const uint64_t *)(s->map + l->rows);
+	const uint32_t *neighbors = (const uint32_t *)(s->map + l->neighbors);
+
+	//Names are interned so later adds keep sharing them
+	char **names = (char **)malloc((size_t)(h->names + 1) * sizeof(char *));
+	assert(names != NULL);
+	for(size_t i = 0; i < h->names; i++){
+		names[i] = arena_intern(a, s->map + l->names + offsets[i]);
+	}
+
+	//Handles and records are each copied or carved in one block
+	char *handles = NULL;
+	person_t *people = NULL;
+	if(count > 0){
+		handles = (char *)arena_alloc(a, (size_t)h->handle_bytes);
+		memcpy(handles, s->map + l->handles, (size_t)h->handle_bytes);
+		people = (person_t *)arena_alloc(a, count * sizeof(person_t));
+		memset(people, 0, count * sizeof(person_t));
+	}
+
+	*capacity = 16;
+	while(*capacity < count){
+		*capacity *= 2;
+	}
+	*users = (person_t **)arena_alloc(a, *capacity * sizeof(person_t *));
+	ht_reserve(t, count);
+
+	for(size_t i = 0; i < count; i++){
+		person_t *p = &people[i];
+		p->first_name = names[records[i].first_name];
+		p->last_name = names[records[i].last_name];
+		p->handle = handles + records[i].handle;
+		p->id = (uint32_t)i;
+		(*users)[i] = p;
+		ht_put(t, p->handle, p);
+	}
+
+	for(size_t i = 0; i < count; i++){ //Rows are already lists of ids
+		friends_assign(a, &people[i], neighbors + rows[i], (size_t)(rows[i + 1] - rows[i]));
+	}
+
+	free(names);
+}
+
+void snapshot_close( Snapshot s ){
+	munmap(s->map, s->size);
+	free(s);
+}
@@ -0,0 +1,95 @@
+/// @file snapshot.h
+/// @brief Binary snapshots of the whole network.
+///
+/// A snapshot file holds every user and friend list in a compact,
+/// versioned layout that is read back through a memory mapping:
+///
+/// - A fixed header with a magic string, format version and counts.
+/// - The distinct first and last names, stored once each.
+/// - All handles, back to back.
+/// - One fixed-size record per user, giving the user's handle and names.
+/// - Friend lists as a row offset table followed by dense 32-bit user ids.
+///
+/// Every section starts on an 8 byte boundary.  Restoring a snapshot is a
+/// sequential pass over the mapping: handles are copied in one block, and
+/// each friend list is sized exactly once.
+///
+/// @author Bennett Moore bwm7637@rit.edu
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdbool.h>    // bool
+#include <stddef.h>     // size_t
+
+#include "arena.h"
+#include "person.h"
+#include "table.h"
+
+/// Identifies a snapshot file
+#define SNAPSHOT_MAGIC "AMICISNP"
+
+/// Current snapshot format version
+#define SNAPSHOT_VERSION 1
+
+/// The Snapshot data type is a pointer to an opaque structure describing
+/// an open, validated snapshot file.
+typedef struct Snapshot_t * Snapshot;
+
+/// Write the network to a snapshot file.
+///
+/// @param path The file to write
+/// @param users Every user, indexed by id
+/// @param count The number of users
+/// @param friendships The number of friendships
+/// @pre users[i]->id == i for every user.
+/// @return Whether the whole snapshot was written and synced to disk, with
+///         its directory, so it survives a crash
+///
+bool snapshot_save( const char* path, person_t** users, size_t count, size_t friendships );
+
+/// Map a snapshot file and check that it is well formed.
+///
+/// @param path The file to read
+/// @return The open snapshot, or NULL if the file is missing, truncated,
+///         corrupt or from an unsupported version, or if two users share a
+///         handle or the friend lists repeat a friend, list the user
+///         themselves or name a friendship from one side only
+///
+Snapshot snapshot_open( const char* path );
+
+/// Get the number of users in an open snapshot.
+///
+/// @param s The snapshot
+/// @return The number of users
+///
+size_t snapshot_users( const Snapshot s );
+
+/// Get the number of friendships in an open snapshot.
+///
+/// @param s The snapshot
+/// @return The number of friendships
+///
+size_t snapshot_friendships( const Snapshot s );
+
+/// Rebuild the network stored in a snapshot.
+///
+/// @param s The snapshot
+/// @param a The arena that will own every restored record
+/// @param t The table that receives every restored user
+/// @param users Receives snapshot_users(s) users indexed by id; the array
+///        is allocated from a with room for capacity entries
+/// @param capacity Receives the capacity of the users array
+/// @exception Assert fails if it cannot allocate space
+/// @pre t is empty.
+///
+void snapshot_restore( const Snapshot s, Arena a, Table t, person_t*** users, size_t* capacity );
+
+/// Unmap a snapshot file.
+///
+/// @param s The snapshot
+/// @post s is not a valid instance of snapshot.
+///
+void snapshot_close( Snapshot s );
+
+#endif // SNAPSHOT_H
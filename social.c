@@ -0,0 +1,155 @@
+/*
+ * file: social.c
+ *
+ * Friend-of-friend queries. Suggestion candidates are counted in a
+ * temporary hash map sized to the friends-of-friends actually visited, but
+ * never more than twice the number of users, since each is a key at most once, and
+ * the best k are kept in a bounded min-heap whose root is the weakest.
+ *
+ * @author Bennett Moore bwm7637@rit.edu
+ */
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "friends.h"
+#include "intersect.h"
+#include "social.h"
+
+typedef struct count_s{
+	uint32_t key;			// Candidate id plus one, 0 if the slot is empty
+	uint32_t count;			// Friends of the user who know the candidate
+} count_t;
+
+/*
+ * Checks whether one suggestion ranks below another
+ *
+ * @param a The first suggestion
+ * @param b The second suggestion
+ * @return Whether a has fewer mutual friends, or as many and a larger id
+ */
+static inline bool weaker(const suggestion_t *a, const suggestion_t *b){
+	return a->mutual < b->mutual || (a->mutual == b->mutual && a->id > b->id);
+}
+
+/*
+ * Restores the heap order below a node of the suggestion heap
+ *
+ * @param heap The heap, weakest suggestion at the root
+ * @param n The number of suggestions in the heap
+ * @param i The node to sift down
+ */
+static void siftDown(suggestion_t *heap, size_t n, size_t i){
+	while(true){
+		size_t least = i;
+		size_t l = 2 * i + 1;
+		size_t r = l + 1;
+		if(l < n && weaker(&heap[l], &heap[least])){
+			least = l;
+		}
+		if(r < n && weaker(&heap[r], &heap[least])){
+			least = r;
+		}
+		if(least == i){
+			return;
+		}
+		suggestion_t swap = heap[i];
+		heap[i] = heap[least];
+		heap[least] = swap;
+		i = least;
+	}
+}
+
+/*
+ * Orders suggestions strongest first for qsort
+ *
+ * @param x The first suggestion
+ * @param y The second suggestion
+ * @return Negative if x ranks above y
+ */
+static int strongestFirst(const void *x, const void *y){
+	const suggestion_t *a = (const suggestion_t *)x;
+	const suggestion_t *b = (const suggestion_t *)y;
+	return weaker(a, b) - weaker(b, a);
+}
+
+size_t social_mutual( const person_t* p1, const person_t* p2, const Csr frozen, uint32_t** out ){
+	size_t n1 = p1->friend_count;
+	size_t n2 = p2->friend_count;
+	*out = (uint32_t *)malloc(((n1 < n2 ? n1 : n2) + 1) * sizeof(uint32_t));
+	assert(*out != NULL);
+
+	if(frozen != NULL){
+		return intersect_sorted(csr_sorted(frozen, p1->id), n1, csr_sorted(frozen, p2->id), n2, *out);
+	}
+
+	size_t n = friends_common(p1, p2, *out);
+	intersect_sort(*out, n);
+	return n;
+}
+
+size_t social_suggest( const person_t* p1, person_t** users, size_t people, const Csr frozen, size_t k,
+                       suggestion_t** out ){
+	//Size the map for every friend of a friend that could be visited, or for every user if fewer
+	size_t visits = 0;
+	for(size_t i = 0; i < p1->friend_count; i++){
+		visits += users[p1->friends[i]]->friend_count;
+	}
+	size_t capacity = 16;
+	while(capacity < visits * 2 && capacity < people * 2){
+		capacity *= 2;
+	}
+	size_t mask = capacity - 1;
+	count_t *counts = (count_t *)calloc(capacity, sizeof(count_t));
+	assert(counts != NULL);
+
+	for(size_t i = 0; i < p1->friend_count; i++){
+		const person_t *f = users[p1->friends[i]];
+		const uint32_t *row = frozen != NULL ? csr_neighbors(frozen, f->id) : NULL;
+		for(size_t j = 0; j < f->friend_count; j++){
+			uint32_t id = row != NULL ? row[j] : f->friends[j];
+			size_t slot = ((size_t)id * 0x9e3779b1u) & mask;
+			while(counts[slot].key != 0 && counts[slot].key != id + 1){
+				slot = (slot + 1) & mask;
+			}
+			counts[slot].key = id + 1;
+			counts[slot].count++;
+		}
+	}
+
+	//Keep the k strongest candidates who are not the user or a friend already
+	suggestion_t *heap = (suggestion_t *)malloc((k + 1) * sizeof(suggestion_t));
+	assert(heap != NULL);
+	size_t n = 0;
+	for(size_t slot = 0; slot < capacity && k > 0; slot++){
+		if(counts[slot].key == 0){
+			continue;
+		}
+		suggestion_t s = {counts[slot].key - 1, counts[slot].count};
+		if(n == k && !weaker(&heap[0], &s)){
+			continue;
+		}
+		const person_t *candidate = users[s.id];
+		if(candidate == p1 || friends_has(p1, candidate)){
+			continue;
+		}
+		if(n < k){ //Heap is not full yet
+			heap[n++] = s;
+			if(n == k){
+				for(size_t i = k / 2; i-- > 0; ){
+					siftDown(heap, n, i);
+				}
+			}
+		}
+		else{ //Replace the weakest
+			heap[0] = s;
+			siftDown(heap, n, 0);
+		}
+	}
+
+	free(counts);
+	qsort(heap, n, sizeof(suggestion_t), strongestFirst);
+	*out = heap;
+	return n;
+}
@@ -0,0 +1,57 @@
+/// @file social.h
+/// @brief Mutual friend and friend suggestion queries.
+///
+/// Both queries read the frozen graph when one is given, intersecting its
+/// id-sorted friend lists, and otherwise probe the person_t friend lists,
+/// which answer membership in constant time.  Either way, mutual friends
+/// cost time proportional to the shorter of the two friend lists.
+///
+/// @author Bennett Moore bwm7637@rit.edu
+
+#ifndef SOCIAL_H
+#define SOCIAL_H
+
+#include <stddef.h>     // size_t
+#include <stdint.h>     // uint32_t
+
+#include "csr.h"
+#include "person.h"
+
+/// Number of suggestions made when none is asked for
+#define SOCIAL_SUGGESTIONS 10
+
+/// A suggested friend
+typedef struct suggestion_s{
+	uint32_t id;			// The suggested user
+	uint32_t mutual;		// Number of friends in common
+} suggestion_t;
+
+/// Find the friends two users have in common.
+///
+/// @param p1 The first user
+/// @param p2 The second user
+/// @param frozen The frozen graph, or NULL if the network has changed since
+/// @param out Receives the ids of the common friends in increasing order;
+///        the caller frees the array
+/// @exception Assert fails if it cannot allocate space
+/// @return The number of common friends
+///
+size_t social_mutual( const person_t* p1, const person_t* p2, const Csr frozen, uint32_t** out );
+
+/// Rank the friends of a user's friends by how many friends they share
+/// with the user.
+///
+/// @param p1 The user
+/// @param users Every user, indexed by id
+/// @param people The number of users
+/// @param frozen The frozen graph, or NULL if the network has changed since
+/// @param k The most suggestions to make
+/// @param out Receives the suggestions, most mutual friends first and
+///        then by id; the caller frees the array
+/// @exception Assert fails if it cannot allocate space
+/// @return The number of suggestions, at most k
+///
+size_t social_suggest( const person_t* p1, person_t** users, size_t people, const Csr frozen, size_t k,
+                       suggestion_t** out );
+
+#endif // SOCIAL_H
@@ -0,0 +1,402 @@
+/*
+ * file: table.c
+ *
+ * Open-addressing handle table. Slots are probed a group of GROUP_WIDTH
+ * control bytes at a time; each control byte holds either a marker for an
+ * empty/deleted slot or the low 7 bits of the hash of the key stored there.
+ *
+ * @author Bennett Moore bwm7637@rit.edu
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "table.h"
+
+#define CTRL_EMPTY ((int8_t)-128)	// Slot has never held a key
+#define CTRL_DELETED ((int8_t)-2)	// Slot held a key that was removed
+
+typedef struct slot_s{
+	size_t hash;			// Full hash of the key
+	char *key;			// Handle
+	person_t *value;		// Person owning the handle
+} slot_t;
+
+struct Table_t{
+	int8_t *ctrl;			// One control byte per slot
+	slot_t *slots;			// Key/value storage
+	size_t capacity;		// Number of slots, a multiple of GROUP_WIDTH
+	size_t size;			// Number of live entries
+	size_t deleted;			// Number of tombstones
+	size_t collisions;		// Groups probed past an entry's home group
+	size_t rehashes;		// Number of times the slots were rebuilt
+	void (*print)(const char* key, const person_t* value);
+	void (*delete)(char* key, person_t* value);
+};
+
+
+/*
+ * Hashes a handle
+ *
+ * @param key The handle to hash
+ * @return A well-mixed 64-bit hash of the handle
+ */
+static size_t hashKey(const char *key){
+	uint64_t h = 0xcbf29ce484222325ULL;
+	for(const unsigned char *c = (const unsigned char *)key; *c != '\0'; c++){
+		h = (h ^ *c) * 0x100000001b3ULL;
+	}
+
+	//Finalize so both the tag bits and the group bits are well distributed
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	return (size_t)h;
+}
+
+/*
+ * Extracts the 7-bit tag stored in a control byte
+ *
+ * @param hash A key's hash
+ * @return The tag for the key
+ */
+static inline int8_t hashTag(size_t hash){
+	return (int8_t)(hash & 0x7f);
+}
+
+/*
+ * Builds a bitmask of the control bytes in a group that equal a value
+ *
+ * @param group The first control byte of the group
+ * @param value The control byte to look for
+ * @return Bit i is set if group[i] == value
+ */
+static inline unsigned groupMatch(const int8_t *group, int8_t value){
+#ifdef __SSE2__
+	__m128i ctrl = _mm_load_si128((const __m128i *)group);
+	return (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(value)));
+#else
+	unsigned mask = 0;
+	for(int i = 0; i < GROUP_WIDTH; i++){
+		mask |= (unsigned)(group[i] == value) << i;
+	}
+	return mask;
+#endif
+}
+
+/*
+ * Builds a bitmask of the slots in a group that are empty or deleted
+ *
+ * @param group The first control byte of the group
+ * @return Bit i is set if slot i of the group holds no key
+ */
+static inline unsigned groupFree(const int8_t *group){
+#ifdef __SSE2__
+	//Both markers are negative, live tags never are
+	return (unsigned)_mm_movemask_epi8(_mm_load_si128((const __m128i *)group));
+#else
+	unsigned mask = 0;
+	for(int i = 0; i < GROUP_WIDTH; i++){
+		mask |= (unsigned)(group[i] < 0) << i;
+	}
+	return mask;
+#endif
+}
+
+/*
+ * Allocates empty slot storage for a table
+ *
+ * @param t The table
+ * @param capacity The number of slots to allocate
+ * @pre capacity is GROUP_WIDTH times a power of two
+ */
+static void allocSlots(Table t, size_t capacity){
+	t->ctrl = (int8_t *)aligned_alloc(GROUP_WIDTH, capacity);
+	t->slots = (slot_t *)malloc(capacity * sizeof(slot_t));
+	assert(t->ctrl != NULL && t->slots != NULL);
+	memset(t->ctrl, CTRL_EMPTY, capacity);
+	t->capacity = capacity;
+	t->size = 0;
+	t->deleted = 0;
+}
+
+/*
+ * Finds the slot holding a key
+ *
+ * @param t The table
+ * @param key The key to look for
+ * @param hash The hash of key
+ * @return The index of the key's slot, or t->capacity if it is absent
+ */
+static size_t findSlot(const Table t, const char *key, size_t hash){
+	size_t mask = t->capacity / GROUP_WIDTH - 1;
+	size_t group = (hash >> 7) & mask;
+	int8_t tag = hashTag(hash);
+
+	for(size_t step = 1; step <= mask + 1; step++){
+		const int8_t *ctrl = t->ctrl + group * GROUP_WIDTH;
+		for(unsigned match = groupMatch(ctrl, tag); match != 0; match &= match - 1){
+			size_t i = group * GROUP_WIDTH + (size_t)__builtin_ctz(match);
+			if(t->slots[i].hash == hash && strcmp(t->slots[i].key, key) == 0){
+				return i;
+			}
+		}
+		if(groupMatch(ctrl, CTRL_EMPTY) != 0){ //Key would have been placed here
+			return t->capacity;
+		}
+		group = (group + step) & mask; //Triangular probing visits every group
+	}
+	return t->capacity;
+}
+
+/*
+ * Finds a free slot for a key known not to be in the table
+ *
+ * @param t The table
+ * @param hash The hash of the key
+ * @return The index of the first empty or deleted slot on the key's probe sequence
+ */
+static size_t freeSlot(Table t, size_t hash){
+	size_t mask = t->capacity / GROUP_WIDTH - 1;
+	size_t group = (hash >> 7) & mask;
+
+	for(size_t step = 1; ; step++){
+		unsigned avail = groupFree(t->ctrl + group * GROUP_WIDTH);
+		if(avail != 0){
+			return group * GROUP_WIDTH + (size_t)__builtin_ctz(avail);
+		}
+		t->collisions++;
+		group = (group + step) & mask;
+	}
+}
+
+/*
+ * Rebuilds the slot storage, dropping tombstones and optionally growing
+ *
+ * @param t The table
+ * @param capacity The new number of slots
+ */
+static void rehash(Table t, size_t capacity){
+	int8_t *old_ctrl = t->ctrl;
+	slot_t *old_slots = t->slots;
+	size_t old_capacity = t->capacity;
+	size_t size = t->size;
+
+	allocSlots(t, capacity);
+	for(size_t i = 0; i < old_capacity; i++){
+		if(old_ctrl[i] >= 0){ //Stored hashes are reused, keys are never rehashed
+			size_t j = freeSlot(t, old_slots[i].hash);
+			t->ctrl[j] = old_ctrl[i];
+			t->slots[j] = old_slots[i];
+		}
+	}
+	t->size = size;
+	t->rehashes++;
+
+	free(old_ctrl);
+	free(old_slots);
+}
+
+Table ht_create(void (*print)(const char* key, const person_t* value),
+                void (*delete)(char* key, person_t* value) ){
+	assert(print != NULL);
+	Table t = (Table)calloc(1, sizeof(struct Table_t));
+	assert(t != NULL);
+	allocSlots(t, INITIAL_CAPACITY);
+	t->print = print;
+	t->delete = delete;
+	return t;
+}
+
+void ht_destroy( Table t ){
+	if(t->delete != NULL){
+		for(size_t i = 0; i < t->capacity; i++){
+			if(t->ctrl[i] >= 0){
+				t->delete(t->slots[i].key, t->slots[i].value);
+			}
+		}
+	}
+	free(t->ctrl);
+	free(t->slots);
+	free(t);
+}
+
+void ht_dump( const Table t, bool full ){
+	printf("Size: %zu\n", t->size);
+	printf("Capacity: %zu\n", t->capacity);
+	printf("Collisions: %zu\n", t->collisions);
+	printf("Rehashes: %zu\n", t->rehashes);
+	if(full){
+		for(size_t i = 0; i < t->capacity; i++){
+			if(t->ctrl[i] >= 0){
+				printf("%zu: ", i);
+				t->print(t->slots[i].key, t->slots[i].value);
+			}
+		}
+	}
+}
+
+void ht_stats( const Table t, ht_stats_t* stats ){
+	memset(stats, 0, sizeof(ht_stats_t));
+	stats->size = t->size;
+	stats->capacity = t->capacity;
+	stats->deleted = t->deleted;
+	stats->collisions = t->collisions;
+	stats->rehashes = t->rehashes;
+
+	size_t mask = t->capacity / GROUP_WIDTH - 1;
+	for(size_t i = 0; i < t->capacity; i++){
+		if(t->ctrl[i] < 0){
+			continue;
+		}
+		//Walk the entry's probe sequence until it reaches the entry's group
+		size_t group = (t->slots[i].hash >> 7) & mask;
+		size_t step = 1;
+		while(group != i / GROUP_WIDTH){
+			group = (group + step) & mask;
+			step++;
+		}
+		stats->probes[step <= HT_PROBE_BUCKETS ? step - 1 : HT_PROBE_BUCKETS - 1]++;
+	}
+}
+
+person_t* ht_get( const Table t, const char* key ){
+	assert(key != NULL);
+	size_t i = findSlot(t, key, hashKey(key));
+	assert(i < t->capacity);
+	return t->slots[i].value;
+}
+
+person_t* ht_find( const Table t, const char* key ){
+	assert(key != NULL);
+	size_t i = findSlot(t, key, hashKey(key));
+	return i < t->capacity ? t->slots[i].value : NULL;
+}
+
+bool ht_has( const Table t, const char* key ){
+	assert(key != NULL);
+	return findSlot(t, key, hashKey(key)) < t->capacity;
+}
+
+/*
+ * Stores a key known not to be in the table
+ *
+ * @param t The table
+ * @param key The key
+ * @param hash The hash of key
+ * @param value The value
+ */
+static void insert(Table t, const char *key, size_t hash, person_t *value){
+	if((t->size + t->deleted + 1) * LOAD_DENOMINATOR > t->capacity * LOAD_NUMERATOR){
+		if(t->deleted > t->size / 2){ //Mostly tombstones, clean up in place
+			rehash(t, t->capacity);
+		}
+		else{
+			rehash(t, t->capacity * RESIZE_FACTOR);
+		}
+	}
+
+	size_t i = freeSlot(t, hash);
+	if(t->ctrl[i] == CTRL_DELETED){
+		t->deleted--;
+	}
+	t->ctrl[i] = hashTag(hash);
+	t->slots[i].hash = hash;
+	t->slots[i].key = (char *)key;
+	t->slots[i].value = value;
+	t->size++;
+}
+
+person_t* ht_put( Table t, const char* key, person_t* value ){
+	assert(key != NULL && value != NULL);
+	size_t hash = hashKey(key);
+	size_t i = findSlot(t, key, hash);
+
+	if(i < t->capacity){ //Update an existing key
+		person_t *old = t->slots[i].value;
+		t->slots[i].key = (char *)key;
+		t->slots[i].value = value;
+		return old;
+	}
+	insert(t, key, hash, value);
+	return NULL;
+}
+
+person_t* ht_try_insert( Table t, const char* key, person_t* value ){
+	assert(key != NULL && value != NULL);
+	size_t hash = hashKey(key);
+	size_t i = findSlot(t, key, hash);
+	if(i < t->capacity){ //Leave the existing key alone
+		return t->slots[i].value;
+	}
+	insert(t, key, hash, value);
+	return NULL;
+}
+
+void ht_reserve( Table t, size_t count ){
+	size_t capacity = t->capacity;
+	while((count + t->deleted) * LOAD_DENOMINATOR > capacity * LOAD_NUMERATOR){
+		capacity *= RESIZE_FACTOR;
+	}
+	if(capacity != t->capacity){
+		rehash(t, capacity);
+	}
+}
+
+person_t* ht_remove( Table t, const char* key ){
+	assert(key != NULL);
+	size_t i = findSlot(t, key, hashKey(key));
+	if(i == t->capacity){
+		return NULL;
+	}
+
+	//A group with an empty slot never continues a probe sequence, so the
+	//slot can be emptied outright; otherwise leave a tombstone
+	size_t group = i - i % GROUP_WIDTH;
+	if(groupMatch(t->ctrl + group, CTRL_EMPTY) != 0){
+		t->ctrl[i] = CTRL_EMPTY;
+	}
+	else{
+		t->ctrl[i] = CTRL_DELETED;
+		t->deleted++;
+	}
+	t->size--;
+	return t->slots[i].value;
+}
+
+size_t ht_size( const Table t ){
+	return t->size;
+}
+
+char** ht_keys( const Table t ){
+	char **keys = (char **)malloc((t->size + 1) * sizeof(char *));
+	assert(keys != NULL);
+	size_t n = 0;
+	for(size_t i = 0; i < t->capacity; i++){
+		if(t->ctrl[i] >= 0){
+			keys[n++] = t->slots[i].key;
+		}
+	}
+	return keys;
+}
+
+person_t** ht_values( const Table t ){
+	person_t **values = (person_t **)malloc((t->size + 1) * sizeof(person_t *));
+	assert(values != NULL);
+	size_t n = 0;
+	for(size_t i = 0; i < t->capacity; i++){
+		if(t->ctrl[i] >= 0){
+			values[n++] = t->slots[i].value;
+		}
+	}
+	return values;
+}
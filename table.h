@@ -1,9 +1,15 @@
 /// @file table.h
-/// @brief A generic hash table data structure.
+/// @brief An open-addressing hash table mapping user handles to people.
+///
+/// Replaces the generic chained table provided with the assignment. Keys
+/// are always C-string handles and values are always person_t records, so
+/// hashing and comparison are done inline instead of through function
+/// pointers.
 ///
 /// @author Sean Strout (RIT CS)
 /// @author bksteele (RIT CS)
 /// @author Warren R. Carithers (RIT CS)
+/// @author Bennett Moore bwm7637@rit.edu
 
 #ifndef TABLE_H
 #define TABLE_H
@@ -11,64 +17,77 @@
 #include <stdbool.h>    // bool
 #include <stddef.h>     // size_t
 
-/// Initial capacity of table upon creation
+#include "person.h"
+
+/// Initial capacity of table upon creation (a multiple of GROUP_WIDTH)
 #define INITIAL_CAPACITY 16
 
-/// The load at which the table will rehash
-#define LOAD_THRESHOLD 0.75
+/// Number of control bytes examined by a single probe
+#define GROUP_WIDTH 16
+
+/// The table rehashes once live and deleted slots exceed 7/8 of capacity
+#define LOAD_NUMERATOR 7
+#define LOAD_DENOMINATOR 8
 
-/// The table size will double upon each rehash
+/// The table size will double upon each growing rehash
 #define RESIZE_FACTOR 2
 
+/// Number of probe lengths counted by ht_stats; the last counts the rest
+#define HT_PROBE_BUCKETS 8
+
 /// The Table data type is a pointer to an opaque structure; clients
 /// cannot see all the structure's content.
 ///
 /// General Notes on hash table Operation
 ///
-/// - The operations identified below are the public interface to HashADT.
-///   The client supplies functions for hashing the key, checking equality
-///   of keys, printing keys, and deleting (key, value) pairs.
+/// - Slots live in one flat array next to a parallel array of one-byte
+///   control tags. A lookup hashes the key once, then compares a whole
+///   group of GROUP_WIDTH tags at a time (with SSE2 when available) and
+///   only touches slots whose 7-bit tag matches.
+///
+/// - Every slot remembers the full hash of its key, so keys are never
+///   rehashed when the table grows, and full string comparisons only run
+///   on slots whose stored hash matches.
 ///
 /// - The table takes ownership of inserted keys and values.  It operates
 ///   under the assumption that all pointers given to it are dynamically
 ///   allocated, and should be returned to the free pool by the table.
 ///
-/// - The ht_delete() function can free the (key, value) pair automatically.
+/// - The ht_destroy() function can free the (key, value) pair automatically.
 ///   If this is not desired, the client should pass a NULL pointer for the
 ///   delete function when ht_create() is called.
 ///
-/// - There is no remove functionality. Entries remain until you call
-///   ht_destroy().
+/// - ht_remove() takes an entry out of the table and hands ownership of
+///   the (key, value) pair back to the client without deleting it.
 ///
 /// - Wherever a function has a precondition, and the client violates the
 ///   condition, and the code detects the violation, then the function will
 ///   assert failure and abort.
 ///
-/// - Wherever a function has a postcondition, and the client violates the
-///   condition, and the code detects the violation, then the function will
-///   assert failure and abort.
-///
 typedef struct Table_t * Table;
 
+/// The shape of a table, as reported by ht_stats()
+typedef struct ht_stats_s{
+	size_t size;			// Number of live entries
+	size_t capacity;		// Number of slots
+	size_t deleted;			// Number of tombstones
+	size_t collisions;		// Groups probed past an entry's home group
+	size_t rehashes;		// Number of times the slots were rebuilt
+	size_t probes[HT_PROBE_BUCKETS];	// Entries found after probing 1, 2, ... groups
+} ht_stats_t;
+
 /// Create a new hash table instance.
 /// If delete is NULL, supply no-op function for (key, value) pair deletion.
 ///
-/// @param hash The hash function for key data
-/// @param equals The equal function for key comparison
 /// @param print The print function for (key, value) pairs is used by dump().
 /// @param delete The delete function for (key, value) pairs is used by
 ////       destroy().
 /// @exception Assert fails if it cannot allocate space
-/// @pre hash, equals and print are valid function pointers.
+/// @pre print is a valid function pointer.
 /// @return A newly created table
 ///
-Table ht_create(size_t (*hash)(const void* key),
-                // equals(k,k)
-                bool (*equals)(const void* key1, const void* key2),
-                // print(k,v)
-                void (*print)(const void* key, const void* value),
-                // delete(k,v)
-                void (*delete)(void* key, void* value) );
+Table ht_create(void (*print)(const char* key, const person_t* value),
+                void (*delete)(char* key, person_t* value) );
 
 /// Destroy the table instance, and call delete function on each (key, value)
 /// pair.
@@ -89,9 +108,16 @@ void ht_destroy( Table t );
 ///
 void ht_dump( const Table t, bool full );
 
-/// Get the value associated with a key from the table.  This function
-/// uses the registered hash function to locate the key, and the
-/// registered equals function to check for equality.
+/// Measure the table: its counters, plus how many groups a lookup of
+/// each entry has to probe before finding it.
+///
+/// @param t The table to measure
+/// @param stats Receives the measurements
+/// @pre t is a valid instance of table.
+///
+void ht_stats( const Table t, ht_stats_t* stats );
+
+/// Get the value associated with a key from the table.
 ///
 /// @pre The table must have the key, or the function will assert failure
 /// @param t The table
@@ -100,32 +126,81 @@ void ht_dump( const Table t, bool full );
 /// @pre t is a valid instance of table, and key is not NULL.
 /// @return The value associated with the key
 ///
-const void* ht_get( const Table t, const void* key );
+person_t* ht_get( const Table t, const char* key );
 
-/// Check if the table has a key.  This function uses the registered hash
-/// function to locate the key, and the registered equals function to
-/// check for equality.
+/// Find the value associated with a key, if there is one.
+///
+/// @param t The table
+/// @param key The key
+/// @pre t is a valid instance of table, and key is not NULL.
+/// @return The value associated with the key, or NULL if it is absent
+///
+person_t* ht_find( const Table t, const char* key );
+
+/// Check if the table has a key.
 ///
 /// @param t The table
 /// @param key The key
 /// @pre t is a valid instance of table, and key is not NULL.
 /// @return Whether the key exists in the table.
 ///
-bool ht_has( const Table t, const void* key );
+bool ht_has( const Table t, const char* key );
 
 /// Add a (key, value) pair to the table, or update an existing key's value.
-/// This function uses the registered hash function to locate the key,
-/// and the registered equals function to check for equality.
 ///
 /// @param t The table
 /// @param key The key
 /// @param value The value
 /// @exception Assert fails if it cannot allocate space
 /// @pre t is a valid instance of table. key is not NULL. value is not NULL.
-/// @post if size reached the LOAD_THRESHOLD, table has grown by RESIZE_FACTOR.
+/// @post if the load reached 7/8 of capacity, the table has been rehashed.
 /// @return The old value associated with the key, if one exists.
 ///
-void* ht_put( Table t, const void* key, const void* value );
+person_t* ht_put( Table t, const char* key, person_t* value );
+
+/// Add a (key, value) pair to the table unless the key is already there.
+/// The key is hashed only once, whether or not it is inserted.
+///
+/// @param t The table
+/// @param key The key
+/// @param value The value
+/// @exception Assert fails if it cannot allocate space
+/// @pre t is a valid instance of table. key is not NULL. value is not NULL.
+/// @post if the key was absent and the load reached 7/8 of capacity, the
+///       table has been rehashed.
+/// @return NULL if the pair was inserted, otherwise the value already
+///         associated with the key, which is left unchanged
+///
+person_t* ht_try_insert( Table t, const char* key, person_t* value );
+
+/// Make room for a number of entries up front, so that inserting them does
+/// not rehash the table along the way.
+///
+/// @param t The table
+/// @param count The number of entries the table should hold
+/// @exception Assert fails if it cannot allocate space
+/// @pre t is a valid instance of table.
+///
+void ht_reserve( Table t, size_t count );
+
+/// Remove a key from the table.  The (key, value) pair is not deleted;
+/// ownership of both returns to the caller.
+///
+/// @param t The table
+/// @param key The key
+/// @pre t is a valid instance of table, and key is not NULL.
+/// @return The value that was associated with the key, or NULL if the
+///         key was not in the table.
+///
+person_t* ht_remove( Table t, const char* key );
+
+/// Get the number of entries in the table.
+///
+/// @param t The table
+/// @pre t is a valid instance of table.
+/// @return The number of (key, value) pairs stored
+///
+size_t ht_size( const Table t );
 
 /// Get the collection of keys from the table.  This function allocates
 /// space to store the keys, which the caller is responsible for freeing.
@@ -134,9 +209,9 @@ void* ht_put( Table t, const void* key, const void* value );
 /// @exception Assert fails if it cannot allocate space
 /// @pre t is a valid instance of table.
 /// @post client is responsible for freeing the returned array.
-/// @return A dynamic array of keys
+/// @return A dynamic array of ht_size(t) keys
 ///
-void** ht_keys( const Table t );
+char** ht_keys( const Table t );
 
 /// Get the collection of values from the table.  This function allocates
 /// space to store the values, which the caller is responsible for freeing.
@@ -145,8 +220,8 @@ void** ht_keys( const Table t );
 /// @exception Assert fails if it cannot allocate space
 /// @pre t is a valid instance of table.
 /// @post client is responsible for freeing the returned array.
-/// @return A dynamic array of values
+/// @return A dynamic array of ht_size(t) values
 ///
-void** ht_values( const Table t );
+person_t** ht_values( const Table t );
 
 #endif // TABLE_H
@@ -0,0 +1,410 @@
+/*
+ * file: tiers.c
+ *
+ * Cold friend lists in a shared file mapping. The whole of TIERS_RESERVE is
+ * mapped up front so blocks never move, and the file itself grows in
+ * TIERS_GROW steps behind a bump pointer. Freed blocks are kept on
+ * in-memory free lists by size class, never inside the file, so a forked
+ * reader sharing the mapping only ever sees blocks change when the parent
+ * reuses one.
+ *
+ * @author Bennett Moore bwm7637@rit.edu
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "friends.h"
+#include "tiers.h"
+
+#define MIN_CLASS 4			// Smallest block, 16 bytes
+#define NUM_CLASSES 40
+
+//A growable stack of file offsets
+typedef struct offsets_s{
+	size_t *items;
+	size_t count;
+	size_t capacity;
+} offsets_t;
+
+struct Tiers_t{
+	int fd;				// The backing file
+	char *map;			// Its mapping, TIERS_RESERVE bytes
+	size_t size;			// Bytes of the file
+	size_t end;			// Bytes handed out as blocks so far
+	pthread_mutex_t lock;		// Guards the blocks: size, end, free, retired and retain
+	offsets_t free[NUM_CLASSES];	// Reusable blocks by log2 of their size
+	offsets_t retired[NUM_CLASSES];	// Freed blocks kept intact for readers
+	bool retain;			// Whether freed blocks go to retired
+	uint8_t *warmth;		// Sweeps of the hand each user survives
+	size_t *bytes;			// Memory each user's list takes, 0 while cold
+	size_t users;			// Number of users
+	size_t capacity;		// Room in warmth and bytes
+	size_t hand;			// Next user the clock hand looks at
+	size_t hot;			// Bytes of lists in memory, read without locks
+	size_t cold;			// Users whose list is in the file, read without locks
+	size_t budget;			// Bytes of lists allowed in memory
+};
+
+/*
+ * Finds the size class of a block
+ *
+ * @param size The bytes needed
+ * @return The log2 of the smallest block size that holds them
+ */
+static unsigned classOf(size_t size){
+	unsigned k = MIN_CLASS;
+	while(((size_t)1 << k) < size){
+		k++;
+	}
+	return k;
+}
+
+/*
+ * Gets the memory a list in memory takes, rounded as the arena rounds it
+ *
+ * @param p The user
+ * @return The bytes of the friends array and index
+ */
+static size_t hotBytes(const person_t *p){
+	size_t bytes = 0;
+	if(p->friends != NULL){
+		bytes += (size_t)1 << classOf(p->max_friends * sizeof(uint32_t));
+	}
+	if(p->friend_index != NULL){
+		bytes += (size_t)1 << classOf(friends_index_bytes(p));
+	}
+	return bytes;
+}
+
+/*
+ * Gets where a cold list's index starts in its block
+ *
+ * @param p The user
+ * @return The bytes of the friends before the index, rounded up to 16
+ */
+static size_t indexOffset(const person_t *p){
+	return ((size_t)p->friend_count * sizeof(uint32_t) + 15) & ~(size_t)15;
+}
+
+/*
+ * Gets the size class of a user's block in the file
+ *
+ * @param p The user
+ * @return The class that holds their friends and index
+ */
+static unsigned blockClass(const person_t *p){
+	size_t size = indexOffset(p);
+	size += friends_index_bytes(p);
+	return classOf(size);
+}
+
+/*
+ * Whether a user's list is in the file
+ *
+ * @param t The tiers
+ * @param p The user
+ * @return Whether p's friends point into the mapping
+ */
+static bool isCold(const Tiers t, const person_t *p){
+	const char *list = (const char *)p->friends;
+	return list != NULL && list >= t->map && list < t->map + TIERS_RESERVE;
+}
+
+/*
+ * Pushes an offset onto a stack
+ *
+ * @param stack The stack
+ * @param offset The offset
+ */
+static void push(offsets_t *stack, size_t offset){
+	if(stack->count == stack->capacity){ //Grow geometrically
+		stack->capacity = stack->capacity == 0 ? 16 : stack->capacity * 2;
+		stack->items = (size_t *)realloc(stack->items, stack->capacity * sizeof(size_t));
+		assert(stack->items != NULL);
+	}
+	stack->items[stack->count++] = offset;
+}
+
+/*
+ * Hands out a block of the file, reusing a freed one if it can
+ *
+ * @param t The tiers
+ * @param k The block's size class
+ * @param offset Receives where the block starts
+ * @return Whether the file had or could grow room for the block
+ */
+static bool takeBlock(Tiers t, unsigned k, size_t *offset){
+	bool ok = true;
+	pthread_mutex_lock(&t->lock);
+	if(t->free[k].count > 0){
+		*offset = t->free[k].items[--t->free[k].count];
+	}
+	else if(t->end + ((size_t)1 << k) > TIERS_RESERVE){ //Past the reserved mapping
+		ok = false;
+	}
+	else{
+		size_t end = t->end + ((size_t)1 << k);
+		if(end > t->size){ //Grow the file in large steps
+			size_t size = (end + TIERS_GROW - 1) / TIERS_GROW * TIERS_GROW;
+			ok = ftruncate(t->fd, (off_t)size) == 0;
+			if(ok){
+				t->size = size;
+			}
+		}
+		if(ok){
+			*offset = t->end;
+			t->end = end;
+		}
+	}
+	pthread_mutex_unlock(&t->lock);
+	return ok;
+}
+
+/*
+ * Returns a block of the file for reuse, or keeps it intact while blocks
+ * are retained
+ *
+ * @param t The tiers
+ * @param offset Where the block starts
+ * @param k The block's size class
+ */
+static void giveBlock(Tiers t, size_t offset, unsigned k){
+	pthread_mutex_lock(&t->lock);
+	push(t->retain ? &t->retired[k] : &t->free[k], offset);
+	pthread_mutex_unlock(&t->lock);
+}
+
+/*
+ * Moves a user's list to the file, or drops it if it holds no friends
+ *
+ * @param t The tiers
+ * @param a The arena the list is in
+ * @param p The user
+ * @return Whether the list left memory
+ */
+static bool spill(Tiers t, Arena a, person_t *p){
+	uint32_t *friends = NULL;
+	void *index = NULL;
+	if(p->friend_count > 0){ //Copy the list and index into one block
+		size_t offset;
+		if(!takeBlock(t, blockClass(p), &offset)){
+			return false;
+		}
+		char *block = t->map + offset;
+		memcpy(block, p->friends, p->friend_count * sizeof(uint32_t));
+		friends = (uint32_t *)(void *)block;
+		if(p->friend_index != NULL){
+			index = block + indexOffset(p);
+			memcpy(index, p->friend_index, friends_index_bytes(p));
+		}
+		__atomic_fetch_add(&t->cold, 1, __ATOMIC_RELAXED);
+	}
+
+	arena_free(a, p->friends, p->max_friends * sizeof(uint32_t));
+	if(p->friend_index != NULL){
+		arena_free(a, p->friend_index, friends_index_bytes(p));
+	}
+	p->friends = friends;
+	p->friend_index = index;
+	if(friends == NULL){ //An empty list needs no room at all
+		p->max_friends = 0;
+		p->index_mask = 0;
+	}
+	__atomic_fetch_sub(&t->hot, t->bytes[p->id], __ATOMIC_RELAXED);
+	t->bytes[p->id] = 0;
+	return true;
+}
+
+/*
+ * Copies a cold list back into memory and frees its block
+ *
+ * @param t The tiers
+ * @param a The arena to copy the list into
+ * @param p The user
+ */
+static void promote(Tiers t, Arena a, person_t *p){
+	char *block = (char *)p->friends;
+	uint32_t *friends = (uint32_t *)arena_alloc(a, p->max_friends * sizeof(uint32_t));
+	memcpy(friends, block, p->friend_count * sizeof(uint32_t));
+	void *index = NULL;
+	if(p->friend_index != NULL){
+		index = arena_alloc(a, friends_index_bytes(p));
+		memcpy(index, p->friend_index, friends_index_bytes(p));
+	}
+	unsigned k = blockClass(p);
+	p->friends = friends;
+	p->friend_index = index;
+	giveBlock(t, (size_t)(block - t->map), k);
+	__atomic_fetch_sub(&t->cold, 1, __ATOMIC_RELAXED);
+}
+
+Tiers tiers_create( const char* path, size_t budget ){
+	int fd;
+	if(path != NULL){
+		fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	}
+	else{ //A temporary file nobody else can open
+		const char *dir = getenv("TMPDIR");
+		char name[4096];
+		snprintf(name, sizeof(name), "%s/amici-XXXXXX", dir != NULL && dir[0] != '\0' ? dir : "/tmp");
+		fd = mkstemp(name);
+		if(fd >= 0){
+			unlink(name);
+		}
+	}
+	if(fd < 0){
+		return NULL;
+	}
+	char *map = mmap(NULL, TIERS_RESERVE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if(map == MAP_FAILED){
+		close(fd);
+		return NULL;
+	}
+
+	Tiers t = (Tiers)calloc(1, sizeof(struct Tiers_t));
+	assert(t != NULL);
+	t->fd = fd;
+	t->map = map;
+	t->budget = budget;
+	pthread_mutex_init(&t->lock, NULL);
+	return t;
+}
+
+void tiers_destroy( Tiers t ){
+	munmap(t->map, TIERS_RESERVE);
+	close(t->fd);
+	for(unsigned k = 0; k < NUM_CLASSES; k++){
+		free(t->free[k].items);
+		free(t->retired[k].items);
+	}
+	pthread_mutex_destroy(&t->lock);
+	free(t->warmth);
+	free(t->bytes);
+	free(t);
+}
+
+void tiers_clear( Tiers t ){
+	pthread_mutex_lock(&t->lock);
+	if(!t->retain){ //Retained blocks stay put until a clear nobody is reading through
+		for(unsigned k = 0; k < NUM_CLASSES; k++){
+			t->free[k].count = 0;
+		}
+		if(ftruncate(t->fd, 0) == 0){ //Give the disk space back
+			t->size = 0;
+		}
+		t->end = 0;
+	}
+	pthread_mutex_unlock(&t->lock);
+	t->users = 0;
+	t->hand = 0;
+	__atomic_store_n(&t->hot, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&t->cold, 0, __ATOMIC_RELAXED);
+}
+
+void tiers_add( Tiers t, const person_t* p ){
+	assert(p->id == t->users);
+	if(t->users == t->capacity){ //Grow both arrays geometrically
+		t->capacity = t->capacity == 0 ? 64 : t->capacity * 2;
+		t->warmth = (uint8_t *)realloc(t->warmth, t->capacity * sizeof(uint8_t));
+		t->bytes = (size_t *)realloc(t->bytes, t->capacity * sizeof(size_t));
+		assert(t->warmth != NULL && t->bytes != NULL);
+	}
+	t->warmth[p->id] = TIERS_WARMTH;
+	t->bytes[p->id] = hotBytes(p);
+	__atomic_fetch_add(&t->hot, t->bytes[p->id], __ATOMIC_RELAXED);
+	t->users++;
+}
+
+void tiers_remove( Tiers t, uint32_t id ){
+	__atomic_fetch_sub(&t->hot, t->bytes[id], __ATOMIC_RELAXED);
+	t->users--;
+
+	size_t last = t->users;
+	if(id != last){ //The last user takes the removed user's id
+		t->warmth[id] = t->warmth[last];
+		t->bytes[id] = t->bytes[last];
+	}
+	if(t->hand > t->users){
+		t->hand = 0;
+	}
+}
+
+void tiers_touch( Tiers t, Arena a, person_t* p ){
+	if(isCold(t, p)){
+		promote(t, a, p);
+	}
+	t->warmth[p->id] = TIERS_WARMTH;
+
+	//Lists on other threads change the total at the same time
+	size_t bytes = hotBytes(p);
+	if(bytes > t->bytes[p->id]){
+		__atomic_fetch_add(&t->hot, bytes - t->bytes[p->id], __ATOMIC_RELAXED);
+	}
+	else if(bytes < t->bytes[p->id]){
+		__atomic_fetch_sub(&t->hot, t->bytes[p->id] - bytes, __ATOMIC_RELAXED);
+	}
+	t->bytes[p->id] = bytes;
+}
+
+bool tiers_over( const Tiers t ){
+	return __atomic_load_n(&t->hot, __ATOMIC_RELAXED) > t->budget;
+}
+
+size_t tiers_balance( Tiers t, Arena a, person_t** users ){
+	size_t target = (size_t)((double)t->budget * TIERS_LOW_WATER);
+	size_t moved = 0;
+
+	//Every user runs out of warmth within TIERS_WARMTH + 1 sweeps
+	size_t steps = t->users * (TIERS_WARMTH + 1);
+	for(size_t s = 0; s < steps && __atomic_load_n(&t->hot, __ATOMIC_RELAXED) > target; s++){
+		if(t->hand >= t->users){
+			t->hand = 0;
+		}
+		size_t id = t->hand++;
+		if(t->bytes[id] == 0){ //Cold already, or nothing to move
+			continue;
+		}
+		if(t->warmth[id] > 0){
+			t->warmth[id]--;
+			continue;
+		}
+		if(!spill(t, a, users[id])){ //The file is full
+			break;
+		}
+		moved++;
+	}
+	return moved;
+}
+
+void tiers_retain( Tiers t, bool retain ){
+	pthread_mutex_lock(&t->lock);
+	if(t->retain && !retain){ //Nobody is looking at the old blocks now
+		for(unsigned k = 0; k < NUM_CLASSES; k++){
+			for(size_t i = 0; i < t->retired[k].count; i++){
+				push(&t->free[k], t->retired[k].items[i]);
+			}
+			t->retired[k].count = 0;
+		}
+	}
+	t->retain = retain;
+	pthread_mutex_unlock(&t->lock);
+}
+
+void tiers_stats( const Tiers t, tiers_stats_t* stats ){
+	stats->users = t->users;
+	stats->cold = __atomic_load_n(&t->cold, __ATOMIC_RELAXED);
+	stats->hot_bytes = __atomic_load_n(&t->hot, __ATOMIC_RELAXED);
+	stats->budget = t->budget;
+	pthread_mutex_lock(&t->lock);
+	stats->file_bytes = t->size;
+	pthread_mutex_unlock(&t->lock);
+}
@@ -0,0 +1,158 @@
+/// @file tiers.h
+/// @brief Hot and cold friend lists: the lists of users nobody has used
+/// lately are moved out of memory into a memory-mapped file.
+///
+/// General Notes on tiers Operation
+///
+/// - Every user keeps their person_t, which holds their names, handle and
+///   number of friends.  Only a cold user's friend list and its index move:
+///   they are copied into one block of the backing file, and the person's
+///   friends and friend_index point into the mapping.  Readers follow the
+///   same pointers as before, and the kernel pages the block in and out as
+///   memory allows.
+///
+/// - Touching a user brings a cold list back into memory and marks the
+///   user as recently used.  A list must be touched before anything changes
+///   it, and touched again after, so the structure knows how much memory
+///   it takes.
+///
+/// - Once the friend lists in memory take more than the budget, balancing
+///   moves lists to the file until they take TIERS_LOW_WATER of it.  A
+///   clock hand sweeps the users: a user touched since the hand last passed
+///   loses one step of warmth, and a user with no warmth left goes cold, so
+///   users touched within the last few sweeps stay in memory.
+///
+/// - Blocks of the file are sized in powers of two, and a block freed by a
+///   touch is reused by later cold lists, except while blocks are retained
+///   for readers that may still be looking at them.
+///
+/// - Touches may run on several threads at once if each holds the touched
+///   user's lock exclusively.  Balancing, adding and removing users must
+///   not race with any other use.
+///
+/// - User ids stay dense: removing a user hands the last user's id to the
+///   removed user's place, in constant time.
+///
+/// @author Bennett Moore bwm7637@rit.edu
+
+#ifndef TIERS_H
+#define TIERS_H
+
+#include <stdbool.h>    // bool
+#include <stddef.h>     // size_t
+#include <stdint.h>     // uint32_t
+
+#include "arena.h"
+#include "person.h"
+
+/// Address space reserved for the backing file, the most it can hold
+#define TIERS_RESERVE ((size_t)1 << 38)
+
+/// The backing file grows by this many bytes at a time
+#define TIERS_GROW (64 * 1024 * 1024)
+
+/// Balancing stops once lists in memory take this fraction of the budget
+#define TIERS_LOW_WATER 0.875
+
+/// Sweeps of the clock hand a touched user survives
+#define TIERS_WARMTH 3
+
+/// Figures about where friend lists are kept
+typedef struct tiers_stats_s{
+	size_t users;			// Number of users
+	size_t cold;			// Users whose friend list is in the file
+	size_t hot_bytes;		// Bytes of friend lists in memory
+	size_t budget;			// Bytes they may take before balancing
+	size_t file_bytes;		// Bytes of the file holding cold lists
+} tiers_stats_t;
+
+/// The Tiers data type is a pointer to an opaque structure.
+typedef struct Tiers_t * Tiers;
+
+/// Create a backing file and map it.
+///
+/// @param path The file to create or overwrite, or NULL for an unnamed
+///        temporary file
+/// @param budget Bytes of friend lists to keep in memory
+/// @exception Assert fails if it cannot allocate space
+/// @return The tiers, or NULL if the file could not be created or mapped
+///
+Tiers tiers_create( const char* path, size_t budget );
+
+/// Unmap and close the backing file, and release the tiers.
+///
+/// @param t The tiers
+/// @pre Nothing reads a cold friend list any more.
+/// @post t is not a valid instance of tiers.
+///
+void tiers_destroy( Tiers t );
+
+/// Forget every user and every cold list.
+///
+/// @param t The tiers
+///
+void tiers_clear( Tiers t );
+
+/// Add a user, whose friend list is in memory.
+///
+/// @param t The tiers
+/// @param p The user
+/// @exception Assert fails if it cannot allocate space
+/// @pre p->id is the number of users in the tiers.
+///
+void tiers_add( Tiers t, const person_t* p );
+
+/// Forget a user, and give the user with the highest id the removed user's
+/// id.
+///
+/// @param t The tiers
+/// @param id The id of the user to forget
+/// @pre The user's friend list is in memory.
+///
+void tiers_remove( Tiers t, uint32_t id );
+
+/// Bring a user's friend list into memory if it is cold, mark the user as
+/// recently used, and note how much memory the list takes.
+///
+/// @param t The tiers
+/// @param a The arena the list is kept in while in memory
+/// @param p The user
+/// @exception Assert fails if it cannot allocate space
+/// @pre No other thread reads or touches p's friend list.
+///
+void tiers_touch( Tiers t, Arena a, person_t* p );
+
+/// Whether the friend lists in memory take more than the budget.
+///
+/// @param t The tiers
+/// @return Whether balancing would move lists to the file
+///
+bool tiers_over( const Tiers t );
+
+/// Move the lists of the least recently used users to the file until the
+/// lists in memory fit the budget.
+///
+/// @param t The tiers
+/// @param a The arena the lists are kept in while in memory
+/// @param users Every user, indexed by id
+/// @exception Assert fails if it cannot allocate space
+/// @pre Nothing else uses the network.
+/// @return The number of lists moved
+///
+size_t tiers_balance( Tiers t, Arena a, person_t** users );
+
+/// Keep freed blocks of the file from being reused, or allow it again.
+///
+/// @param t The tiers
+/// @param retain Whether blocks freed from now on must keep their contents
+///
+void tiers_retain( Tiers t, bool retain );
+
+/// Report where friend lists are kept.
+///
+/// @param t The tiers
+/// @param stats Receives the figures
+///
+void tiers_stats( const Tiers t, tiers_stats_t* stats );
+
+#endif // TIERS_H
@@ -0,0 +1,411 @@
+/*
+ * file: triangles.c
+ *
+ * Per-user triangle counts, changed one friendship at a time by walking
+ * the shorter of the two friend lists and looking each friend up in the
+ * longer one. The exact recount gives each thread a slice of users with
+ * about the same number of friends, and each thread writes only its own
+ * users' counters. A batch of friendships already linked gives each thread
+ * a slice of the batch, and each triangle is counted by the last
+ * friendship of the batch that closes it.
+ *
+ * @author Bennett Moore bwm7637@rit.edu
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "friends.h"
+#include "triangles.h"
+
+struct Triangles_t{
+	uint64_t *counts;		// Triangles each user is part of
+	uint32_t *degree;		// Number of friends of each user
+	uint64_t *share;		// Each user's clustering coefficient in the sum, as a fraction of CLUSTERING_ONE
+	size_t users;			// Number of users
+	size_t capacity;		// Room in counts, degree and share
+	uint64_t total;			// Triangles in the network
+	uint64_t clustering;		// Sum of share, wrapping while shares change
+};
+
+//Fixed point 1 of the clustering sum, so shares add exactly in any order
+#define CLUSTERING_ONE 4294967296.0
+
+//One thread's share of a recount
+typedef struct recount_s{
+	Triangles tr;
+	person_t **users;
+	size_t begin;			// Slice of users to count
+	size_t end;
+	size_t wrong;			// Users in the slice whose kept counts were off
+} recount_t;
+
+//One thread's share of a batch of new friendships
+typedef struct batch_s{
+	Triangles tr;
+	person_t **users;
+	const uint32_t *pairs;		// Two ids per friendship, in batch order
+	const uint64_t *keys;		// Map of the batch's friendships to their place in it, plus one
+	size_t mask;			// Slots in keys minus one
+	size_t begin;			// Slice of friendships to count
+	size_t end;
+} batch_t;
+
+/*
+ * Combines the two ids of a friendship, in either order, into one key
+ *
+ * @param a One id
+ * @param b The other id
+ * @return The key, which is never 0 for two different ids
+ */
+static uint64_t pairKey(uint32_t a, uint32_t b){
+	return a < b ? (uint64_t)a << 32 | b : (uint64_t)b << 32 | a;
+}
+
+/*
+ * Finds the slot of a friendship in a batch's map
+ *
+ * @param keys The map, two words per slot: the key, then the place plus one
+ * @param mask The number of slots minus one
+ * @param key The friendship's key
+ * @return The slot holding key, or the empty slot where it would go
+ */
+static size_t pairSlot(const uint64_t *keys, size_t mask, uint64_t key){
+	size_t i = (size_t)((key * 0x9e3779b97f4a7c15ULL) >> 32) & mask;
+	while(keys[2 * i] != 0 && keys[2 * i] != key){
+		i = (i + 1) & mask;
+	}
+	return i;
+}
+
+/*
+ * Brings a user's share of the clustering sum up to date with their
+ * counters. A thread that changed the counters while this ran settles
+ * again itself, and this settles again if it lost that race, so once the
+ * counters stop changing the last share written matches them.
+ *
+ * @param tr The count
+ * @param id The user whose counters changed
+ */
+static void settle(Triangles tr, uint32_t id){
+	uint64_t count, degree;
+	do{
+		count = __atomic_load_n(&tr->counts[id], __ATOMIC_SEQ_CST);
+		degree = __atomic_load_n(&tr->degree[id], __ATOMIC_SEQ_CST);
+		uint64_t share = 0;
+		if(degree >= 2){
+			share = (uint64_t)(2.0 * (double)count / ((double)degree * (double)(degree - 1)) * CLUSTERING_ONE + 0.5);
+		}
+		uint64_t old = __atomic_exchange_n(&tr->share[id], share, __ATOMIC_SEQ_CST);
+		__atomic_fetch_add(&tr->clustering, share - old, __ATOMIC_RELAXED);
+	} while(__atomic_load_n(&tr->counts[id], __ATOMIC_SEQ_CST) != count ||
+		__atomic_load_n(&tr->degree[id], __ATOMIC_SEQ_CST) != degree);
+}
+
+/*
+ * Adds or takes away the triangles a friendship closes
+ *
+ * @param tr The count
+ * @param p1 One user
+ * @param p2 The other user
+ * @param closing Whether the friendship is new rather than ended
+ */
+static void adjust(Triangles tr, const person_t *p1, const person_t *p2, bool closing){
+	//Walk the shorter list and probe the longer one
+	if(p2->friend_count < p1->friend_count){
+		const person_t *swap = p1;
+		p1 = p2;
+		p2 = swap;
+	}
+	uint64_t shared = 0;
+	for(size_t i = 0; i < p1->friend_count; i++){
+		uint32_t id = p1->friends[i];
+		if(friends_contains(p2, id)){
+			if(closing){
+				__atomic_fetch_add(&tr->counts[id], 1, __ATOMIC_RELAXED);
+			}
+			else{
+				__atomic_fetch_sub(&tr->counts[id], 1, __ATOMIC_RELAXED);
+			}
+			settle(tr, id);
+			shared++;
+		}
+	}
+
+	if(closing){
+		__atomic_fetch_add(&tr->counts[p1->id], shared, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&tr->counts[p2->id], shared, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&tr->degree[p1->id], 1, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&tr->degree[p2->id], 1, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&tr->total, shared, __ATOMIC_RELAXED);
+	}
+	else{
+		__atomic_fetch_sub(&tr->counts[p1->id], shared, __ATOMIC_RELAXED);
+		__atomic_fetch_sub(&tr->counts[p2->id], shared, __ATOMIC_RELAXED);
+		__atomic_fetch_sub(&tr->degree[p1->id], 1, __ATOMIC_RELAXED);
+		__atomic_fetch_sub(&tr->degree[p2->id], 1, __ATOMIC_RELAXED);
+		__atomic_fetch_sub(&tr->total, shared, __ATOMIC_RELAXED);
+	}
+	settle(tr, p1->id);
+	settle(tr, p2->id);
+}
+
+/*
+ * Counts the triangles of a slice of users from their friend lists
+ *
+ * @param arg The slice, a recount_t
+ * @return NULL
+ */
+static void *recountSlice(void *arg){
+	recount_t *job = (recount_t *)arg;
+	Triangles tr = job->tr;
+	for(size_t u = job->begin; u < job->end; u++){
+		//Each triangle through u is found once from each of its other two users
+		const person_t *p = job->users[u];
+		uint64_t twice = 0;
+		for(size_t i = 0; i < p->friend_count; i++){
+			twice += friends_common(p, job->users[p->friends[i]], NULL);
+		}
+		if(tr->counts[u] != twice / 2 || tr->degree[u] != p->friend_count){
+			job->wrong++;
+		}
+		tr->counts[u] = twice / 2;
+		tr->degree[u] = p->friend_count;
+		settle(tr, (uint32_t)u);
+	}
+	return NULL;
+}
+
+/*
+ * Counts the triangles a slice of a batch closes. Each friendship of the
+ * slice counts the common friends whose two friendships with its users
+ * are old, or come earlier in the batch.
+ *
+ * @param arg The slice, a batch_t
+ * @return NULL
+ */
+static void *linkSlice(void *arg){
+	batch_t *job = (batch_t *)arg;
+	Triangles tr = job->tr;
+	for(size_t k = job->begin; k < job->end; k++){
+		const person_t *p1 = job->users[job->pairs[2 * k]];
+		const person_t *p2 = job->users[job->pairs[2 * k + 1]];
+		if(p2->friend_count < p1->friend_count){
+			const person_t *swap = p1;
+			p1 = p2;
+			p2 = swap;
+		}
+		uint64_t shared = 0;
+		for(size_t i = 0; i < p1->friend_count; i++){
+			uint32_t id = p1->friends[i];
+			if(!friends_contains(p2, id)){
+				continue;
+			}
+			uint64_t place1 = job->keys[2 * pairSlot(job->keys, job->mask, pairKey(p1->id, id)) + 1];
+			uint64_t place2 = job->keys[2 * pairSlot(job->keys, job->mask, pairKey(p2->id, id)) + 1];
+			if(place1 <= k && place2 <= k){ //Places are one more than the index, 0 for old friendships
+				__atomic_fetch_add(&tr->counts[id], 1, __ATOMIC_RELAXED);
+				settle(tr, id);
+				shared++;
+			}
+		}
+		__atomic_fetch_add(&tr->counts[p1->id], shared, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&tr->counts[p2->id], shared, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&tr->degree[p1->id], 1, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&tr->degree[p2->id], 1, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&tr->total, shared, __ATOMIC_RELAXED);
+		settle(tr, p1->id);
+		settle(tr, p2->id);
+	}
+	return NULL;
+}
+
+/*
+ * Runs one job per thread and waits for all of them
+ *
+ * @param jobs The jobs
+ * @param size The size of one job
+ * @param n The number of jobs
+ * @param work Runs one job
+ */
+static void runJobs(void *jobs, size_t size, size_t n, void *(*work)(void *)){
+	char *job = (char *)jobs;
+	pthread_t *workers = (pthread_t *)malloc(n * sizeof(pthread_t));
+	assert(workers != NULL);
+	size_t started = 1;
+	for(size_t i = 1; i < n; i++){ //Fall back to this thread if one cannot start
+		if(pthread_create(&workers[i], NULL, work, job + i * size) != 0){
+			break;
+		}
+		started++;
+	}
+	for(size_t i = started; i < n; i++){
+		work(job + i * size);
+	}
+	work(job);
+	for(size_t i = 1; i < started; i++){
+		pthread_join(workers[i], NULL);
+	}
+	free(workers);
+}
+
+Triangles triangles_create( void ){
+	Triangles tr = (Triangles)calloc(1, sizeof(struct Triangles_t));
+	assert(tr != NULL);
+	return tr;
+}
+
+void triangles_destroy( Triangles tr ){
+	free(tr->counts);
+	free(tr->degree);
+	free(tr->share);
+	free(tr);
+}
+
+void triangles_clear( Triangles tr ){
+	tr->users = 0;
+	tr->total = 0;
+	tr->clustering = 0;
+}
+
+void triangles_add( Triangles tr, uint32_t id ){
+	assert(id == tr->users);
+	if(tr->users == tr->capacity){ //Grow both arrays geometrically
+		tr->capacity = tr->capacity == 0 ? 64 : tr->capacity * 2;
+		tr->counts = (uint64_t *)realloc(tr->counts, tr->capacity * sizeof(uint64_t));
+		tr->degree = (uint32_t *)realloc(tr->degree, tr->capacity * sizeof(uint32_t));
+		tr->share = (uint64_t *)realloc(tr->share, tr->capacity * sizeof(uint64_t));
+		assert(tr->counts != NULL && tr->degree != NULL && tr->share != NULL);
+	}
+	tr->counts[id] = 0;
+	tr->degree[id] = 0;
+	tr->share[id] = 0;
+	tr->users++;
+}
+
+void triangles_remove( Triangles tr, uint32_t id ){
+	assert(tr->degree[id] == 0 && tr->counts[id] == 0);
+	tr->users--;
+
+	size_t last = tr->users;
+	if(id != last){ //The last user takes the removed user's id
+		tr->counts[id] = tr->counts[last];
+		tr->degree[id] = tr->degree[last];
+		tr->share[id] = tr->share[last];
+	}
+}
+
+void triangles_link( Triangles tr, const person_t* p1, const person_t* p2 ){
+	adjust(tr, p1, p2, true);
+}
+
+void triangles_unlink( Triangles tr, const person_t* p1, const person_t* p2 ){
+	adjust(tr, p1, p2, false);
+}
+
+void triangles_link_all( Triangles tr, person_t** users, const uint32_t* pairs, size_t count, unsigned threads ){
+	assert(threads > 0);
+	if(count == 0){
+		return;
+	}
+
+	//Map each friendship of the batch to its place in it
+	size_t slots = 16;
+	while(slots < count * 2){
+		slots *= 2;
+	}
+	uint64_t *keys = (uint64_t *)calloc(slots * 2, sizeof(uint64_t));
+	assert(keys != NULL);
+	for(size_t k = 0; k < count; k++){
+		uint64_t key = pairKey(pairs[2 * k], pairs[2 * k + 1]);
+		size_t slot = pairSlot(keys, slots - 1, key);
+		keys[2 * slot] = key;
+		keys[2 * slot + 1] = k + 1;
+	}
+
+	size_t n = count < TRIANGLES_PARALLEL_LINKS ? 1 : threads;
+	batch_t *jobs = (batch_t *)calloc(n, sizeof(batch_t));
+	assert(jobs != NULL);
+	for(size_t i = 0; i < n; i++){
+		jobs[i].tr = tr;
+		jobs[i].users = users;
+		jobs[i].pairs = pairs;
+		jobs[i].keys = keys;
+		jobs[i].mask = slots - 1;
+		jobs[i].begin = count * i / n;
+		jobs[i].end = count * (i + 1) / n;
+	}
+	runJobs(jobs, sizeof(batch_t), n, linkSlice);
+	free(jobs);
+	free(keys);
+}
+
+uint64_t triangles_count( const Triangles tr, uint32_t id ){
+	return __atomic_load_n(&tr->counts[id], __ATOMIC_RELAXED);
+}
+
+double triangles_clustering( const Triangles tr, uint32_t id ){
+	uint64_t d = __atomic_load_n(&tr->degree[id], __ATOMIC_RELAXED);
+	if(d < 2){
+		return 0;
+	}
+	return 2.0 * (double)triangles_count(tr, id) / ((double)d * (double)(d - 1));
+}
+
+uint64_t triangles_total( const Triangles tr ){
+	return __atomic_load_n(&tr->total, __ATOMIC_RELAXED);
+}
+
+double triangles_average( const Triangles tr ){
+	if(tr->users == 0){
+		return 0;
+	}
+	return (double)__atomic_load_n(&tr->clustering, __ATOMIC_RELAXED) / CLUSTERING_ONE / (double)tr->users;
+}
+
+size_t triangles_recount( Triangles tr, person_t** users, unsigned threads ){
+	assert(threads > 0);
+	if(tr->users == 0){
+		tr->total = 0;
+		tr->clustering = 0;
+		return 0;
+	}
+
+	//Give each thread about the same number of friends to intersect
+	uint64_t links = 0;
+	for(size_t u = 0; u < tr->users; u++){
+		links += users[u]->friend_count;
+	}
+	size_t n = threads;
+	recount_t *jobs = (recount_t *)calloc(n, sizeof(recount_t));
+	assert(jobs != NULL);
+	size_t u = 0;
+	uint64_t seen = 0;
+	for(size_t i = 0; i < n; i++){
+		jobs[i].tr = tr;
+		jobs[i].users = users;
+		jobs[i].begin = u;
+		uint64_t target = links * (i + 1) / n;
+		while(u < tr->users && (i + 1 == n || seen < target)){
+			seen += users[u]->friend_count;
+			u++;
+		}
+		jobs[i].end = u;
+	}
+	runJobs(jobs, sizeof(recount_t), n, recountSlice);
+
+	//Every triangle was counted once for each of its three users
+	size_t wrong = 0;
+	for(size_t i = 0; i < n; i++){
+		wrong += jobs[i].wrong;
+	}
+	uint64_t sum = 0;
+	for(size_t id = 0; id < tr->users; id++){
+		sum += tr->counts[id];
+	}
+	tr->total = sum / 3;
+	free(jobs);
+	return wrong;
+}
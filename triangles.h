@@ -0,0 +1,173 @@
+/// @file triangles.h
+/// @brief Triangle counts and clustering coefficients, kept up to date as
+/// friendships come and go.
+///
+/// General Notes on triangles Operation
+///
+/// - A triangle is three users who are all friends with each other.  The
+///   structure counts the triangles each user is part of, the triangles in
+///   the whole network, and each user's number of friends.
+///
+/// - A new friendship between u and v closes one triangle with each friend
+///   they have in common, and ending it opens the same triangles again, so
+///   either costs one intersection of their friend lists: the shorter list
+///   is walked and each id is looked up in the longer one, in time
+///   proportional to the shorter list.
+///
+/// - Counters change with atomic additions, so friendships between
+///   different pairs of users may be counted at the same time.  Two
+///   changes to friendships of one triangle always share a user, and the
+///   user locks already keep those apart.
+///
+/// - A user's clustering coefficient is the fraction of pairs of their
+///   friends who are friends themselves, and is 0 for users with fewer than
+///   two friends.  A running sum of the coefficients, in fixed point so
+///   changes add up exactly in any order, is updated with every count, so
+///   the average over the network is one division.
+///
+/// - A batch of friendships added at once, such as an import, is counted
+///   after all of them are in the friend lists, a slice of the batch per
+///   thread.  Each friendship counts only the triangles it closes with old
+///   friendships and earlier ones of the batch, so a triangle of several
+///   new friendships is counted once, by the last of them.
+///
+/// - A full recount intersects every friendship's two lists again, a slice
+///   of users per thread, and is meant for checking the kept counts and for
+///   building them after loading a snapshot.
+///
+/// - User ids stay dense: removing a user hands the last user's id to the
+///   removed user's place, in constant time.
+///
+/// @author Bennett Moore bwm7637@rit.edu
+
+#ifndef TRIANGLES_H
+#define TRIANGLES_H
+
+#include <stddef.h>     // size_t
+#include <stdint.h>     // uint32_t, uint64_t
+
+#include "person.h"
+
+/// Batches with this many friendships are counted by several threads
+#define TRIANGLES_PARALLEL_LINKS 4096
+
+/// The Triangles data type is a pointer to an opaque structure.
+typedef struct Triangles_t * Triangles;
+
+/// Create an empty count.
+///
+/// @exception Assert fails if it cannot allocate space
+/// @return A count with no users
+///
+Triangles triangles_create( void );
+
+/// Release a count.
+///
+/// @param tr The count
+/// @post tr is not a valid instance of triangles.
+///
+void triangles_destroy( Triangles tr );
+
+/// Forget every user.
+///
+/// @param tr The count
+///
+void triangles_clear( Triangles tr );
+
+/// Add a new user with no friends.
+///
+/// @param tr The count
+/// @param id The user's id
+/// @exception Assert fails if it cannot allocate space
+/// @pre id is the number of users in the count, and no other thread uses tr.
+///
+void triangles_add( Triangles tr, uint32_t id );
+
+/// Forget a user, and give the user with the highest id the removed user's
+/// id.
+///
+/// @param tr The count
+/// @param id The id of the user to forget
+/// @pre The user has no friends left, and no other thread uses tr.
+///
+void triangles_remove( Triangles tr, uint32_t id );
+
+/// Count the triangles a new friendship closes.
+///
+/// @param tr The count
+/// @param p1 One user
+/// @param p2 The other user
+/// @pre Neither user's friend list changes until this returns.
+///
+void triangles_link( Triangles tr, const person_t* p1, const person_t* p2 );
+
+/// Count the triangles an ended friendship opens.
+///
+/// @param tr The count
+/// @param p1 One user
+/// @param p2 The other user
+/// @pre Neither user's friend list changes until this returns.
+///
+void triangles_unlink( Triangles tr, const person_t* p1, const person_t* p2 );
+
+/// Count the triangles a batch of new friendships closes, once all of them
+/// are in the friend lists.
+///
+/// @param tr The count
+/// @param users Every user, indexed by id
+/// @param pairs Two ids per new friendship
+/// @param count The number of friendships in pairs
+/// @param threads The most threads to use
+/// @exception Assert fails if it cannot allocate space
+/// @pre Every friendship in pairs is new and appears once, and no other
+///      friendship changes until this returns.
+///
+void triangles_link_all( Triangles tr, person_t** users, const uint32_t* pairs, size_t count, unsigned threads );
+
+/// Get the number of triangles a user is part of.
+///
+/// @param tr The count
+/// @param id The user's id
+/// @return The number of pairs of the user's friends who are friends
+///
+uint64_t triangles_count( const Triangles tr, uint32_t id );
+
+/// Get a user's clustering coefficient.
+///
+/// @param tr The count
+/// @param id The user's id
+/// @return The fraction of pairs of the user's friends who are friends, or
+///         0 if the user has fewer than two friends
+///
+double triangles_clustering( const Triangles tr, uint32_t id );
+
+/// Get the number of triangles in the network.
+///
+/// @param tr The count
+/// @return The number of triangles, each counted once
+///
+uint64_t triangles_total( const Triangles tr );
+
+/// Get the average clustering coefficient of the network.
+///
+/// @param tr The count
+/// @return The mean of every user's clustering coefficient, or 0 if there
+///         are no users
+///
+double triangles_average( const Triangles tr );
+
+/// Count every triangle again from the friend lists, and replace the kept
+/// counts with the exact ones.
+///
+/// @param tr The count
+/// @param users Every user, indexed by id
+/// @param threads The most threads to use
+/// @exception Assert fails if it cannot allocate space
+/// @pre users holds one user per id in tr, and no friendship changes until
+///      this returns.
+/// @return The number of users whose kept count or number of friends was
+///         wrong
+///
+size_t triangles_recount( Triangles tr, person_t** users, unsigned threads );
+
+#endif // TRIANGLES_H